@@ -31,6 +31,8 @@
 #include "ns3/flow-monitor-module.h"
 #include <ns3/flow-monitor-helper.h>
 #include "ns3/config-store.h"
+#include "run-profile.h"
+#include "flow-stats-writer.h"
 //#include "ns3/gtk-config-store.h"
 
 using namespace ns3;
@@ -56,6 +58,8 @@ int main (int argc, char *argv[])
   double simTime = 1.1;
   double distance = 10;
   double interPacketInterval = 100;
+  std::string profileName = "full-metadata-pcap";
+  std::string flowStatsFile = "";
 
   // Command line arguments
   CommandLine cmd;
@@ -63,8 +67,18 @@ int main (int argc, char *argv[])
   cmd.AddValue("simTime", "Total duration of the simulation [s])", simTime);
   cmd.AddValue("distance", "Distance between eNBs [m]", distance);
   cmd.AddValue("interPacketInterval", "Inter packet interval [ms])", interPacketInterval);
+  cmd.AddValue("profile", RunProfile::GetHelp (), profileName);
+  cmd.AddValue("flowStats", "Also write the FlowMonitor stats to this binary columnar file", flowStatsFile);
   cmd.Parse(argc, argv);
 
+  //Select which traces, pcaps and packet metadata this run pays for
+  RunProfile profile;
+  if (!profile.Parse (profileName))
+    {
+      NS_FATAL_ERROR ("Unknown run profile " << profileName);
+    }
+  profile.ApplyPacketSettings ();
+
   //Active EPC model
   Ptr<LteHelper> lteHelper = CreateObject<LteHelper> ();
  // Ptr<EpcHelper>  epcHelper = CreateObject<EpcHelper> ();
@@ -209,9 +223,15 @@ int main (int argc, char *argv[])
     }
   serverApps.Start (Seconds (0.01));
   clientApps.Start (Seconds (0.01));
-  lteHelper->EnableTraces ();
-  // Uncomment to enable PCAP tracing
-  //p2ph.EnablePcapAll("lena-epc-first");
+  if (profile.IsEnabled (RunProfile::LTE_TRACES))
+    {
+      lteHelper->EnableTraces ();
+    }
+  // PCAP tracing of the SGi link
+  if (profile.IsEnabled (RunProfile::PCAP))
+    {
+      p2ph.EnablePcapAll("lena-epc-first");
+    }
 
 FlowMonitorHelper flowmon;
 Ptr<FlowMonitor> monitor;
@@ -232,8 +252,12 @@ Simulator::Run();
 
 
 monitor->CheckForLostPackets ();
-monitor->SerializeToXmlFile ("results1.xml" , true, true );
+monitor->SerializeToXmlFile ("results1.xml" , profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS), profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS));
   Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
+if (!flowStatsFile.empty ())
+{
+FlowStatsWriter::Write (flowStatsFile, monitor, classifier);
+}
   std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
 for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
     {
@@ -31,6 +31,9 @@
 #include "ns3/flow-monitor-module.h"
 #include <ns3/flow-monitor-helper.h>
 #include "ns3/config-store.h"
+#include "run-profile.h"
+#include "flow-stats-writer.h"
+#include "instrumented-simulator-impl.h"
 //#include "ns3/gtk-config-store.h"
 
 using namespace ns3;
@@ -48,14 +51,13 @@ int main (int argc, char *argv[])
   
   //The result show the UdpClient and PacketSink information
   Time::SetResolution (Time::NS);
-  LogComponentEnable("UdpClient",LOG_LEVEL_ALL);
-  LogComponentEnable("PacketSink", LOG_LEVEL_ALL);
-  LogComponentEnable("UdpServer",LOG_LEVEL_ALL);
   //Set value
   uint16_t numberOfNodes = 3;
   double simTime = 1.1;
   double distance = 10.0;
   double interPacketInterval = 100;
+  std::string profileName = "full-metadata-pcap";
+  std::string flowStatsFile = "";
 
   // Command line arguments
   CommandLine cmd;
@@ -63,8 +65,24 @@ int main (int argc, char *argv[])
   cmd.AddValue("simTime", "Total duration of the simulation [s])", simTime);
   cmd.AddValue("distance", "Distance between eNBs [m]", distance);
   cmd.AddValue("interPacketInterval", "Inter packet interval [ms])", interPacketInterval);
+  cmd.AddValue("profile", RunProfile::GetHelp (), profileName);
+  cmd.AddValue("flowStats", "Also write the FlowMonitor stats to this binary columnar file", flowStatsFile);
   cmd.Parse(argc, argv);
 
+  //Select which traces, pcaps and packet metadata this run pays for
+  RunProfile profile;
+  if (!profile.Parse (profileName))
+    {
+      NS_FATAL_ERROR ("Unknown run profile " << profileName);
+    }
+  profile.ApplyPacketSettings ();
+  if (profile.IsEnabled (RunProfile::LOGGING))
+    {
+      LogComponentEnable("UdpClient",LOG_LEVEL_ALL);
+      LogComponentEnable("PacketSink", LOG_LEVEL_ALL);
+      LogComponentEnable("UdpServer",LOG_LEVEL_ALL);
+    }
+
   //Active EPC model
   Ptr<LteHelper> lteHelper = CreateObject<LteHelper> ();
  // Ptr<EpcHelper>  epcHelper = CreateObject<EpcHelper> ();
@@ -209,9 +227,15 @@ int main (int argc, char *argv[])
     }
   serverApps.Start (Seconds (0.01));
   clientApps.Start (Seconds (0.01));
-  lteHelper->EnableTraces ();
-  // Uncomment to enable PCAP tracing
-  //p2ph.EnablePcapAll("lena-epc-first");
+  if (profile.IsEnabled (RunProfile::LTE_TRACES))
+    {
+      lteHelper->EnableTraces ();
+    }
+  // PCAP tracing of the SGi link
+  if (profile.IsEnabled (RunProfile::PCAP))
+    {
+      p2ph.EnablePcapAll("lena-epc-first");
+    }
 
 FlowMonitorHelper flowmon;
 Ptr<FlowMonitor> monitor;
@@ -232,8 +256,12 @@ Simulator::Run();
 
 
 monitor->CheckForLostPackets ();
-monitor->SerializeToXmlFile ("results.xml" , true, true );
+monitor->SerializeToXmlFile ("results.xml" , profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS), profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS));
   Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
+if (!flowStatsFile.empty ())
+{
+FlowStatsWriter::Write (flowStatsFile, monitor, classifier);
+}
   std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
 for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
     {
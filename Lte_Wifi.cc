@@ -23,6 +23,8 @@
 #include "ns3/csma-module.h"
 #include "ns3/internet-module.h"
 #include "ns3/flow-monitor-module.h"
+#include "buffered-trace-sink.h"
+#include "instrumented-simulator-impl.h"
  
  
 // Default Network Topology
@@ -52,6 +54,13 @@ main (int argc, char *argv[])
  
   cmd.Parse (argc,argv);
  
+  if (nWifi > 18)
+    {
+      std::cout << "Number of wifi nodes " << nWifi << 
+                   " specified exceeds the mobility bounding box" << std::endl;
+      exit (1);
+    }
+ 
   if (verbose)
     {
       Time::SetResolution (Time::NS);
@@ -156,9 +165,12 @@ main (int argc, char *argv[])
   Ptr<FlowMonitor> monitor = flowmon.InstallAll ();
  
  
-  phy.EnablePcap ("simple_wireless", apDevices.Get (0));
+  // the pcap of the AP is written in large buffers by an I/O thread
+  BufferedTraceSink traceSink;
+  traceSink.EnablePcap ("simple_wireless", apDevices.Get (0));
  
   Simulator::Run ();
+  traceSink.Close ();
  
   // 10. Print per flow statistics
   monitor->CheckForLostPackets ();
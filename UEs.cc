@@ -32,6 +32,8 @@
 #include "ns3/internet-module.h"
 #include "ns3/flow-monitor-module.h"
 #include <ns3/flow-monitor-helper.h>
+#include "buffered-trace-sink.h"
+#include "instrumented-simulator-impl.h"
 
 using namespace ns3;
 
@@ -147,9 +149,10 @@ main (int argc, char *argv[])
   client.SetFill (apps.Get (0), fill, sizeof(fill), 1024);
 #endif
 
-  AsciiTraceHelper ascii;
-  csma.EnableAsciiAll (ascii.CreateFileStream ("udp-echo.tr"));
-  csma.EnablePcapAll ("udp-echo", false);
+  // ASCII and pcap traces are written in large buffers by an I/O thread
+  BufferedTraceSink traceSink;
+  csma.EnableAsciiAll (traceSink.CreateFileStream ("udp-echo.tr"));
+  traceSink.EnablePcapAll ("udp-echo", false);
 
 //
 // Now, do the actual simulation.
@@ -157,6 +160,7 @@ main (int argc, char *argv[])
   NS_LOG_INFO ("Run Simulation.");
   Simulator::Stop(Seconds(30));
   Simulator::Run ();
+  traceSink.Close ();
 
 //Move the information captured by flow monitor to a file that will be located at ns-3-dev folder
 
@@ -33,6 +33,8 @@
 #include "ns3/config-store.h"
 #include "ns3/stats-module.h"
 #include "ns3/netanim-module.h"
+#include "run-profile.h"
+#include "flow-stats-writer.h"
 
 //#include "ns3/gtk-config-store.h"
 
@@ -99,8 +101,6 @@ Rx (Ptr<const Packet> packet, const Address& add)
 int main (int argc, char *argv[])
 {
   
-  //The result show the UdpClient and PacketSink information
-  Packet::EnablePrinting ();
   Time::SetResolution (Time::NS);
   RngSeedManager::SetSeed (3);
   RngSeedManager::SetRun (5);
@@ -115,6 +115,8 @@ int main (int argc, char *argv[])
   double simTime = 1.0;
   double distance = 10000;
   double interPacketInterval = 25;
+  std::string profileName = "full";
+  std::string flowStatsFile = "";
 
   //uint16_t numberOfNodes = numberOfUENodes + numberOfeNBNodes;
 
@@ -124,9 +126,20 @@ int main (int argc, char *argv[])
   //cmd.AddValue("simTime", "Total duration of the simulation [s])", simTime);
   //cmd.AddValue("distance", "Distance between eNBs [m]", distance);
   //cmd.AddValue("interPacketInterval", "Inter packet interval [ms])", interPacketInterval);
+  cmd.AddValue("profile", RunProfile::GetHelp (), profileName);
+  cmd.AddValue("flowStats", "Also write the FlowMonitor stats to this binary columnar file", flowStatsFile);
  
   cmd.Parse(argc, argv);
 
+  //Select which traces, pcaps and packet metadata this run pays for
+  RunProfile profile;
+  if (!profile.Parse (profileName))
+    {
+      NS_FATAL_ERROR ("Unknown run profile " << profileName);
+    }
+  //The result show the UdpClient and PacketSink information
+  profile.ApplyPacketSettings ();
+
   //Activate EPC (Evolved Packet Core) model: it allows Ipv4 networking usage with LTE devices
 
   //Create LTE Helper object: provide methods to add UEs and eNBs and configure them
@@ -314,10 +327,16 @@ int main (int argc, char *argv[])
 
   serverApps.Start (Seconds (0.01));
   clientApps.Start (Seconds (0.01));
-  lteHelper->EnableTraces ();
+  if (profile.IsEnabled (RunProfile::LTE_TRACES))
+    {
+      lteHelper->EnableTraces ();
+    }
 
   // enable PCAP tracing
-  p2ph.EnablePcapAll("lena-epc-first");
+  if (profile.IsEnabled (RunProfile::PCAP))
+    {
+      p2ph.EnablePcapAll("lena-epc-first");
+    }
 
   FlowMonitorHelper flowmon;
   Ptr<FlowMonitor> monitor;
@@ -330,38 +349,46 @@ int main (int argc, char *argv[])
 
   Config::ConnectWithoutContext("/NodeList/*/ApplicationList/*/$ns3::PacketSink/Rx", MakeCallback(&Rx));
 
-  AnimationInterface anim ("test-animation.xml");
-  
-  for (uint32_t i = 0; i < ueNodes.GetN (); ++i)
-    {
-      anim.UpdateNodeDescription (ueNodes.Get (i), "UE"); // Optional
-      anim.UpdateNodeColor (ueNodes.Get (i), 255, 0, 0); // Optional
-    }
-  for (uint32_t i = 0; i < enbNodes.GetN (); ++i)
-    {
-      anim.UpdateNodeDescription (enbNodes.Get (i), "ENB"); // Optional
-      anim.UpdateNodeColor (enbNodes.Get (i), 0, 255, 0); // Optional   
-    }
-  for (uint32_t i = 0; i < remoteHostContainer.GetN (); ++i)
+  AnimationInterface *anim = 0;
+  if (profile.IsEnabled (RunProfile::NETANIM))
     {
-      anim.UpdateNodeDescription (remoteHostContainer.Get (i), "Remote Host"); // Optional
-      anim.UpdateNodeColor (remoteHostContainer.Get (i), 0, 0, 255); // Optional 
-    }
+      anim = new AnimationInterface ("test-animation.xml");
+  
+      for (uint32_t i = 0; i < ueNodes.GetN (); ++i)
+        {
+          anim->UpdateNodeDescription (ueNodes.Get (i), "UE"); // Optional
+          anim->UpdateNodeColor (ueNodes.Get (i), 255, 0, 0); // Optional
+        }
+      for (uint32_t i = 0; i < enbNodes.GetN (); ++i)
+        {
+          anim->UpdateNodeDescription (enbNodes.Get (i), "ENB"); // Optional
+          anim->UpdateNodeColor (enbNodes.Get (i), 0, 255, 0); // Optional   
+        }
+      for (uint32_t i = 0; i < remoteHostContainer.GetN (); ++i)
+        {
+          anim->UpdateNodeDescription (remoteHostContainer.Get (i), "Remote Host"); // Optional
+          anim->UpdateNodeColor (remoteHostContainer.Get (i), 0, 0, 255); // Optional 
+        }
 
-      anim.UpdateNodeDescription (pgw, "PGW"); // Optional
-      anim.UpdateNodeColor (pgw, 255, 0, 255); // Optional 
+      anim->UpdateNodeDescription (pgw, "PGW"); // Optional
+      anim->UpdateNodeColor (pgw, 255, 0, 255); // Optional 
 
-    for (uint32_t i = 0; i < 6; ++i)
-    {
-      anim.UpdateNodeSize (i, 5000, 5000);
-    } 
+      for (uint32_t i = 0; i < 6; ++i)
+        {
+          anim->UpdateNodeSize (i, 5000, 5000);
+        } 
+    }
 
   Simulator::Stop(Seconds(simTime));
   Simulator::Run();
 
   monitor->CheckForLostPackets ();
-  monitor->SerializeToXmlFile ("results1.xml" , true, true );
+  monitor->SerializeToXmlFile ("results1.xml" , profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS), profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS));
   Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
+  if (!flowStatsFile.empty ())
+    {
+      FlowStatsWriter::Write (flowStatsFile, monitor, classifier);
+    }
   std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
   for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
     {
@@ -391,6 +418,7 @@ int main (int argc, char *argv[])
   //Packet::EnablePrinting ();
   
   Simulator::Destroy();
+  delete anim;
   return 0;
 
 }
@@ -18,6 +18,8 @@
  * Author: Jaume Nin <jaume.nin@cttc.cat>
  */
 
+#include <sstream>
+#include <cstdio>
 #include "ns3/lte-helper.h"
 #include "ns3/epc-helper.h"
 #include "ns3/core-module.h"
@@ -33,6 +35,16 @@
 #include "ns3/config-store.h"
 #include "ns3/stats-module.h"
 #include "ns3/netanim-module.h"
+#include "run-profile.h"
+#include "flow-stats-writer.h"
+#include "flow-table.h"
+#include "warm-start.h"
+#include "delay-log-format.h"
+#include "anim-trace.h"
+#include "instrumented-simulator-impl.h"
+#include "perf-scopes.h"
+#include "progress-meter.h"
+#include "event-profiler-allocations.h"
 
 //#include "ns3/gtk-config-store.h"
 
@@ -66,6 +78,16 @@ Ptr<NormalRandomVariable> GenerateNormalRandomVariable(double mean, double varia
     return x;
 }
 
+// Random variable of the delays, created on first use and recreated by every warm-start run
+static Ptr<NormalRandomVariable> g_delay;
+
+// Binary log of the input and output delays (--delayLog), replaces the printed delays
+static DelayLogWriter *g_delayLog = 0;
+
+// Hardware counters of the run and its subsystems (--perfCounters), and the scope of the delay stage
+static PerfScopes *g_perf = 0;
+static uint32_t g_perfDelayScope = 0;
+
 // This function inserts delay in the nodes
 bool netDevCb(
   Ptr<NetDevice> device,
@@ -73,10 +95,27 @@ bool netDevCb(
   uint16_t  protocol,
   const Address &from)
 { 
-    static Ptr<NormalRandomVariable> x = GenerateNormalRandomVariable(5, 3); //Create a random variable
+    if (g_perf != 0)
+      {
+        g_perf->Begin (g_perfDelayScope);
+      }
+    if (g_delay == 0)
+      {
+        g_delay = GenerateNormalRandomVariable(5, 3); //Create a random variable
+      }
+    Ptr<NormalRandomVariable> x = g_delay;
     Ptr<Node> node = device->GetNode (); //Define which node is chosen
-    Simulator::Schedule(MilliSeconds(x->GetValue()), &Node::NonPromiscReceiveFromDevice, node, device, pkt, protocol, from); //Insert delay
+    double inputDelay = x->GetValue();
+    Simulator::Schedule(MilliSeconds(inputDelay), &Node::NonPromiscReceiveFromDevice, node, device, pkt, protocol, from); //Insert delay
+    if (g_delayLog != 0)
+      {
+        g_delayLog->Add (DELAY_LOG_INPUT, Simulator::Now ().GetNanoSeconds (), pkt->GetUid (), inputDelay);
+      }
     //std::cout << "Input Delay: " << x->GetValue() << " ms" << std::endl;
+    if (g_perf != 0)
+      {
+        g_perf->End (g_perfDelayScope);
+      }
     return  true;
 }
  
@@ -94,10 +133,156 @@ Rx (Ptr<const Packet> packet, const Address& add)
  
      delay = (receive_time - send_time); //delay calculation
 
+     if (g_delayLog != 0)
+       {
+         // the log keeps the delay at full resolution
+         g_delayLog->Add (DELAY_LOG_OUTPUT, Simulator::Now ().GetNanoSeconds (), packet->GetUid (),
+                          (Simulator::Now () - seqTs.GetTs ()).GetSeconds () * 1000);
+         return;
+       }
      std::cout << "Output Delay: " << delay << " ms" << std::endl;
   
 }
 
+// State a warm-start run needs to finish the simulation on its own
+struct WarmStartContext
+{
+  Ptr<FlowMonitor> monitor;
+  double simTime;
+  std::string delayLog;
+};
+
+// This function continues the warmed-up simulation with its own run number (in a forked child)
+void
+RunWarmStartSeed (WarmStartContext *context, uint32_t run, int resultFd)
+{
+  // Keep the delays of every run in their own file
+  std::ostringstream delays;
+  delays << "output-delays-run" << run << ".txt";
+  FILE *out = fopen (delays.str ().c_str (), "w");
+  if (out != 0)
+    {
+      dup2 (fileno (out), STDOUT_FILENO);
+      fclose (out);
+    }
+
+  if (g_delayLog != 0)
+    {
+      // The parent flushed before the fork, so closing its log here loses nothing
+      std::ostringstream log;
+      log << context->delayLog << "-run" << run;
+      std::string error;
+      if (!g_delayLog->Open (log.str (), error))
+        {
+          NS_FATAL_ERROR ("Cannot write the delay log: " << error);
+        }
+    }
+
+  // Reseed the delay stream; UdpClient traffic itself is deterministic
+  RngSeedManager::SetRun (run);
+  g_delay = GenerateNormalRandomVariable(5, 3);
+
+  Simulator::Stop (Seconds (context->simTime) - Simulator::Now ());
+  Simulator::Run ();
+
+  delete g_delayLog;
+  g_delayLog = 0;
+  context->monitor->CheckForLostPackets ();
+  std::ostringstream xml;
+  xml << "flow-monitor-file-run" << run << ".xml";
+  context->monitor->SerializeToXmlFile (xml.str (), false, false);
+
+  // One line per flow: flowId txPackets rxPackets lostPackets delaySum[ns]
+  std::ostringstream result;
+  const FlowMonitor::FlowStatsContainer &stats = context->monitor->GetFlowStats ();
+  for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    {
+      result << i->first << " " << i->second.txPackets << " " << i->second.rxPackets << " "
+             << i->second.lostPackets << " " << i->second.delaySum.GetNanoSeconds () << "\n";
+    }
+  std::string text = result.str ();
+  for (std::string::size_type written = 0; written < text.size (); )
+    {
+      ssize_t n = write (resultFd, text.data () + written, text.size () - written);
+      if (n <= 0)
+        {
+          break;
+        }
+      written += n;
+    }
+  Simulator::Destroy ();
+}
+
+// This function prints what the warm-start runs reported
+void
+PrintWarmStartSummary (uint32_t firstRun, const std::vector<std::string> &results)
+{
+  double delaySum = 0;
+  uint32_t completed = 0;
+  for (uint32_t r = 0; r < results.size (); ++r)
+    {
+      if (results[r].empty ())
+        {
+          std::cout << "Run " << firstRun + r << ": failed\n";
+          continue;
+        }
+      std::istringstream lines (results[r]);
+      uint64_t flowId, txPackets, rxPackets, lostPackets;
+      int64_t flowDelay;
+      uint64_t tx = 0, rx = 0, lost = 0;
+      double delay = 0;
+      while (lines >> flowId >> txPackets >> rxPackets >> lostPackets >> flowDelay)
+        {
+          tx += txPackets;
+          rx += rxPackets;
+          lost += lostPackets;
+          delay += flowDelay * 1e-6;
+        }
+      double meanDelay = rx > 0 ? delay / rx : 0;
+      std::cout << "Run " << firstRun + r << ":\n";
+      std::cout << "  Tx Packets: " << tx << "\n";
+      std::cout << "  Rx Packets: " << rx << "\n";
+      std::cout << "  Lost Packets: " << lost << "\n";
+      std::cout << "  Mean Delay: " << meanDelay << " ms\n";
+      delaySum += meanDelay;
+      ++completed;
+    }
+  if (completed > 0)
+    {
+      std::cout << "Mean Delay over " << completed << " runs: " << delaySum / completed << " ms\n";
+    }
+}
+
+// Labels and colors the nodes of the animation, for AnimationInterface or AnimTraceRecorder alike
+template <class Animation>
+void
+DescribeNodes (Animation *anim, NodeContainer ueNodes, NodeContainer enbNodes, NodeContainer remoteHostContainer, Ptr<Node> pgw)
+{
+  for (uint32_t i = 0; i < ueNodes.GetN (); ++i)
+    {
+      anim->UpdateNodeDescription (ueNodes.Get (i), "UE"); // Optional
+      anim->UpdateNodeColor (ueNodes.Get (i), 255, 0, 0); // Optional
+    }
+  for (uint32_t i = 0; i < enbNodes.GetN (); ++i)
+    {
+      anim->UpdateNodeDescription (enbNodes.Get (i), "ENB"); // Optional
+      anim->UpdateNodeColor (enbNodes.Get (i), 0, 255, 0); // Optional   
+    }
+  for (uint32_t i = 0; i < remoteHostContainer.GetN (); ++i)
+    {
+      anim->UpdateNodeDescription (remoteHostContainer.Get (i), "Remote Host"); // Optional
+      anim->UpdateNodeColor (remoteHostContainer.Get (i), 0, 0, 255); // Optional 
+    }
+
+  anim->UpdateNodeDescription (pgw, "PGW"); // Optional
+  anim->UpdateNodeColor (pgw, 255, 0, 255); // Optional 
+
+  for (uint32_t i = 0; i < 6; ++i)
+    {
+      anim->UpdateNodeSize (i, 5000, 5000);
+    } 
+}
+
 int main (int argc, char *argv[])
 {
   //Set value
@@ -106,21 +291,94 @@ int main (int argc, char *argv[])
   double distance = 10000;
   double interPacketInterval = 20;
   char filename[50];
+  std::string profileName = "full";
+  std::string flowStatsFile = "";
+  double warmup = 0.5;
+  uint32_t forkRuns = 0;
+  uint32_t forkJobs = 0;
+  std::string delayLog;
+  std::string animTraceFile;
+  uint32_t animSampling = 100;
+  double animFrame = 0.1;
+  double animStart = 0;
+  double animStop = 0;
+  std::string profileEvents;
+  bool perfCounters = false;
+  double progressPeriod = 0;
+  double progressFloor = 0;
 
   CommandLine cmd;
+  cmd.AddValue("numberOfNodes", "Number of eNodeBs + UE pairs", numberOfNodes);
+  cmd.AddValue("simTime", "Total duration of the simulation [s])", simTime);
+  cmd.AddValue("profile", RunProfile::GetHelp (), profileName);
+  cmd.AddValue("flowStats", "Also write the FlowMonitor stats to this binary columnar file", flowStatsFile);
+  cmd.AddValue("forkRuns", "Number of runs forked from one warmed-up simulation, starting at RngRun (0 = single run)", forkRuns);
+  cmd.AddValue("forkJobs", "Forked runs alive at the same time (0 = one per CPU)", forkJobs);
+  cmd.AddValue("warmup", "Simulated time [s] spent on attach and bearer setup before runs are forked", warmup);
+  cmd.AddValue("delayLog", "Write the input and output delays to this binary log instead of printing them", delayLog);
+  cmd.AddValue("animTrace", "Write a binary animation trace to this file instead of test-animation.xml", animTraceFile);
+  cmd.AddValue("animSampling", "One packet in this many is drawn in the animation trace (0 = counters only)", animSampling);
+  cmd.AddValue("animFrame", "Length [s] of the frames the link counters of the animation trace add up (0 = none)", animFrame);
+  cmd.AddValue("animStart", "Simulated time [s] the animation trace starts recording packets at", animStart);
+  cmd.AddValue("animStop", "Simulated time [s] the animation trace stops recording packets at (0 = end of run)", animStop);
+  cmd.AddValue("profileEvents", "Write the wall time, count and allocations per event type to <prefix>.txt and <prefix>.folded", profileEvents);
+  cmd.AddValue("progress", "Print a Progress line with the simulated/wall time ratio and ETA every this many wall-clock seconds (0 = never)", progressPeriod);
+  cmd.AddValue("progressFloor", "Stop the run after 3 Progress lines in a row below this simulated/wall time ratio (0 = never)", progressFloor);
+  cmd.AddValue("perfCounters", "Count cycles, instructions, cache and branch misses of the run, the delay stage, PDCP receive and FlowMonitor probes", perfCounters);
   
 
-  //The result show the UdpClient and PacketSink information
-  Packet::EnablePrinting ();
   Time::SetResolution (Time::NS);
   RngSeedManager::SetSeed (3);
-  //RngSeedManager::SetRun (2); // Uncomment this line and change the Run Number to change the randomness of the random variable
+  //RngSeedManager::SetRun (2); // Uncomment this line (or pass --RngRun=2) and change the Run Number to change the randomness of the random variable
   //Uncomment these lines to get more information of the packets sent and received during the simulation
   //LogComponentEnable("UdpClient",LOG_LEVEL_ALL);
   //LogComponentEnable("PacketSink", LOG_LEVEL_ALL);
   //LogComponentEnable("UdpServer",LOG_LEVEL_ALL);
     
   cmd.Parse(argc, argv);
+  // The profiler and the progress meter need their simulator to be chosen before anything schedules an event
+  if (!profileEvents.empty () || progressPeriod > 0)
+    {
+      InstrumentedSimulatorImpl::Enable ();
+    }
+
+  //Select which traces, pcaps and packet metadata this run pays for
+  RunProfile profile;
+  if (!profile.Parse (profileName))
+    {
+      NS_FATAL_ERROR ("Unknown run profile " << profileName);
+    }
+  //The result show the UdpClient and PacketSink information
+  profile.ApplyPacketSettings ();
+  if (forkRuns > 0 && (profile.IsEnabled (RunProfile::LTE_TRACES) || profile.IsEnabled (RunProfile::PCAP)
+                       || profile.IsEnabled (RunProfile::NETANIM) || !animTraceFile.empty ()
+                       || !profileEvents.empty ()))
+    {
+      NS_FATAL_ERROR ("Forked runs would share the trace files of the parent, use --profile=lean or --profile=debug");
+    }
+  if (!delayLog.empty ())
+    {
+      g_delayLog = new DelayLogWriter;
+      std::string error;
+      if (!g_delayLog->Open (delayLog, error))
+        {
+          NS_FATAL_ERROR ("Cannot write the delay log: " << error);
+        }
+    }
+  if (forkRuns > 0 && perfCounters)
+    {
+      NS_FATAL_ERROR ("The hardware counters only count this process, not the forked runs");
+    }
+  if (perfCounters)
+    {
+      g_perf = new PerfScopes;
+      g_perfDelayScope = g_perf->AddScope ("delay");
+      g_perf->ScopePdcpReceive ();
+    }
+  if (forkRuns > 0 && warmup >= simTime)
+    {
+      NS_FATAL_ERROR ("The warm-up has to end before simTime");
+    }
 
   //Activate EPC (Evolved Packet Core) model: it allows Ipv4 networking usage with LTE devices
 
@@ -299,16 +557,33 @@ int main (int argc, char *argv[])
     }
 
   serverApps.Start (Seconds (0.01));
-  clientApps.Start (Seconds (0.01));
-  lteHelper->EnableTraces ();
+  // Forked runs only differ after the fork, so their traffic starts once the warm-up is over
+  clientApps.Start (Seconds (forkRuns > 0 ? warmup : 0.01));
+  if (profile.IsEnabled (RunProfile::LTE_TRACES))
+    {
+      lteHelper->EnableTraces ();
+    }
 
   // enable PCAP tracing
-  p2ph.EnablePcapAll("lena-epc-first");
+  if (profile.IsEnabled (RunProfile::PCAP))
+    {
+      p2ph.EnablePcapAll("lena-epc-first");
+    }
 
   FlowMonitorHelper flowmon;
   Ptr<FlowMonitor> monitor;
+  // The FlowMonitor probes are the trace sinks connected between the two
+  uint32_t perfFlowmonScope = 0;
+  if (g_perf != 0)
+    {
+      perfFlowmonScope = g_perf->OpenIpv4Scope ("flowmon", NodeContainer (ueNodes, remoteHostContainer));
+    }
   monitor = flowmon.Install(ueNodes);
   monitor = flowmon.Install(remoteHost);
+  if (g_perf != 0)
+    {
+      g_perf->CloseIpv4Scope (perfFlowmonScope, NodeContainer (ueNodes, remoteHostContainer));
+    }
   monitor = flowmon.GetMonitor ();
   monitor->SetAttribute("DelayBinWidth", DoubleValue (0.001));
   monitor->SetAttribute("JitterBinWidth", DoubleValue (0.001));
@@ -316,59 +591,115 @@ int main (int argc, char *argv[])
 
   Config::ConnectWithoutContext("/NodeList/*/ApplicationList/*/$ns3::PacketSink/Rx", MakeCallback(&Rx));
 
-  AnimationInterface anim ("test-animation.xml");
-  
-  for (uint32_t i = 0; i < ueNodes.GetN (); ++i)
+  AnimationInterface *anim = 0;
+  AnimTraceRecorder *animTrace = 0;
+  if (!animTraceFile.empty ())
     {
-      anim.UpdateNodeDescription (ueNodes.Get (i), "UE"); // Optional
-      anim.UpdateNodeColor (ueNodes.Get (i), 255, 0, 0); // Optional
+      animTrace = new AnimTraceRecorder (animTraceFile, animSampling, Seconds (animFrame), Seconds (animStart), Seconds (animStop));
+      animTrace->Install ();
+      DescribeNodes (animTrace, ueNodes, enbNodes, remoteHostContainer, pgw);
     }
-  for (uint32_t i = 0; i < enbNodes.GetN (); ++i)
+  else if (profile.IsEnabled (RunProfile::NETANIM))
     {
-      anim.UpdateNodeDescription (enbNodes.Get (i), "ENB"); // Optional
-      anim.UpdateNodeColor (enbNodes.Get (i), 0, 255, 0); // Optional   
+      anim = new AnimationInterface ("test-animation.xml");
+      DescribeNodes (anim, ueNodes, enbNodes, remoteHostContainer, pgw);
     }
-  for (uint32_t i = 0; i < remoteHostContainer.GetN (); ++i)
+
+  if (forkRuns > 0)
     {
-      anim.UpdateNodeDescription (remoteHostContainer.Get (i), "Remote Host"); // Optional
-      anim.UpdateNodeColor (remoteHostContainer.Get (i), 0, 0, 255); // Optional 
+      // Build and attach once, then let every run continue from here
+      Simulator::Stop (Seconds (warmup));
+      Simulator::Run ();
+
+      WarmStartContext context;
+      context.monitor = monitor;
+      context.simTime = simTime;
+      context.delayLog = delayLog;
+      uint32_t firstRun = RngSeedManager::GetRun ();
+      WarmStartForker forker (forkJobs);
+      std::vector<std::string> results = forker.Run (firstRun, forkRuns, MakeBoundCallback (&RunWarmStartSeed, &context));
+      PrintWarmStartSummary (firstRun, results);
+
+      Simulator::Destroy ();
+      delete g_delayLog;
+      delete anim;
+      return 0;
     }
 
-      anim.UpdateNodeDescription (pgw, "PGW"); // Optional
-      anim.UpdateNodeColor (pgw, 255, 0, 255); // Optional 
-
-    for (uint32_t i = 0; i < 6; ++i)
+  EventProfiler eventProfiler (profileEvents);
+  if (!profileEvents.empty ())
     {
-      anim.UpdateNodeSize (i, 5000, 5000);
-    } 
-
+      InstrumentedSimulatorImpl::Get ()->SetProfiler (&eventProfiler);
+    }
   Simulator::Stop(Seconds(simTime));
+  ProgressMeter progress (MilliSeconds (1), progressPeriod);
+  if (progressPeriod > 0)
+    {
+      progress.SetFloor (progressFloor, 3);
+      progress.Start (Seconds (simTime));
+    }
+  uint32_t perfRunScope = 0;
+  if (g_perf != 0)
+    {
+      perfRunScope = g_perf->AddScope ("run");
+      g_perf->Begin (perfRunScope);
+    }
   Simulator::Run();
+  if (g_perf != 0)
+    {
+      g_perf->End (perfRunScope);
+    }
+  progress.Finish ();
+  delete g_delayLog;
+  g_delayLog = 0;
+  if (animTrace != 0)
+    {
+      animTrace->Finish ();
+    }
 
   monitor->CheckForLostPackets ();
   sprintf(filename, "flow-monitor-file.xml");
-  monitor->SerializeToXmlFile (filename, true, true );
+  monitor->SerializeToXmlFile (filename, profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS), profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS));
   Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
-  std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
+  if (!flowStatsFile.empty ())
     {
-      // first 2 FlowIds are for ECHO apps, we don't want to display them
-      if (i->first > 0)
+      FlowStatsWriter::Write (flowStatsFile, monitor, classifier);
+    }
+  FlowTable flowTable (monitor, classifier);
+  for (FlowId flowId = 1; flowId < flowTable.GetSize (); ++flowId)
+    {
+      if (flowTable.Get (flowId).stats != 0)
         {
-          Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-          std::cout << "Flow " << i->first << " (" << t.sourceAddress << " -> " << t.destinationAddress << ")\n";
-          std::cout << "  Tx Packets: " << i->second.txPackets << "\n";
-          std::cout << "  Tx Bytes:   " << i->second.txBytes << "\n";
-          std::cout << "  TxOffered:  " << i->second.txBytes * 8.0 / simTime / 1024 / 1024  << " Mbps\n";
-          std::cout << "  Rx Packets: " << i->second.rxPackets << "\n";
-          std::cout << "  Rx Bytes:   " << i->second.rxBytes << "\n";
-          std::cout << "  Throughput: " << i->second.rxBytes * 8.0 / simTime / 1024 / 1024  << " Mbps\n";
-          std::cout << " Mean Delay: " << i->second.delaySum/i->second.rxPackets << "\n";
+          const FlowMonitor::FlowStats &stats = *flowTable.Get (flowId).stats;
+          const Ipv4FlowClassifier::FiveTuple &t = flowTable.Get (flowId).tuple;
+          std::cout << "Flow " << flowId << " (" << t.sourceAddress << " -> " << t.destinationAddress << ")\n";
+          std::cout << "  Tx Packets: " << stats.txPackets << "\n";
+          std::cout << "  Tx Bytes:   " << stats.txBytes << "\n";
+          std::cout << "  TxOffered:  " << stats.txBytes * 8.0 / simTime / 1024 / 1024  << " Mbps\n";
+          std::cout << "  Rx Packets: " << stats.rxPackets << "\n";
+          std::cout << "  Rx Bytes:   " << stats.rxBytes << "\n";
+          std::cout << "  Throughput: " << stats.rxBytes * 8.0 / simTime / 1024 / 1024  << " Mbps\n";
+          std::cout << " Mean Delay: " << stats.delaySum/stats.rxPackets << "\n";
           
           }
     } 
+  if (g_perf != 0)
+    {
+      // per packet sent by any application
+      uint64_t packets = 0;
+      const FlowMonitor::FlowStatsContainer &stats = monitor->GetFlowStats ();
+      for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); ++i)
+        {
+          packets += i->second.txPackets;
+        }
+      g_perf->Report (std::cout, packets);
+    }
   
   Simulator::Destroy();
-  return 0;
+  delete g_perf;
+  g_perf = 0;
+  delete anim;
+  delete animTrace;
+  return progress.IsAborted () ? 1 : 0;
 
 }
@@ -0,0 +1,311 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "anim-trace-format.h"
+
+/**
+ * Expands the binary animation trace of --animTrace (anim-trace.h) into
+ * NetAnim XML, for the window from --from to --to seconds only (the whole
+ * trace by default). Nodes start the window where, and as, the records
+ * before it left them. Sampled packets are drawn as packets, the link
+ * counters of every frame become link descriptions ("N pkts, B bytes").
+ *
+ * Without --output, file.bin is written to file.xml.
+ *
+ * Needs no ns-3, build it on its own with
+ *   g++ -O2 -o anim-trace-convert anim-trace-convert.cc
+ *
+ * Usage: anim-trace-convert [--from=S] [--to=S] [--output=FILE] file.bin
+ */
+
+namespace {
+
+/// A node as the records before the window left it
+struct NodeState
+{
+  NodeState ()
+    : x (0),
+      y (0),
+      hasColor (false),
+      color (0),
+      width (0),
+      height (0)
+  {
+  }
+  double x;
+  double y;
+  bool hasColor;
+  uint32_t color;
+  std::string description;
+  double width;                 ///< 0 if never set
+  double height;
+};
+
+/// A record in the window, with its text
+struct Event
+{
+  AnimTraceRecord record;
+  std::string text;
+};
+
+bool
+EarlierEvent (const Event &a, const Event &b)
+{
+  return a.record.timeNs < b.record.timeNs;
+}
+
+std::string
+Escape (const std::string &text)
+{
+  std::string escaped;
+  for (std::string::size_type i = 0; i < text.size (); ++i)
+    {
+      switch (text[i])
+        {
+        case '&': escaped += "&amp;"; break;
+        case '<': escaped += "&lt;"; break;
+        case '>': escaped += "&gt;"; break;
+        case '"': escaped += "&quot;"; break;
+        default: escaped += text[i];
+        }
+    }
+  return escaped;
+}
+
+double
+Millimetres (int64_t mm)
+{
+  return mm / 1000.0;
+}
+
+/// Applies a node record to the state of its node; false if it is not a node record
+bool
+Apply (NodeState &node, const AnimTraceRecord &r, const std::string &text)
+{
+  switch (r.type)
+    {
+    case ANIM_TRACE_POSITION:
+      node.x = Millimetres (r.arg);
+      node.y = Millimetres (static_cast<int32_t> (r.peer));
+      return true;
+    case ANIM_TRACE_COLOR:
+      node.hasColor = true;
+      node.color = r.value;
+      return true;
+    case ANIM_TRACE_DESCRIPTION:
+      node.description = text;
+      return true;
+    case ANIM_TRACE_SIZE:
+      node.width = Millimetres (r.arg);
+      node.height = Millimetres (static_cast<int32_t> (r.peer));
+      return true;
+    default:
+      return false;
+    }
+}
+
+void
+WriteNodeUpdates (FILE *out, double t, uint32_t id, const NodeState &node)
+{
+  if (node.hasColor)
+    {
+      fprintf (out, "<nu p=\"c\" t=\"%.9f\" id=\"%u\" r=\"%u\" g=\"%u\" b=\"%u\" />\n", t, id,
+               node.color >> 16 & 0xff, node.color >> 8 & 0xff, node.color & 0xff);
+    }
+  if (!node.description.empty ())
+    {
+      fprintf (out, "<nu p=\"d\" t=\"%.9f\" id=\"%u\" descr=\"%s\" />\n", t, id, Escape (node.description).c_str ());
+    }
+  if (node.width > 0)
+    {
+      fprintf (out, "<nu p=\"s\" t=\"%.9f\" id=\"%u\" w=\"%g\" h=\"%g\" />\n", t, id, node.width, node.height);
+    }
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  double from = 0;
+  double to = -1;
+  std::string filename;
+  std::string output;
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg.compare (0, 7, "--from=") == 0)
+        {
+          from = atof (arg.c_str () + 7);
+        }
+      else if (arg.compare (0, 5, "--to=") == 0)
+        {
+          to = atof (arg.c_str () + 5);
+        }
+      else if (arg.compare (0, 9, "--output=") == 0)
+        {
+          output = arg.substr (9);
+        }
+      else if (arg.compare (0, 2, "--") != 0 && filename.empty ())
+        {
+          filename = arg;
+        }
+      else
+        {
+          filename.clear ();
+          break;
+        }
+    }
+  if (filename.empty () || from < 0 || (to >= 0 && to < from))
+    {
+      std::cerr << "Usage: anim-trace-convert [--from=S] [--to=S] [--output=FILE] file.bin\n";
+      return 2;
+    }
+  if (output.empty ())
+    {
+      std::string::size_type dot = filename.rfind (".bin");
+      output = (dot != std::string::npos && dot + 4 == filename.size () ? filename.substr (0, dot) : filename) + ".xml";
+    }
+
+  AnimTraceReader reader;
+  std::string error;
+  if (!reader.Open (filename, error))
+    {
+      std::cerr << "anim-trace-convert: " << error << "\n";
+      return 1;
+    }
+  int64_t fromNs = static_cast<int64_t> (from * 1e9);
+  int64_t toNs = to >= 0 ? static_cast<int64_t> (to * 1e9) : -1;
+
+  // records are only roughly in time order, so the whole trace is read and the window sorted
+  std::map<uint32_t, NodeState> nodes;
+  std::set<std::pair<uint32_t, uint32_t> > links;
+  std::vector<Event> window;
+  // both directions of a link share its description, so their counters are added up
+  typedef std::map<std::pair<int64_t, std::pair<uint32_t, uint32_t> >, Event> Counts;
+  Counts counts;
+  Event event;
+  while (reader.Read (event.record, event.text))
+    {
+      const AnimTraceRecord &r = event.record;
+      if (r.timeNs < fromNs)
+        {
+          Apply (nodes[r.node], r, event.text);
+          continue;
+        }
+      if (toNs >= 0 && r.timeNs > toNs)
+        {
+          continue;
+        }
+      nodes[r.node];
+      if (r.type != ANIM_TRACE_PACKET && r.type != ANIM_TRACE_COUNT)
+        {
+          window.push_back (event);
+          continue;
+        }
+      nodes[r.peer];
+      std::pair<uint32_t, uint32_t> link (std::min (r.node, r.peer), std::max (r.node, r.peer));
+      links.insert (link);
+      if (r.type == ANIM_TRACE_PACKET)
+        {
+          window.push_back (event);
+          continue;
+        }
+      Counts::iterator count = counts.find (std::make_pair (r.timeNs, link));
+      if (count == counts.end ())
+        {
+          event.record.node = link.first;
+          event.record.peer = link.second;
+          counts.insert (std::make_pair (std::make_pair (r.timeNs, link), event));
+        }
+      else
+        {
+          count->second.record.value += r.value;
+          count->second.record.arg += r.arg;
+        }
+    }
+  for (Counts::const_iterator it = counts.begin (); it != counts.end (); ++it)
+    {
+      window.push_back (it->second);
+    }
+  std::stable_sort (window.begin (), window.end (), &EarlierEvent);
+
+  FILE *out = fopen (output.c_str (), "w");
+  if (out == 0)
+    {
+      std::cerr << "anim-trace-convert: cannot write " << output << "\n";
+      return 1;
+    }
+  fprintf (out, "<anim ver=\"netanim-3.105\" filetype=\"animation\" >\n");
+  for (std::map<uint32_t, NodeState>::const_iterator it = nodes.begin (); it != nodes.end (); ++it)
+    {
+      fprintf (out, "<node id=\"%u\" sysId=\"0\" locX=\"%g\" locY=\"%g\" />\n", it->first, it->second.x, it->second.y);
+    }
+  for (std::set<std::pair<uint32_t, uint32_t> >::const_iterator it = links.begin (); it != links.end (); ++it)
+    {
+      fprintf (out, "<link fromId=\"%u\" toId=\"%u\" fd=\"\" td=\"\" ld=\"\" />\n", it->first, it->second);
+    }
+  for (std::map<uint32_t, NodeState>::const_iterator it = nodes.begin (); it != nodes.end (); ++it)
+    {
+      WriteNodeUpdates (out, from, it->first, it->second);
+    }
+  uint64_t packets = 0;
+  for (std::vector<Event>::const_iterator it = window.begin (); it != window.end (); ++it)
+    {
+      const AnimTraceRecord &r = it->record;
+      double t = r.timeNs * 1e-9;
+      NodeState update;
+      if (r.type == ANIM_TRACE_PACKET)
+        {
+          double rx = r.arg * 1e-9;
+          fprintf (out, "<p fId=\"%u\" fbTx=\"%.9f\" lbTx=\"%.9f\" tId=\"%u\" fbRx=\"%.9f\" lbRx=\"%.9f\" />\n",
+                   r.node, t, t, r.peer, rx, rx);
+          ++packets;
+        }
+      else if (r.type == ANIM_TRACE_COUNT)
+        {
+          fprintf (out, "<linkupdate t=\"%.9f\" fromId=\"%u\" toId=\"%u\" ld=\"%u pkts, %llu bytes\" />\n",
+                   t, r.node, r.peer, r.value, (unsigned long long) r.arg);
+        }
+      else if (r.type == ANIM_TRACE_POSITION)
+        {
+          Apply (update, r, it->text);
+          fprintf (out, "<nu p=\"p\" t=\"%.9f\" id=\"%u\" x=\"%g\" y=\"%g\" />\n", t, r.node, update.x, update.y);
+        }
+      else if (Apply (update, r, it->text))
+        {
+          WriteNodeUpdates (out, t, r.node, update);
+        }
+    }
+  fprintf (out, "</anim>\n");
+  if (fclose (out) != 0)
+    {
+      std::cerr << "anim-trace-convert: cannot write " << output << "\n";
+      return 1;
+    }
+  std::cerr << "anim-trace-convert: " << nodes.size () << " nodes, " << packets << " packets, "
+            << window.size () - packets << " other records to " << output << "\n";
+  return 0;
+}
@@ -0,0 +1,140 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ANIM_TRACE_FORMAT_H
+#define ANIM_TRACE_FORMAT_H
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+/*
+ * Binary animation trace, version 1, a compact stand-in for the NetAnim
+ * XML of AnimationInterface. Does not depend on ns-3, so anim-trace-convert
+ * expands it to XML without linking the simulator.
+ *
+ * Native endian, an AnimTraceHeader followed by 32-byte AnimTraceRecords in
+ * the order they were written: a packet when it was received, the counters
+ * of a frame when it ended. An ANIM_TRACE_DESCRIPTION record is followed by
+ * its text, value bytes padded with NULs to a multiple of the record size.
+ */
+
+enum AnimTraceType
+{
+  ANIM_TRACE_POSITION = 0,      ///< node at x = arg, y = (int32_t) peer, in mm
+  ANIM_TRACE_COLOR = 1,         ///< node colored value = 0xRRGGBB
+  ANIM_TRACE_DESCRIPTION = 2,   ///< node labeled with the value bytes of text that follow
+  ANIM_TRACE_PACKET = 3,        ///< sampled packet of value bytes sent by node at timeNs, received by peer at arg
+  ANIM_TRACE_COUNT = 4,         ///< value packets and arg bytes from node to peer in the frame from timeNs
+  ANIM_TRACE_SIZE = 5           ///< node drawn arg wide and (int32_t) peer high, in mm
+};
+
+struct AnimTraceHeader
+{
+  char magic[8];              ///< "ANIMBIN" and a NUL
+  uint32_t version;           ///< ANIM_TRACE_VERSION
+  uint32_t recordSize;        ///< sizeof (AnimTraceRecord) of the writer
+  int64_t frameNs;            ///< length of the ANIM_TRACE_COUNT frames
+  int64_t startNs;            ///< packet events before this were not recorded
+  int64_t stopNs;             ///< nor after this
+  uint32_t sampling;          ///< one packet in sampling has an ANIM_TRACE_PACKET record
+  uint32_t reserved;
+};
+
+struct AnimTraceRecord
+{
+  int64_t timeNs;
+  int64_t arg;
+  uint32_t type;              ///< AnimTraceType
+  uint32_t node;
+  uint32_t peer;
+  uint32_t value;
+};
+
+static const uint32_t ANIM_TRACE_VERSION = 1;
+
+/// Reads an animation trace record by record
+class AnimTraceReader
+{
+public:
+  AnimTraceReader ()
+    : m_file (0)
+  {
+  }
+
+  ~AnimTraceReader ()
+  {
+    if (m_file != 0)
+      {
+        fclose (m_file);
+      }
+  }
+
+  /// \return false with the reason in error if the file is not an animation trace
+  bool Open (std::string filename, std::string &error)
+  {
+    m_file = fopen (filename.c_str (), "rb");
+    if (m_file == 0)
+      {
+        error = "cannot read " + filename;
+        return false;
+      }
+    if (fread (&m_header, sizeof (m_header), 1, m_file) != 1 || memcmp (m_header.magic, "ANIMBIN", 7) != 0)
+      {
+        error = filename + " is not an animation trace";
+        return false;
+      }
+    if (m_header.version != ANIM_TRACE_VERSION || m_header.recordSize != sizeof (AnimTraceRecord))
+      {
+        error = filename + " is an animation trace of another version";
+        return false;
+      }
+    return true;
+  }
+
+  const AnimTraceHeader &GetHeader (void) const
+  {
+    return m_header;
+  }
+
+  /// \return false at the end of the file; text is set for ANIM_TRACE_DESCRIPTION records
+  bool Read (AnimTraceRecord &record, std::string &text)
+  {
+    if (fread (&record, sizeof (record), 1, m_file) != 1)
+      {
+        return false;
+      }
+    text.clear ();
+    if (record.type == ANIM_TRACE_DESCRIPTION)
+      {
+        uint32_t padded = (record.value + sizeof (record) - 1) / sizeof (record) * sizeof (record);
+        text.resize (padded);
+        if (padded > 0 && fread (&text[0], 1, padded, m_file) != padded)
+          {
+            return false;
+          }
+        text.resize (record.value);
+      }
+    return true;
+  }
+
+private:
+  FILE *m_file;
+  AnimTraceHeader m_header;
+};
+
+#endif // ANIM_TRACE_FORMAT_H
@@ -0,0 +1,305 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ANIM_TRACE_H
+#define ANIM_TRACE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+
+#include "anim-trace-format.h"
+
+namespace ns3 {
+
+/**
+ * Records what AnimationInterface would, decimated, into a binary
+ * animation trace (anim-trace-format.h); anim-trace-convert expands the
+ * part of it to be viewed into NetAnim XML.
+ *
+ * A hop is a packet seen by the IP stack of one node and then of another,
+ * so the radio, S1-U and SGi links are covered alike: the uid survives
+ * GTP-U. Every hop received between start and stop is added to the counter
+ * of its link for the current frame, and the counters are written when the
+ * frame ends. Only one packet in sampling (0 for none) gets a record of its
+ * own; whether a packet is sampled depends on its uid only, so a sampled
+ * packet is sampled on every hop. Node positions are written at Install ()
+ * and when the MobilityModel reports a course change.
+ */
+class AnimTraceRecorder
+{
+public:
+  AnimTraceRecorder (std::string filename, uint32_t sampling, Time frame, Time start, Time stop)
+    : m_filename (filename),
+      m_sampling (sampling),
+      m_frame (frame),
+      m_start (start),
+      m_stop (stop),
+      m_file (0),
+      m_frameIndex (0),
+      m_maxInFlight (1 << 16),
+      m_hops (0),
+      m_sampled (0)
+  {
+  }
+
+  ~AnimTraceRecorder ()
+  {
+    Finish ();
+    for (uint32_t i = 0; i < m_hooks.size (); ++i)
+      {
+        delete m_hooks[i];
+      }
+  }
+
+  /// Opens the trace and connects every node that exists so far; call after the mobility models are installed
+  void Install (void)
+  {
+    m_file = fopen (m_filename.c_str (), "wb");
+    if (m_file == 0)
+      {
+        NS_FATAL_ERROR ("Cannot write animation trace " << m_filename);
+      }
+    setvbuf (m_file, 0, _IOFBF, 1 << 20);
+    AnimTraceHeader header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, "ANIMBIN", 7);
+    header.version = ANIM_TRACE_VERSION;
+    header.recordSize = sizeof (AnimTraceRecord);
+    header.frameNs = m_frame.GetNanoSeconds ();
+    header.startNs = m_start.GetNanoSeconds ();
+    header.stopNs = m_stop.GetNanoSeconds ();
+    header.sampling = m_sampling;
+    fwrite (&header, sizeof (header), 1, m_file);
+
+    for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); ++node)
+      {
+        Ptr<MobilityModel> mobility = (*node)->GetObject<MobilityModel> ();
+        if (mobility != 0)
+          {
+            CourseChange (mobility);
+            mobility->TraceConnectWithoutContext ("CourseChange", MakeCallback (&AnimTraceRecorder::CourseChange, this));
+          }
+        Ptr<Ipv4L3Protocol> ipv4 = (*node)->GetObject<Ipv4L3Protocol> ();
+        if (ipv4 != 0)
+          {
+            Hook *hook = new Hook;
+            hook->recorder = this;
+            hook->node = (*node)->GetId ();
+            m_hooks.push_back (hook);
+            ipv4->TraceConnectWithoutContext ("SendOutgoing", MakeBoundCallback (&AnimTraceRecorder::Seen, hook));
+            ipv4->TraceConnectWithoutContext ("UnicastForward", MakeBoundCallback (&AnimTraceRecorder::Seen, hook));
+            ipv4->TraceConnectWithoutContext ("LocalDeliver", MakeBoundCallback (&AnimTraceRecorder::Seen, hook));
+          }
+      }
+  }
+
+  void UpdateNodeDescription (Ptr<Node> node, std::string description)
+  {
+    AnimTraceRecord record = NewRecord (ANIM_TRACE_DESCRIPTION, node->GetId ());
+    record.value = description.size ();
+    Write (record);
+    uint32_t padded = (record.value + sizeof (record) - 1) / sizeof (record) * sizeof (record);
+    description.resize (padded, '\0');
+    fwrite (description.data (), 1, padded, m_file);
+  }
+
+  void UpdateNodeColor (Ptr<Node> node, uint8_t r, uint8_t g, uint8_t b)
+  {
+    AnimTraceRecord record = NewRecord (ANIM_TRACE_COLOR, node->GetId ());
+    record.value = r << 16 | g << 8 | b;
+    Write (record);
+  }
+
+  void UpdateNodeSize (uint32_t nodeId, double width, double height)
+  {
+    AnimTraceRecord record = NewRecord (ANIM_TRACE_SIZE, nodeId);
+    record.arg = static_cast<int64_t> (width * 1000);
+    record.peer = static_cast<uint32_t> (static_cast<int32_t> (height * 1000));
+    Write (record);
+  }
+
+  /// Writes the counters of the last frame and closes the trace
+  void Finish (void)
+  {
+    if (m_file == 0)
+      {
+        return;
+      }
+    WriteCounts ();
+    if (fclose (m_file) != 0)
+      {
+        NS_FATAL_ERROR ("Cannot write animation trace " << m_filename);
+      }
+    m_file = 0;
+    std::cout << "AnimTrace: " << m_hops << " hops, " << m_sampled << " sampled\n";
+  }
+
+private:
+  /// Node a bound Ipv4L3Protocol trace belongs to
+  struct Hook
+  {
+    AnimTraceRecorder *recorder;
+    uint32_t node;
+  };
+
+  /// Where and when a packet was last seen
+  struct LastSeen
+  {
+    uint32_t node;
+    int64_t timeNs;
+  };
+
+  struct Count
+  {
+    Count ()
+      : packets (0),
+        bytes (0)
+    {
+    }
+    uint32_t packets;
+    uint64_t bytes;
+  };
+
+  static void Seen (Hook *hook, const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    hook->recorder->Hop (hook->node, packet->GetUid (), packet->GetSize () + header.GetSerializedSize ());
+  }
+
+  void Hop (uint32_t node, uint64_t uid, uint32_t size)
+  {
+    Time now = Simulator::Now ();
+    if (now < m_start || (!m_stop.IsZero () && now > m_stop))
+      {
+        return;
+      }
+    int64_t nowNs = now.GetNanoSeconds ();
+    std::pair<std::map<uint64_t, LastSeen>::iterator, bool> inserted =
+      m_inFlight.insert (std::make_pair (uid, LastSeen ()));
+    LastSeen &last = inserted.first->second;
+    if (!inserted.second && last.node != node)
+      {
+        ++m_hops;
+        if (!m_frame.IsZero ())
+          {
+            uint64_t frame = static_cast<uint64_t> ((now - m_start).GetTimeStep () / m_frame.GetTimeStep ());
+            if (frame != m_frameIndex)
+              {
+                WriteCounts ();
+                m_frameIndex = frame;
+              }
+            Count &count = m_counts[std::make_pair (last.node, node)];
+            ++count.packets;
+            count.bytes += size;
+          }
+        if (m_sampling > 0 && Mix (uid) % m_sampling == 0)
+          {
+            ++m_sampled;
+            AnimTraceRecord record = NewRecord (ANIM_TRACE_PACKET, last.node);
+            record.timeNs = last.timeNs;
+            record.arg = nowNs;
+            record.peer = node;
+            record.value = size;
+            Write (record);
+          }
+      }
+    last.node = node;
+    last.timeNs = nowNs;
+    if (m_inFlight.size () > m_maxInFlight)
+      {
+        // uids are sequential, the first one is the oldest packet, most likely lost
+        m_inFlight.erase (m_inFlight.begin ());
+      }
+  }
+
+  void CourseChange (Ptr<const MobilityModel> mobility)
+  {
+    Vector position = mobility->GetPosition ();
+    AnimTraceRecord record = NewRecord (ANIM_TRACE_POSITION, mobility->GetObject<Node> ()->GetId ());
+    record.arg = static_cast<int64_t> (position.x * 1000);
+    record.peer = static_cast<uint32_t> (static_cast<int32_t> (position.y * 1000));
+    Write (record);
+  }
+
+  /// Writes the link counters of the current frame and clears them
+  void WriteCounts (void)
+  {
+    int64_t frameStart = (m_start + TimeStep (m_frame.GetTimeStep () * m_frameIndex)).GetNanoSeconds ();
+    for (std::map<std::pair<uint32_t, uint32_t>, Count>::const_iterator it = m_counts.begin ();
+         it != m_counts.end (); ++it)
+      {
+        AnimTraceRecord record = NewRecord (ANIM_TRACE_COUNT, it->first.first);
+        record.timeNs = frameStart;
+        record.arg = it->second.bytes;
+        record.peer = it->first.second;
+        record.value = it->second.packets;
+        Write (record);
+      }
+    m_counts.clear ();
+  }
+
+  static AnimTraceRecord NewRecord (AnimTraceType type, uint32_t node)
+  {
+    AnimTraceRecord record;
+    memset (&record, 0, sizeof (record));
+    record.timeNs = Simulator::Now ().GetNanoSeconds ();
+    record.type = type;
+    record.node = node;
+    return record;
+  }
+
+  void Write (const AnimTraceRecord &record)
+  {
+    NS_ASSERT_MSG (m_file != 0, "AnimTraceRecorder::Install () was not called");
+    fwrite (&record, sizeof (record), 1, m_file);
+  }
+
+  /// splitmix64 finalizer, every input bit affects every output bit
+  static uint64_t Mix (uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  std::string m_filename;
+  uint32_t m_sampling;
+  Time m_frame;
+  Time m_start;
+  Time m_stop;                  ///< 0 for the end of the run
+  FILE *m_file;
+  uint64_t m_frameIndex;        ///< frame of m_counts, counted from m_start
+  std::map<std::pair<uint32_t, uint32_t>, Count> m_counts;
+  std::map<uint64_t, LastSeen> m_inFlight;
+  uint32_t m_maxInFlight;
+  std::vector<Hook *> m_hooks;
+  uint64_t m_hops;
+  uint64_t m_sampled;
+};
+
+} // namespace ns3
+
+#endif // ANIM_TRACE_H
@@ -0,0 +1,78 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ASYNC_STATS_WRITER_H
+#define ASYNC_STATS_WRITER_H
+
+#include <string>
+#include <cstring>
+
+#include "lte-stats-format.h"
+#include "async-trace-writer.h"
+
+/**
+ * Writes LTE stat traces (lte-stats-format.h) on an I/O thread of its own.
+ *
+ * Add () copies a fixed-size record into the current buffer of its file;
+ * nothing is formatted and nothing is written on the calling thread. The
+ * buffering, the I/O thread and the bound on the buffers queued for it are
+ * those of AsyncTraceWriter.
+ *
+ * Does not depend on ns-3; the caller is the only thread that calls Open (),
+ * Add () and Close ().
+ */
+class AsyncStatsWriter
+{
+public:
+  AsyncStatsWriter (uint32_t bufferBytes = 1 << 20, uint32_t maxQueued = 64)
+    : m_writer (bufferBytes, maxQueued)
+  {
+  }
+
+  /// \return the index of the new file for Add (), or -1 with the reason in error
+  int Open (std::string filename, LteStatsKind kind, std::string &error)
+  {
+    int file = m_writer.Open (filename, error);
+    if (file < 0)
+      {
+        return -1;
+      }
+    LteStatsHeader header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, "LTESTAT", 7);
+    header.version = LTE_STATS_VERSION;
+    header.recordSize = sizeof (LteStatsRecord);
+    header.kind = kind;
+    m_writer.Write (file, &header, sizeof (header));
+    return file;
+  }
+
+  void Add (uint32_t file, const LteStatsRecord &record)
+  {
+    m_writer.Write (file, &record, sizeof (record));
+  }
+
+  /// Writes what is buffered and closes the files. \return false with the reason in error on a write error
+  bool Close (std::string &error)
+  {
+    return m_writer.Close (error);
+  }
+
+private:
+  AsyncTraceWriter m_writer;
+};
+
+#endif // ASYNC_STATS_WRITER_H
@@ -0,0 +1,349 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ASYNC_TRACE_WRITER_H
+#define ASYNC_TRACE_WRITER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <cerrno>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/uio.h>
+#include <pthread.h>
+
+/**
+ * Writes trace files on an I/O thread of its own.
+ *
+ * Write () copies bytes into the current buffer of their file; nothing is
+ * written on the calling thread. A full buffer is queued for the I/O thread,
+ * which takes everything queued at once and writes the buffers of a file
+ * with one writev (), then returns them to a free list, so buffers are
+ * reused rather than allocated.
+ *
+ * Memory is bounded: at most maxQueued buffers wait in the queue and as
+ * many are being written, plus the current buffer of every file. If the
+ * disk falls behind, Write () waits for the I/O thread; these stalls and
+ * the time spent in them are counted, so a run can tell how much the trace
+ * output slowed it down.
+ *
+ * Does not depend on ns-3; the caller is the only thread that calls Open (),
+ * Write () and Close ().
+ */
+class AsyncTraceWriter
+{
+public:
+  AsyncTraceWriter (uint32_t bufferBytes = 1 << 20, uint32_t maxQueued = 64)
+    : m_bufferBytes (bufferBytes > 0 ? bufferBytes : 1),
+      m_maxQueued (maxQueued > 0 ? maxQueued : 1),
+      m_started (false),
+      m_stop (false),
+      m_failed (false),
+      m_bytes (0),
+      m_stalls (0),
+      m_stallNs (0)
+  {
+    pthread_mutex_init (&m_mutex, 0);
+    pthread_cond_init (&m_queued, 0);
+    pthread_cond_init (&m_written, 0);
+  }
+
+  ~AsyncTraceWriter ()
+  {
+    std::string error;
+    Close (error);
+    for (uint32_t i = 0; i < m_free.size (); ++i)
+      {
+        delete m_free[i];
+      }
+    pthread_cond_destroy (&m_written);
+    pthread_cond_destroy (&m_queued);
+    pthread_mutex_destroy (&m_mutex);
+  }
+
+  /// \return the index of the new file for Write (), or -1 with the reason in error
+  int Open (std::string filename, std::string &error)
+  {
+    int fd = open (filename.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      {
+        error = "cannot write " + filename;
+        return -1;
+      }
+    File f;
+    f.fd = fd;
+    f.filename = filename;
+    f.current = GetFreeBuffer (fd);
+    m_files.push_back (f);
+    if (!m_started)
+      {
+        m_started = pthread_create (&m_thread, 0, &AsyncTraceWriter::Run, this) == 0;
+      }
+    return m_files.size () - 1;
+  }
+
+  void Write (uint32_t file, const void *data, uint32_t size)
+  {
+    const char *bytes = static_cast<const char *> (data);
+    m_bytes += size;
+    while (size > 0)
+      {
+        Buffer *buffer = m_files[file].current;
+        uint32_t n = std::min<uint32_t> (size, buffer->data.size () - buffer->used);
+        memcpy (&buffer->data[buffer->used], bytes, n);
+        buffer->used += n;
+        bytes += n;
+        size -= n;
+        if (buffer->used == buffer->data.size ())
+          {
+            Submit (m_files[file]);
+          }
+      }
+  }
+
+  /// Writes what is buffered and closes the files. \return false with the reason in error on a write error
+  bool Close (std::string &error)
+  {
+    if (m_files.empty ())
+      {
+        return true;
+      }
+    for (uint32_t i = 0; i < m_files.size (); ++i)
+      {
+        Submit (m_files[i]);
+      }
+    pthread_mutex_lock (&m_mutex);
+    m_stop = true;
+    pthread_cond_signal (&m_queued);
+    pthread_mutex_unlock (&m_mutex);
+    if (m_started)
+      {
+        pthread_join (m_thread, 0);
+        m_started = false;
+      }
+    bool ok = !m_failed;
+    for (uint32_t i = 0; i < m_files.size (); ++i)
+      {
+        delete m_files[i].current;
+        if (close (m_files[i].fd) != 0 || !ok)
+          {
+            ok = false;
+            error = "cannot write " + m_files[i].filename;
+          }
+      }
+    m_files.clear ();
+    m_stop = false;
+    m_failed = false;
+    return ok;
+  }
+
+  /// \return the bytes passed to Write ()
+  uint64_t GetBytes (void) const
+  {
+    return m_bytes;
+  }
+
+  /// \return how often Write () had to wait for the I/O thread
+  uint64_t GetStalls (void) const
+  {
+    return m_stalls;
+  }
+
+  /// \return the time Write () spent waiting for the I/O thread, in seconds
+  double GetStallSeconds (void) const
+  {
+    return m_stallNs * 1e-9;
+  }
+
+private:
+  struct Buffer
+  {
+    std::vector<char> data;
+    uint32_t used;
+    int fd;
+  };
+
+  struct File
+  {
+    int fd;
+    std::string filename;
+    Buffer *current;
+  };
+
+  /// Queues the current buffer of file for the I/O thread and starts a fresh one
+  void Submit (File &file)
+  {
+    if (file.current->used == 0)
+      {
+        return;
+      }
+    if (!m_started)
+      {
+        // no I/O thread could be started, write on this one
+        m_failed = !WriteAll (file.fd, &file.current, 1) || m_failed;
+        file.current->used = 0;
+        return;
+      }
+    pthread_mutex_lock (&m_mutex);
+    if (m_queue.size () >= m_maxQueued)
+      {
+        int64_t start = Now ();
+        while (m_queue.size () >= m_maxQueued)
+          {
+            pthread_cond_wait (&m_written, &m_mutex);
+          }
+        ++m_stalls;
+        m_stallNs += Now () - start;
+      }
+    m_queue.push_back (file.current);
+    pthread_cond_signal (&m_queued);
+    pthread_mutex_unlock (&m_mutex);
+    file.current = GetFreeBuffer (file.fd);
+  }
+
+  Buffer *GetFreeBuffer (int fd)
+  {
+    Buffer *buffer = 0;
+    pthread_mutex_lock (&m_mutex);
+    if (!m_free.empty ())
+      {
+        buffer = m_free.back ();
+        m_free.pop_back ();
+      }
+    pthread_mutex_unlock (&m_mutex);
+    if (buffer == 0)
+      {
+        buffer = new Buffer;
+        buffer->data.resize (m_bufferBytes);
+      }
+    buffer->used = 0;
+    buffer->fd = fd;
+    return buffer;
+  }
+
+  static int64_t Now (void)
+  {
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t> (now.tv_sec) * 1000000000 + now.tv_nsec;
+  }
+
+  /// Writes buffers, all of the same file, with as few writev () calls as it takes
+  static bool WriteAll (int fd, Buffer *const *buffers, uint32_t n)
+  {
+    std::vector<struct iovec> iov (n);
+    for (uint32_t i = 0; i < n; ++i)
+      {
+        iov[i].iov_base = &buffers[i]->data[0];
+        iov[i].iov_len = buffers[i]->used;
+      }
+    uint32_t first = 0;
+    while (first < n)
+      {
+        ssize_t written = writev (fd, &iov[first], std::min<uint32_t> (n - first, IOV_MAX));
+        if (written < 0 && errno == EINTR)
+          {
+            continue;
+          }
+        if (written <= 0)
+          {
+            return false;
+          }
+        // skip what was written, a short write can end inside a buffer
+        while (first < n && static_cast<size_t> (written) >= iov[first].iov_len)
+          {
+            written -= iov[first].iov_len;
+            ++first;
+          }
+        if (first < n)
+          {
+            iov[first].iov_base = static_cast<char *> (iov[first].iov_base) + written;
+            iov[first].iov_len -= written;
+          }
+      }
+    return true;
+  }
+
+  static void *Run (void *self)
+  {
+    static_cast<AsyncTraceWriter *> (self)->Drain ();
+    return 0;
+  }
+
+  /// The I/O thread: writes queued buffers until Close () and the queue is empty
+  void Drain (void)
+  {
+    std::vector<Buffer *> batch;
+    pthread_mutex_lock (&m_mutex);
+    while (true)
+      {
+        while (m_queue.empty () && !m_stop)
+          {
+            pthread_cond_wait (&m_queued, &m_mutex);
+          }
+        if (m_queue.empty ())
+          {
+            break;
+          }
+        batch.assign (m_queue.begin (), m_queue.end ());
+        m_queue.clear ();
+        // the producer may queue again while this batch is written
+        pthread_cond_broadcast (&m_written);
+        pthread_mutex_unlock (&m_mutex);
+        bool ok = true;
+        uint32_t start = 0;
+        while (start < batch.size ())
+          {
+            // a run of buffers of one file, still in the order they were queued
+            uint32_t end = start + 1;
+            while (end < batch.size () && batch[end]->fd == batch[start]->fd)
+              {
+                ++end;
+              }
+            ok = WriteAll (batch[start]->fd, &batch[start], end - start) && ok;
+            start = end;
+          }
+        pthread_mutex_lock (&m_mutex);
+        m_failed = m_failed || !ok;
+        m_free.insert (m_free.end (), batch.begin (), batch.end ());
+      }
+    pthread_mutex_unlock (&m_mutex);
+  }
+
+  uint32_t m_bufferBytes;
+  uint32_t m_maxQueued;
+  std::vector<File> m_files;
+  pthread_t m_thread;
+  bool m_started;
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_queued;      ///< signalled when a buffer is queued or on Close ()
+  pthread_cond_t m_written;     ///< signalled when the I/O thread took the queue
+  std::deque<Buffer *> m_queue;
+  std::vector<Buffer *> m_free;
+  bool m_stop;
+  bool m_failed;
+  uint64_t m_bytes;
+  uint64_t m_stalls;
+  int64_t m_stallNs;
+};
+
+#endif // ASYNC_TRACE_WRITER_H
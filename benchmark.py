@@ -0,0 +1,397 @@
+from __future__ import division
+from __future__ import print_function
+import sys
+import os
+import glob
+import shutil
+import subprocess
+import tempfile
+import time
+import re
+import argparse
+import hashlib
+import json
+import platform
+
+######################################################
+#  Python file to benchmark the scenario scripts
+#  Every run gets its own working directory so the trace files it
+#  writes can be measured and thrown away afterwards
+#  To run it from the ns-3 top-level directory, after ./waf build:
+#  $ python scratch/benchmark.py profiles Use-Case-Final-Version
+######################################################
+
+FEATURES = ["metadata", "logging", "traces", "pcap", "netanim", "histograms"]
+
+
+def find_binary(ns3_dir, scenario):
+    #waf names scratch programs either "scenario" or "ns3.XX-scenario-debug"
+    candidates = glob.glob(os.path.join(ns3_dir, "build", "scratch", scenario))
+    candidates += glob.glob(os.path.join(ns3_dir, "build", "scratch", "ns3*-" + scenario + "-*"))
+    candidates = [c for c in candidates if os.path.isfile(c) and os.access(c, os.X_OK)]
+    if not candidates:
+        sys.exit("No binary for scenario %s, run ./waf build first" % scenario)
+    return candidates[0]
+
+
+def directory_size(path):
+    total = 0
+    for root, dirs, files in os.walk(path):
+        for name in files:
+            total += os.path.getsize(os.path.join(root, name))
+    return total
+
+
+#stdout lines that measure the run rather than simulate it, left out of the checksum
+TIMING_LINES = re.compile(r"^(Startup|TraceSink|Simulator|EventProfile|PerfCounters|Progress|Memory|Objects):")
+
+
+def output_checksum(workdir):
+    """SHA-256 of the files a run wrote and of its stdout without timing lines"""
+    digest = hashlib.sha256()
+    for root, dirs, files in os.walk(workdir):
+        dirs.sort()
+        for name in sorted(files):
+            path = os.path.join(root, name)
+            digest.update(os.path.relpath(path, workdir).encode("utf-8") + b"\0")
+            with open(path, "rb") as f:
+                if name == "stdout.txt":
+                    for line in f:
+                        if not TIMING_LINES.match(line.decode("utf-8", "replace")):
+                            digest.update(line)
+                else:
+                    for block in iter(lambda: f.read(1 << 20), b""):
+                        digest.update(block)
+    return digest.hexdigest()
+
+
+def run_scenario(ns3_dir, scenario, args, extra_env=None):
+    """Runs one scenario and returns wall time, peak RSS, output size, output checksum and stdout"""
+    binary = find_binary(ns3_dir, scenario)
+    env = dict(os.environ)
+    env.update(extra_env or {})
+    libdirs = [os.path.join(ns3_dir, "build"), os.path.join(ns3_dir, "build", "lib")]
+    env["LD_LIBRARY_PATH"] = os.pathsep.join(libdirs + [env.get("LD_LIBRARY_PATH", "")])
+    workdir = tempfile.mkdtemp(prefix="bench-")
+    try:
+        stdout = open(os.path.join(workdir, "stdout.txt"), "w")
+        start = time.time()
+        proc = subprocess.Popen([binary] + args, cwd=workdir, env=env,
+                                stdout=stdout, stderr=subprocess.STDOUT)
+        pid, status, usage = os.wait4(proc.pid, 0)
+        wall = time.time() - start
+        proc.returncode = status
+        stdout.close()
+        output = open(os.path.join(workdir, "stdout.txt")).read()
+        if status != 0:
+            sys.exit("%s %s failed:\n%s" % (scenario, " ".join(args), output[-2000:]))
+        return {"wall": wall,
+                "rss_kb": usage.ru_maxrss,
+                "output_bytes": directory_size(workdir),
+                "checksum": output_checksum(workdir),
+                "stdout": output}
+    finally:
+        shutil.rmtree(workdir)
+
+
+def median_run(ns3_dir, scenario, args, repeat):
+    runs = [run_scenario(ns3_dir, scenario, args) for i in range(repeat)]
+    runs.sort(key=lambda r: r["wall"])
+    return runs[len(runs) // 2]
+
+
+def profiles_report(options):
+    """Cost of every profile feature, measured on top of the lean profile"""
+    profiles = ["lean"] + ["lean+" + f for f in FEATURES] + ["full"]
+    results = []
+    for profile in profiles:
+        args = ["--profile=" + profile] + options.args
+        results.append((profile, median_run(options.ns3_dir, options.scenario, args, options.repeat)))
+
+    lean = results[0][1]
+    print("Run profile cost for %s (median of %d runs)" % (options.scenario, options.repeat))
+    print("%-18s %10s %10s %12s %12s %12s" % ("profile", "wall [s]", "x lean", "RSS [MB]", "+RSS [MB]", "output [MB]"))
+    for profile, r in results:
+        print("%-18s %10.3f %10.2f %12.1f %12.1f %12.2f" % (
+            profile, r["wall"], r["wall"] / lean["wall"],
+            r["rss_kb"] / 1024, (r["rss_kb"] - lean["rss_kb"]) / 1024,
+            r["output_bytes"] / 1024 / 1024))
+
+
+def startup_report(options):
+    """Wall time until the first packet arrives, as the number of UEs grows"""
+    modes = [("eager", [])]
+    if options.lazy:
+        modes.append(("lazy", ["--lazyApps=1"]))
+    print("Startup cost for %s (median of %d runs)" % (options.scenario, options.repeat))
+    print("%-8s %8s %12s %16s %10s %10s" % ("mode", "UEs", "setup [ms]", "first pkt [ms]", "wall [s]", "RSS [MB]"))
+    for nodes in options.nodes:
+        for mode, extra in modes:
+            args = ["--numberOfNodes=%d" % nodes, "--profile=" + options.profile] + extra + options.args
+            r = median_run(options.ns3_dir, options.scenario, args, options.repeat)
+            match = re.search(r"Startup: nodes=(\d+) setupMs=(-?\d+) firstPacketMs=(-?\d+)", r["stdout"])
+            if match is None:
+                sys.exit("%s printed no Startup line, does it use StartupTimer?" % options.scenario)
+            print("%-8s %8d %12s %16s %10.3f %10.1f" % (
+                mode, nodes, match.group(2), match.group(3), r["wall"], r["rss_kb"] / 1024))
+
+
+def memory_report(options):
+    """Heap per UE by setup phase, default against compact UE configuration"""
+    configs = [("default", []), ("compact", ["--ipv4OnlyUe=1", "--lazyApps=1"])]
+    phases = []
+    results = {}
+    for name, extra in configs:
+        args = ["--numberOfNodes=%d" % options.nodes, "--profile=lean", "--memoryAudit=1"] + extra + options.args
+        output = run_scenario(options.ns3_dir, options.scenario, args)["stdout"]
+        per_ue = {}
+        for match in re.finditer(r"Memory: phase=(\S+) heapBytes=-?\d+ rssBytes=-?\d+ heapPerUe=(-?\d+)", output):
+            if match.group(1) not in phases:
+                phases.append(match.group(1))
+            per_ue[match.group(1)] = int(match.group(2))
+        if not per_ue:
+            sys.exit("%s printed no Memory lines, does it use MemoryAudit?" % options.scenario)
+        results[name] = per_ue
+
+    print("Heap per UE for %s with %d UEs" % (options.scenario, options.nodes))
+    print("%-16s %12s %12s %10s" % ("phase", "default [B]", "compact [B]", "change"))
+    for phase in phases:
+        default = results["default"].get(phase, 0)
+        compact = results["compact"].get(phase, 0)
+        change = "%+.1f%%" % ((compact - default) * 100 / default) if default else "-"
+        print("%-16s %12d %12d %10s" % (phase, default, compact, change))
+
+
+def sampling_report(options):
+    """Cost of per-packet flow monitoring: FlowMonitor, FlowMonitor plus the tracker, and the sampled tracker alone"""
+    tracked = ["--lossSeries=loss.csv", "--logHistograms=hist"]
+    configs = [("flowmon", []),
+               ("flowmon+tracker", tracked),
+               ("sampled 1/%d" % options.sampling, tracked + ["--sampling=%d" % options.sampling])]
+    print("Flow monitoring cost for %s with %d UEs (median of %d runs)" % (options.scenario, options.nodes, options.repeat))
+    print("%-18s %10s %10s %12s %12s %10s" % ("monitoring", "run [s]", "x flowmon", "events", "events/s", "RSS [MB]"))
+    first = None
+    for name, extra in configs:
+        args = ["--numberOfNodes=%d" % options.nodes, "--profile=lean"] + extra + options.args
+        runs = []
+        for i in range(options.repeat):
+            r = run_scenario(options.ns3_dir, options.scenario, args, SUITE_ENV)
+            match = re.search(r"Simulator: events=(\d+) runSeconds=([\d.e+-]+)", r["stdout"])
+            if match is None:
+                sys.exit("%s printed no Simulator line, does it include instrumented-simulator-impl.h?" % options.scenario)
+            runs.append((float(match.group(2)), int(match.group(1)), r["rss_kb"]))
+        runs.sort()
+        seconds, events, rss_kb = runs[len(runs) // 2]
+        if first is None:
+            first = seconds
+        print("%-18s %10.3f %10.2f %12d %12.0f %10.1f" % (
+            name, seconds, seconds / first if first else 0, events, events / seconds if seconds else 0, rss_kb / 1024))
+
+
+COUNTERS = ["cycles", "instructions", "cacheMisses", "branchMisses"]
+
+
+def perf_counters(ns3_dir, scenario, args, repeat):
+    """Per-packet hardware counters by scope, of the run with the median cycles"""
+    runs = []
+    for i in range(repeat):
+        output = run_scenario(ns3_dir, scenario, ["--perfCounters=1"] + args)["stdout"]
+        match = re.search(r"PerfCounters: unavailable \((.*)\)", output)
+        if match is not None:
+            sys.exit("No hardware counters: %s" % match.group(1))
+        scopes = {}
+        for line in output.splitlines():
+            if line.startswith("PerfCounters: scope="):
+                fields = dict(field.split("=", 1) for field in line.split()[1:])
+                scopes[fields["scope"]] = fields
+        if not scopes:
+            sys.exit("%s printed no PerfCounters lines, does it use PerfScopes?" % scenario)
+        runs.append(scopes)
+    runs.sort(key=lambda scopes: int(scopes["run"]["cycles"]) if "run" in scopes else 0)
+    return runs[len(runs) // 2]
+
+
+def counters_report(options):
+    """Hardware counters per simulated packet, by scope, optionally against another ns-3 build"""
+    current = perf_counters(options.ns3_dir, options.scenario, options.args, options.repeat)
+    baseline = None
+    if options.against:
+        baseline = perf_counters(options.against, options.scenario, options.args, options.repeat)
+    print("Hardware counters per packet for %s (median of %d runs)" % (options.scenario, options.repeat))
+    print("%-10s %-14s %14s %14s %10s" % ("scope", "counter", "per packet", "baseline", "change"))
+    for scope in sorted(current):
+        fields = current[scope]
+        for counter in COUNTERS:
+            value = float(fields[counter + "PerPacket"])
+            if baseline is not None and scope in baseline:
+                base = float(baseline[scope][counter + "PerPacket"])
+                change = "%+.1f%%" % ((value - base) * 100 / base) if base else "-"
+                print("%-10s %-14s %14.1f %14.1f %10s" % (scope, counter, value, base, change))
+            else:
+                print("%-10s %-14s %14.1f %14s %10s" % (scope, counter, value, "-", "-"))
+        print("%-10s %-14s %14.2f" % (scope, "ipc", float(fields["ipc"])))
+
+
+#Scenario, its scale argument (None if it has none), the scales and the fixed arguments
+SUITE = [
+    ("Use-Case-Final-Version", "numberOfNodes", [2, 8, 32], ["--profile=lean", "--simTime=2"]),
+    ("lte_UE_eNB", "numberOfNodes", [10, 50, 200], ["--profile=lean", "--simTime=0.5"]),
+    ("LTE_UE_to_UE", "numberOfNodes", [2, 8, 32], ["--profile=lean", "--simTime=1"]),
+    ("LTE_UE_UE_PacketDelay", "numberOfNodes", [2, 8, 32], ["--profile=lean", "--simTime=1"]),
+    ("lteUE_UE_pdcp", "numberOfNodes", [2, 8, 32], ["--profile=lean", "--simTime=1"]),
+    #the STAs start on a 3-wide grid, 10 m apart, inside walk bounds of +-50 m: at most 18 of them
+    ("Lte_Wifi", "nWifi", [1, 8, 18], []),
+    ("wifi_example1", "nWifi", [3, 9, 18], []),
+    ("UEs", None, [None], []),
+    ("wifi-hidden-terminal-modified", None, [None], []),
+]
+
+#Fixed seeds and the event counts of InstrumentedSimulatorImpl, also for scripts without a CommandLine
+SUITE_ENV = {
+    "NS_GLOBAL_VALUE": "RngSeed=1;RngRun=1;SimulatorImplementationType=ns3::InstrumentedSimulatorImpl",
+    "NS_ATTRIBUTE_DEFAULT": "ns3::InstrumentedSimulatorImpl::PrintSummary=true",
+}
+
+#Metrics compared with the baseline, and whether higher is better
+SUITE_METRICS = [("wall", False), ("events_per_second", True), ("rss_kb", False)]
+
+
+def suite_case(ns3_dir, scenario, scale_arg, scale, args, repeat):
+    """Median run of one scenario at one scale"""
+    if scale_arg is not None:
+        args = ["--%s=%d" % (scale_arg, scale)] + args
+    runs = []
+    for i in range(repeat):
+        r = run_scenario(ns3_dir, scenario, args, SUITE_ENV)
+        #scripts that run several experiments print a Simulator line per Simulator::Run ()
+        summaries = re.findall(r"Simulator: events=(\d+) runSeconds=([\d.e+-]+)", r["stdout"])
+        if not summaries:
+            sys.exit("%s printed no Simulator line, does it include instrumented-simulator-impl.h?" % scenario)
+        events = sum(int(e) for e, seconds in summaries)
+        seconds = sum(float(seconds) for e, seconds in summaries)
+        runs.append({"wall": r["wall"],
+                     "events": events,
+                     "events_per_second": events / seconds if seconds > 0 else 0,
+                     "rss_kb": r["rss_kb"],
+                     "checksum": r["checksum"]})
+    runs.sort(key=lambda r: r["wall"])
+    median = runs[len(runs) // 2]
+    median["deterministic"] = len(set(r["checksum"] for r in runs)) == 1
+    return median
+
+
+def suite_report(options):
+    """Runs every suite scenario at every scale, appends the results to the history and checks them against the baseline"""
+    results = {}
+    print("%-30s %6s %10s %10s %14s %10s  %s" % ("scenario", "scale", "wall [s]", "events", "events/s", "RSS [MB]", "checksum"))
+    for scenario, scale_arg, scales, args in SUITE:
+        if options.only and scenario not in options.only:
+            continue
+        for scale in scales:
+            key = scenario if scale is None else "%s/%s=%d" % (scenario, scale_arg, scale)
+            r = suite_case(options.ns3_dir, scenario, scale_arg, scale, args, options.repeat)
+            results[key] = r
+            print("%-30s %6s %10.3f %10d %14.0f %10.1f  %s%s" % (
+                scenario, "-" if scale is None else scale, r["wall"], r["events"], r["events_per_second"],
+                r["rss_kb"] / 1024, r["checksum"][:12], "" if r["deterministic"] else " (differs between runs)"))
+
+    entry = {"time": time.strftime("%Y-%m-%dT%H:%M:%S"),
+             "host": platform.node(),
+             "repeat": options.repeat,
+             "results": results}
+    if options.history:
+        history = []
+        if os.path.exists(options.history):
+            history = json.load(open(options.history))
+        history.append(entry)
+        with open(options.history, "w") as f:
+            json.dump(history, f, indent=1, sort_keys=True)
+    if options.save_baseline:
+        with open(options.baseline, "w") as f:
+            json.dump(entry, f, indent=1, sort_keys=True)
+        print("Saved the baseline to %s" % options.baseline)
+        return
+    if not options.baseline or not os.path.exists(options.baseline):
+        return
+
+    baseline = json.load(open(options.baseline))["results"]
+    failures = []
+    for key in sorted(results):
+        if key not in baseline:
+            continue
+        for metric, higher_is_better in SUITE_METRICS:
+            base = baseline[key][metric]
+            value = results[key][metric]
+            if not base:
+                continue
+            change = (value - base) * 100 / base
+            regression = -change if higher_is_better else change
+            if regression > options.threshold:
+                failures.append("%s: %s %.4g -> %.4g (%+.1f%%)" % (key, metric, base, value, change))
+        if results[key]["checksum"] != baseline[key]["checksum"] and not options.allow_output_change:
+            failures.append("%s: output checksum changed" % key)
+    if failures:
+        print("Regressions against %s (threshold %.1f%%):" % (options.baseline, options.threshold))
+        for failure in failures:
+            print("  " + failure)
+        sys.exit(1)
+    print("No regressions against %s (threshold %.1f%%)" % (options.baseline, options.threshold))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmarks the LTE-Delays scenario scripts")
+    parser.add_argument("--ns3-dir", default=".", help="ns-3 top-level directory")
+    parser.add_argument("--repeat", type=int, default=3, help="runs per measurement")
+    commands = parser.add_subparsers(dest="command")
+
+    profiles = commands.add_parser("profiles", help="speed and memory cost of each run profile feature")
+    profiles.add_argument("scenario", help="scratch program, e.g. Use-Case-Final-Version")
+    profiles.add_argument("args", nargs="*", help="extra scenario arguments after --, e.g. -- --simTime=5")
+    profiles.set_defaults(run=profiles_report)
+
+    startup = commands.add_parser("startup", help="time to first packet against the number of UEs")
+    startup.add_argument("scenario", nargs="?", default="lte_UE_eNB", help="scratch program printing a Startup line")
+    startup.add_argument("--nodes", type=int, nargs="+", default=[10, 50, 100, 200],
+                         help="values of --numberOfNodes to measure")
+    startup.add_argument("--lazy", action="store_true", help="also measure with --lazyApps=1")
+    startup.add_argument("--profile", default="lean", help="run profile of the measured runs")
+    startup.add_argument("args", nargs="*", help="extra scenario arguments after --")
+    startup.set_defaults(run=startup_report)
+
+    memory = commands.add_parser("memory", help="heap per UE by setup phase, default against compact UEs")
+    memory.add_argument("scenario", nargs="?", default="lte_UE_eNB", help="scratch program using MemoryAudit")
+    memory.add_argument("--nodes", type=int, default=200, help="value of --numberOfNodes")
+    memory.add_argument("args", nargs="*", help="extra scenario arguments after --")
+    memory.set_defaults(run=memory_report)
+
+    sampling = commands.add_parser("sampling", help="run time of FlowMonitor against the sampled flow tracker")
+    sampling.add_argument("scenario", nargs="?", default="lte_UE_eNB", help="scratch program with --sampling")
+    sampling.add_argument("--nodes", type=int, default=200, help="value of --numberOfNodes")
+    sampling.add_argument("--sampling", type=int, default=100, help="value of --sampling of the sampled run")
+    sampling.add_argument("args", nargs="*", help="extra scenario arguments after --")
+    sampling.set_defaults(run=sampling_report)
+
+    counters = commands.add_parser("counters", help="cycles, instructions, cache and branch misses per packet by scope")
+    counters.add_argument("scenario", nargs="?", default="Use-Case-Final-Version", help="scratch program using PerfScopes")
+    counters.add_argument("--against", help="top-level directory of another ns-3 build to compare with")
+    counters.add_argument("args", nargs="*", help="extra scenario arguments after --")
+    counters.set_defaults(run=counters_report)
+
+    suite = commands.add_parser("suite", help="every scenario at several scales, checked against a baseline")
+    suite.add_argument("--only", nargs="+", help="run only these scenarios")
+    suite.add_argument("--history", default="benchmark-history.json", help="JSON file the results are appended to")
+    suite.add_argument("--baseline", default="benchmark-baseline.json", help="JSON file of the results to compare with")
+    suite.add_argument("--save-baseline", action="store_true", help="store the results as the baseline instead of comparing")
+    suite.add_argument("--threshold", type=float, default=10, help="regression [%%] of wall time, events/s or peak RSS that fails")
+    suite.add_argument("--allow-output-change", action="store_true", help="do not fail on changed output checksums")
+    suite.set_defaults(run=suite_report)
+
+    options = parser.parse_args()
+    if not hasattr(options, "run"):
+        parser.print_help()
+        sys.exit(1)
+    options.run(options)
+
+
+if __name__ == "__main__":
+    main()
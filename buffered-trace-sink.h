@@ -0,0 +1,285 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BUFFERED_TRACE_SINK_H
+#define BUFFERED_TRACE_SINK_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <streambuf>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/wifi-module.h"
+
+#include "async-trace-writer.h"
+
+namespace ns3 {
+
+/**
+ * One AsyncTraceWriter behind the ASCII and the pcap traces of a script,
+ * in place of the std::ofstream of AsciiTraceHelper::CreateFileStream () and
+ * the PcapFileWrapper of the EnablePcap* methods, which format and write
+ * every trace event on the simulation thread.
+ *
+ * CreateFileStream () hands the helpers' EnableAscii* methods a stream
+ * whose bytes go into the writer's buffers; std::endl no longer flushes.
+ * EnablePcap () connects the sniffer traces of CSMA and point-to-point
+ * devices, and PhyTxBegin / PhyRxEnd of the WifiPhy, which carry the same
+ * packets as the monitor sniffers of the 802.11 pcap, and writes the pcap
+ * records into the writer. The files have the names the helpers give them.
+ *
+ * Call Close () after Simulator::Run (); it also prints how much was
+ * written and how often the simulation had to wait for the disk.
+ */
+class BufferedTraceSink
+{
+public:
+  BufferedTraceSink (uint32_t bufferBytes = 1 << 20, uint32_t maxQueued = 64)
+    : m_writer (bufferBytes, maxQueued),
+      m_closed (false)
+  {
+  }
+
+  ~BufferedTraceSink ()
+  {
+    Close ();
+    for (uint32_t i = 0; i < m_streams.size (); ++i)
+      {
+        delete m_streams[i];
+        delete m_streambufs[i];
+      }
+    for (uint32_t i = 0; i < m_contexts.size (); ++i)
+      {
+        delete m_contexts[i];
+      }
+  }
+
+  /// \return an ASCII trace stream for the EnableAscii* methods of a helper
+  Ptr<OutputStreamWrapper> CreateFileStream (std::string filename)
+  {
+    Streambuf *streambuf = new Streambuf (this, Open (filename));
+    std::ostream *stream = new std::ostream (streambuf);
+    m_streambufs.push_back (streambuf);
+    m_streams.push_back (stream);
+    return Create<OutputStreamWrapper> (stream);
+  }
+
+  /// Captures every supported device that exists so far, like the EnablePcapAll () of the helpers
+  void EnablePcapAll (std::string prefix, bool promiscuous = true)
+  {
+    for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); ++node)
+      {
+        for (uint32_t i = 0; i < (*node)->GetNDevices (); ++i)
+          {
+            Ptr<NetDevice> device = (*node)->GetDevice (i);
+            if (GetDataLinkType (device) != 0)
+              {
+                EnablePcap (prefix, device, promiscuous);
+              }
+          }
+      }
+  }
+
+  /// Captures a CsmaNetDevice, PointToPointNetDevice or WifiNetDevice into <prefix>-<node>-<device>.pcap
+  void EnablePcap (std::string prefix, Ptr<NetDevice> device, bool promiscuous = true)
+  {
+    uint32_t dataLinkType = GetDataLinkType (device);
+    if (dataLinkType == 0)
+      {
+        NS_FATAL_ERROR ("Cannot capture " << device->GetInstanceTypeId ().GetName ());
+      }
+    PcapHelper pcapHelper;
+    uint32_t file = Open (pcapHelper.GetFilenameFromDevice (prefix, device));
+    PcapFileHeader header;
+    header.magic = 0xa1b2c3d4;
+    header.versionMajor = 2;
+    header.versionMinor = 4;
+    header.zone = 0;
+    header.sigfigs = 0;
+    header.snapLength = SNAP_LENGTH;
+    header.dataLinkType = dataLinkType;
+    m_writer.Write (file, &header, sizeof (header));
+
+    Context *context = new Context;
+    context->sink = this;
+    context->file = file;
+    m_contexts.push_back (context);
+    Callback<void, Ptr<const Packet> > sniffer = MakeBoundCallback (&BufferedTraceSink::Sniff, context);
+    Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice> (device);
+    if (wifi != 0)
+      {
+        wifi->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin", sniffer);
+        wifi->GetPhy ()->TraceConnectWithoutContext ("PhyRxEnd", sniffer);
+      }
+    else
+      {
+        device->TraceConnectWithoutContext (promiscuous ? "PromiscSniffer" : "Sniffer", sniffer);
+      }
+  }
+
+  /// Writes what is buffered and closes the files
+  void Close (void)
+  {
+    if (m_closed)
+      {
+        return;
+      }
+    m_closed = true;
+    std::string error;
+    if (!m_writer.Close (error))
+      {
+        NS_FATAL_ERROR ("Cannot write traces: " << error);
+      }
+    std::cout << "TraceSink: " << m_writer.GetBytes () << " bytes, " << m_writer.GetStalls () << " stalls, "
+              << m_writer.GetStallSeconds () << " s waiting for the disk\n";
+  }
+
+private:
+  static const uint32_t SNAP_LENGTH = 65535;
+
+  struct PcapFileHeader
+  {
+    uint32_t magic;
+    uint16_t versionMajor;
+    uint16_t versionMinor;
+    int32_t zone;
+    uint32_t sigfigs;
+    uint32_t snapLength;
+    uint32_t dataLinkType;
+  };
+
+  struct PcapRecordHeader
+  {
+    uint32_t seconds;
+    uint32_t microseconds;
+    uint32_t includedLength;
+    uint32_t originalLength;
+  };
+
+  /// File a bound sniffer trace writes to
+  struct Context
+  {
+    BufferedTraceSink *sink;
+    uint32_t file;
+  };
+
+  /// Puts what an ASCII trace stream is given into the writer
+  class Streambuf : public std::streambuf
+  {
+  public:
+    Streambuf (BufferedTraceSink *sink, uint32_t file)
+      : m_sink (sink),
+        m_file (file)
+    {
+    }
+
+  protected:
+    std::streamsize xsputn (const char *s, std::streamsize n)
+    {
+      m_sink->Write (m_file, s, n);
+      return n;
+    }
+
+    int_type overflow (int_type c)
+    {
+      if (!traits_type::eq_int_type (c, traits_type::eof ()))
+        {
+          char ch = traits_type::to_char_type (c);
+          m_sink->Write (m_file, &ch, 1);
+        }
+      return traits_type::not_eof (c);
+    }
+
+  private:
+    BufferedTraceSink *m_sink;
+    uint32_t m_file;
+  };
+
+  uint32_t Open (std::string filename)
+  {
+    std::string error;
+    int file = m_writer.Open (filename, error);
+    if (file < 0)
+      {
+        NS_FATAL_ERROR ("Cannot write traces: " << error);
+      }
+    return file;
+  }
+
+  void Write (uint32_t file, const void *data, uint32_t size)
+  {
+    // the devices may outlive Close () by a few trace events
+    if (!m_closed)
+      {
+        m_writer.Write (file, data, size);
+      }
+  }
+
+  /// \return the pcap data link type of device, 0 if it cannot be captured
+  static uint32_t GetDataLinkType (Ptr<NetDevice> device)
+  {
+    if (DynamicCast<CsmaNetDevice> (device) != 0)
+      {
+        return PcapHelper::DLT_EN10MB;
+      }
+    if (DynamicCast<PointToPointNetDevice> (device) != 0)
+      {
+        return PcapHelper::DLT_PPP;
+      }
+    if (DynamicCast<WifiNetDevice> (device) != 0)
+      {
+        return PcapHelper::DLT_IEEE802_11;
+      }
+    return 0;
+  }
+
+  static void Sniff (Context *context, Ptr<const Packet> packet)
+  {
+    context->sink->WritePacket (context->file, packet);
+  }
+
+  void WritePacket (uint32_t file, Ptr<const Packet> packet)
+  {
+    uint64_t us = Simulator::Now ().GetMicroSeconds ();
+    PcapRecordHeader header;
+    header.seconds = us / 1000000;
+    header.microseconds = us % 1000000;
+    header.originalLength = packet->GetSize ();
+    header.includedLength = header.originalLength < SNAP_LENGTH ? header.originalLength : SNAP_LENGTH;
+    m_packet.resize (header.includedLength);
+    if (header.includedLength > 0)
+      {
+        packet->CopyData (&m_packet[0], header.includedLength);
+      }
+    Write (file, &header, sizeof (header));
+    Write (file, m_packet.empty () ? 0 : &m_packet[0], m_packet.size ());
+  }
+
+  AsyncTraceWriter m_writer;
+  bool m_closed;
+  std::vector<Streambuf *> m_streambufs;
+  std::vector<std::ostream *> m_streams;
+  std::vector<Context *> m_contexts;
+  std::vector<uint8_t> m_packet;        ///< bytes of the packet being written, reused
+};
+
+} // namespace ns3
+
+#endif // BUFFERED_TRACE_SINK_H
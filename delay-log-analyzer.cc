@@ -0,0 +1,907 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "delay-log-format.h"
+
+/**
+ * Analyzes the per-packet delay logs of Use-Case-Final-Version.cc, the native
+ * replacement of load_data.m.
+ *
+ * Reads text logs ("Input Delay: X ms" and "Output Delay: X ms" lines, other
+ * lines are skipped) and binary logs (--delayLog, delay-log-format.h), told
+ * apart by their first bytes. Every file is streamed in fixed blocks; per
+ * series only running sums and a histogram of --bin-width wide bins are
+ * kept. Quantiles and the CDF are read from that histogram and are exact to
+ * one bin width.
+ *
+ * Input and output delays are paired for their correlation like load_data.m
+ * did, the n-th input with the n-th output (--pair=index), or for binary logs
+ * by packet (--pair=uid): the input delays a packet collected on its hops are
+ * summed and paired with its output delay. Inputs without an output after
+ * --pair-window seconds count as unpaired. Every file is a run of its own,
+ * so delays are only paired with delays of the same file.
+ *
+ * Memory is bounded by the pairing, not by the statistics. --pair=index
+ * keeps at most MAX_WAITING (2^20) delays of the side that is ahead, 16 MB;
+ * a log with far more inputs than outputs, as the binary logs with one input
+ * per hop, or one without inputs, as the text logs, drops the oldest and
+ * counts them as unpaired. --pair=uid keeps every packet that had an input
+ * within the last --pair-window seconds, some 100 bytes each.
+ *
+ * --output=PREFIX writes plot-ready PREFIX-histogram.csv (--bins equal bins
+ * between min and max, as hist (x, 20) drew them) and PREFIX-cdf.csv.
+ *
+ * The block kernels keep four independent lanes of sums so the compiler can
+ * map them to SIMD registers without -ffast-math. Needs no ns-3, build it on
+ * its own with
+ *   g++ -O3 -o delay-log-analyzer delay-log-analyzer.cc
+ *
+ * Usage: delay-log-analyzer [--bin-width=MS] [--bins=N] [--pair=index|uid]
+ *                           [--pair-window=S] [--output=PREFIX] file...
+ */
+
+namespace {
+
+/// Samples handled per block
+const uint32_t BLOCK = 4096;
+/// Histogram bins a series may span before --bin-width has to be raised
+const int64_t MAX_BINS = 1 << 24;
+/// Delays of one side that wait for the other side in --pair=index
+const size_t MAX_WAITING = 1 << 20;
+
+struct Options
+{
+  double binWidth;
+  uint32_t bins;
+  bool pairByUid;
+  double pairWindow;
+  std::string prefix;
+};
+
+/**
+ * Delay records of one file, one block at a time. Text lines become records
+ * without time and uid.
+ */
+class DelaySource
+{
+public:
+  DelaySource (const std::string &filename)
+    : m_filename (filename),
+      m_opened (false),
+      m_binary (0),
+      m_text (0),
+      m_buffer ((1 << 20) + 2),
+      m_begin (0),
+      m_end (0),
+      m_eof (false)
+  {
+  }
+
+  ~DelaySource ()
+  {
+    Close ();
+  }
+
+  /// \return the number of records read, 0 once the file is done or on error
+  uint32_t Next (DelayLogRecord *records, uint32_t maxRecords, std::string &error)
+  {
+    if (!m_opened)
+      {
+        m_opened = true;
+        if (!Open (error))
+          {
+            return 0;
+          }
+      }
+    uint32_t n = 0;
+    if (m_binary != 0)
+      {
+        n = m_binary->Read (records, maxRecords);
+      }
+    else if (m_text != 0)
+      {
+        n = ReadText (records, maxRecords);
+      }
+    if (n == 0)
+      {
+        Close ();
+      }
+    return n;
+  }
+
+private:
+  bool Open (std::string &error)
+  {
+    FILE *file = fopen (m_filename.c_str (), "rb");
+    if (file == 0)
+      {
+        error = "cannot read " + m_filename;
+        return false;
+      }
+    DelayLogHeader header;
+    bool binary = fread (&header, sizeof (header), 1, file) == 1 && DelayLogReader::IsDelayLog (header);
+    if (binary)
+      {
+        fclose (file);
+        m_binary = new DelayLogReader;
+        return m_binary->Open (m_filename, error);
+      }
+    rewind (file);
+    m_text = file;
+    m_begin = m_end = 0;
+    m_eof = false;
+    return true;
+  }
+
+  void Close (void)
+  {
+    delete m_binary;
+    m_binary = 0;
+    if (m_text != 0)
+      {
+        fclose (m_text);
+        m_text = 0;
+      }
+  }
+
+  /// Parses whole lines out of the buffer, refilling it when only a partial line is left
+  uint32_t ReadText (DelayLogRecord *records, uint32_t maxRecords)
+  {
+    uint32_t n = 0;
+    while (n < maxRecords)
+      {
+        char *line = &m_buffer[m_begin];
+        char *newline = static_cast<char *> (memchr (line, '\n', m_end - m_begin));
+        if (newline == 0)
+          {
+            if (!Refill ())
+              {
+                break;
+              }
+            continue;
+          }
+        m_begin = newline - &m_buffer[0] + 1;
+        if (ParseLine (line, records[n]))
+          {
+            ++n;
+          }
+      }
+    return n;
+  }
+
+  /// \return false at the end of the file; a last line without newline is ended here
+  bool Refill (void)
+  {
+    size_t left = m_end - m_begin;
+    if (left == m_buffer.size () - 2)
+      {
+        // a line longer than the buffer cannot be a delay line, drop it
+        left = 0;
+      }
+    memmove (&m_buffer[0], &m_buffer[m_begin], left);
+    m_begin = 0;
+    m_end = left;
+    if (m_eof)
+      {
+        if (m_end == 0)
+          {
+            return false;
+          }
+        m_buffer[m_end++] = '\n';
+        m_buffer[m_end] = '\0';
+        return true;
+      }
+    size_t got = fread (&m_buffer[m_end], 1, m_buffer.size () - 2 - m_end, m_text);
+    m_end += got;
+    m_buffer[m_end] = '\0';
+    m_eof = got == 0;
+    return true;
+  }
+
+  static bool ParseLine (const char *line, DelayLogRecord &record)
+  {
+    const char *value;
+    if (strncmp (line, "Output Delay:", 13) == 0)
+      {
+        record.kind = DELAY_LOG_OUTPUT;
+        value = line + 13;
+      }
+    else if (strncmp (line, "Input Delay:", 12) == 0)
+      {
+        record.kind = DELAY_LOG_INPUT;
+        value = line + 12;
+      }
+    else
+      {
+        return false;
+      }
+    char *end;
+    record.delayMs = strtod (value, &end);
+    record.timeNs = 0;
+    record.uid = 0;
+    record.reserved = 0;
+    // NaN compares false, so only finite delays pass
+    return end != value && std::fabs (record.delayMs) <= DBL_MAX;
+  }
+
+  std::string m_filename;
+  bool m_opened;
+  DelayLogReader *m_binary;
+  FILE *m_text;
+  std::vector<char> m_buffer;
+  size_t m_begin;
+  size_t m_end;
+  bool m_eof;
+};
+
+/// Running sums, extremes and histogram of one delay series
+class DelaySeries
+{
+public:
+  DelaySeries (double binWidth)
+    : m_binWidth (binWidth),
+      m_count (0),
+      m_shift (0),
+      m_sum (0),
+      m_sumSq (0),
+      m_min (0),
+      m_max (0),
+      m_firstBin (0)
+  {
+  }
+
+  /// \return false if the values would span more than MAX_BINS bins
+  bool Add (const double *x, uint32_t n)
+  {
+    if (n == 0)
+      {
+        return true;
+      }
+    if (m_count == 0)
+      {
+        // sums are taken around the first value so their squares do not cancel out
+        m_shift = x[0];
+        m_min = m_max = x[0];
+        m_firstBin = Bin (x[0]);
+      }
+    double s[4] = { 0, 0, 0, 0 };
+    double q[4] = { 0, 0, 0, 0 };
+    double lo[4] = { m_min, m_min, m_min, m_min };
+    double hi[4] = { m_max, m_max, m_max, m_max };
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4)
+      {
+        for (uint32_t j = 0; j < 4; ++j)
+          {
+            double d = x[i + j] - m_shift;
+            s[j] += d;
+            q[j] += d * d;
+            lo[j] = x[i + j] < lo[j] ? x[i + j] : lo[j];
+            hi[j] = x[i + j] > hi[j] ? x[i + j] : hi[j];
+          }
+      }
+    for (; i < n; ++i)
+      {
+        double d = x[i] - m_shift;
+        s[0] += d;
+        q[0] += d * d;
+        lo[0] = std::min (lo[0], x[i]);
+        hi[0] = std::max (hi[0], x[i]);
+      }
+    m_sum += (s[0] + s[1]) + (s[2] + s[3]);
+    m_sumSq += (q[0] + q[1]) + (q[2] + q[3]);
+    m_min = std::min (std::min (lo[0], lo[1]), std::min (lo[2], lo[3]));
+    m_max = std::max (std::max (hi[0], hi[1]), std::max (hi[2], hi[3]));
+    m_count += n;
+
+    int64_t first = std::min (m_firstBin, Bin (m_min));
+    int64_t last = Bin (m_max);
+    if (last - first >= MAX_BINS)
+      {
+        return false;
+      }
+    if (first < m_firstBin)
+      {
+        m_counts.insert (m_counts.begin (), m_firstBin - first, 0);
+        m_firstBin = first;
+      }
+    if (last - first >= (int64_t) m_counts.size ())
+      {
+        m_counts.resize (last - first + 1, 0);
+      }
+    int64_t bins[BLOCK];
+    for (uint32_t start = 0; start < n; start += BLOCK)
+      {
+        uint32_t end = std::min (n, start + BLOCK);
+        for (uint32_t k = start; k < end; ++k)
+          {
+            // floor () of the same division as Bin (), which sized m_counts; a
+            // multiplication by the reciprocal may round across a bin edge
+            double t = x[k] / m_binWidth;
+            int64_t b = static_cast<int64_t> (t);
+            bins[k - start] = b - (t < b) - m_firstBin;
+          }
+        for (uint32_t k = start; k < end; ++k)
+          {
+            ++m_counts[bins[k - start]];
+          }
+      }
+    return true;
+  }
+
+  uint64_t GetCount (void) const
+  {
+    return m_count;
+  }
+
+  double GetMean (void) const
+  {
+    return m_count > 0 ? m_shift + m_sum / m_count : 0;
+  }
+
+  double GetStdDev (void) const
+  {
+    if (m_count < 2)
+      {
+        return 0;
+      }
+    double variance = (m_sumSq - m_sum * m_sum / m_count) / (m_count - 1);
+    return variance > 0 ? std::sqrt (variance) : 0;
+  }
+
+  double GetMin (void) const
+  {
+    return m_min;
+  }
+
+  double GetMax (void) const
+  {
+    return m_max;
+  }
+
+  /// Quantiles for q sorted ascending, interpolated linearly inside their bin
+  void GetQuantiles (const std::vector<double> &q, std::vector<double> &values) const
+  {
+    values.assign (q.size (), 0);
+    uint64_t seen = 0;
+    uint32_t k = 0;
+    for (int64_t i = 0; i < (int64_t) m_counts.size () && k < q.size (); ++i)
+      {
+        uint64_t c = m_counts[i];
+        while (k < q.size () && c > 0 && seen + c >= q[k] * m_count)
+          {
+            double fraction = (q[k] * m_count - seen) / c;
+            values[k++] = std::max (m_min, std::min (m_max, (m_firstBin + i + fraction) * m_binWidth));
+          }
+        seen += c;
+      }
+  }
+
+  /// Writes series,delayMs,cdf for the upper edge of every non-empty bin
+  void WriteCdf (FILE *file, const char *name) const
+  {
+    uint64_t seen = 0;
+    for (int64_t i = 0; i < (int64_t) m_counts.size (); ++i)
+      {
+        if (m_counts[i] == 0)
+          {
+            continue;
+          }
+        seen += m_counts[i];
+        fprintf (file, "%s,%.9g,%.9g\n", name, (m_firstBin + i + 1) * m_binWidth, (double) seen / m_count);
+      }
+  }
+
+  /// Writes series,binStart,binEnd,count,density for bins equal bins between min and max
+  void WriteHistogram (FILE *file, const char *name, uint32_t bins) const
+  {
+    if (m_count == 0)
+      {
+        return;
+      }
+    double width = (m_max - m_min) / bins;
+    std::vector<uint64_t> coarse (bins, 0);
+    for (int64_t i = 0; i < (int64_t) m_counts.size (); ++i)
+      {
+        double center = (m_firstBin + i + 0.5) * m_binWidth;
+        int64_t b = width > 0 ? static_cast<int64_t> ((center - m_min) / width) : 0;
+        coarse[std::max<int64_t> (0, std::min<int64_t> (bins - 1, b))] += m_counts[i];
+      }
+    for (uint32_t b = 0; b < bins; ++b)
+      {
+        fprintf (file, "%s,%.9g,%.9g,%llu,%.9g\n", name, m_min + b * width, m_min + (b + 1) * width,
+                 (unsigned long long) coarse[b], width > 0 ? coarse[b] / (width * m_count) : 0.0);
+      }
+  }
+
+private:
+  int64_t Bin (double x) const
+  {
+    return static_cast<int64_t> (std::floor (x / m_binWidth));
+  }
+
+  double m_binWidth;
+  uint64_t m_count;
+  double m_shift;
+  double m_sum;
+  double m_sumSq;
+  double m_min;
+  double m_max;
+  int64_t m_firstBin;
+  std::vector<uint64_t> m_counts;
+};
+
+/// Running sums of input/output delay pairs for their correlation and linear fit
+class DelayCorrelation
+{
+public:
+  DelayCorrelation ()
+    : m_count (0),
+      m_shiftX (0),
+      m_shiftY (0),
+      m_sx (0),
+      m_sy (0),
+      m_sxx (0),
+      m_syy (0),
+      m_sxy (0)
+  {
+  }
+
+  void Add (const double *x, const double *y, uint32_t n)
+  {
+    if (n == 0)
+      {
+        return;
+      }
+    if (m_count == 0)
+      {
+        m_shiftX = x[0];
+        m_shiftY = y[0];
+      }
+    double sx[4] = { 0, 0, 0, 0 };
+    double sy[4] = { 0, 0, 0, 0 };
+    double sxx[4] = { 0, 0, 0, 0 };
+    double syy[4] = { 0, 0, 0, 0 };
+    double sxy[4] = { 0, 0, 0, 0 };
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4)
+      {
+        for (uint32_t j = 0; j < 4; ++j)
+          {
+            double dx = x[i + j] - m_shiftX;
+            double dy = y[i + j] - m_shiftY;
+            sx[j] += dx;
+            sy[j] += dy;
+            sxx[j] += dx * dx;
+            syy[j] += dy * dy;
+            sxy[j] += dx * dy;
+          }
+      }
+    for (; i < n; ++i)
+      {
+        double dx = x[i] - m_shiftX;
+        double dy = y[i] - m_shiftY;
+        sx[0] += dx;
+        sy[0] += dy;
+        sxx[0] += dx * dx;
+        syy[0] += dy * dy;
+        sxy[0] += dx * dy;
+      }
+    m_sx += (sx[0] + sx[1]) + (sx[2] + sx[3]);
+    m_sy += (sy[0] + sy[1]) + (sy[2] + sy[3]);
+    m_sxx += (sxx[0] + sxx[1]) + (sxx[2] + sxx[3]);
+    m_syy += (syy[0] + syy[1]) + (syy[2] + syy[3]);
+    m_sxy += (sxy[0] + sxy[1]) + (sxy[2] + sxy[3]);
+    m_count += n;
+  }
+
+  uint64_t GetCount (void) const
+  {
+    return m_count;
+  }
+
+  /// Pearson correlation coefficient, 0 if either side is constant
+  double GetCorrelation (void) const
+  {
+    double cxx = m_count * m_sxx - m_sx * m_sx;
+    double cyy = m_count * m_syy - m_sy * m_sy;
+    return cxx > 0 && cyy > 0 ? (m_count * m_sxy - m_sx * m_sy) / std::sqrt (cxx * cyy) : 0;
+  }
+
+  /// Least squares fit output = slope * input + intercept
+  void GetFit (double &slope, double &intercept) const
+  {
+    double cxx = m_count * m_sxx - m_sx * m_sx;
+    slope = cxx > 0 ? (m_count * m_sxy - m_sx * m_sy) / cxx : 0;
+    double meanX = m_count > 0 ? m_shiftX + m_sx / m_count : 0;
+    double meanY = m_count > 0 ? m_shiftY + m_sy / m_count : 0;
+    intercept = meanY - slope * meanX;
+  }
+
+private:
+  uint64_t m_count;
+  double m_shiftX;
+  double m_shiftY;
+  double m_sx;
+  double m_sy;
+  double m_sxx;
+  double m_syy;
+  double m_sxy;
+};
+
+struct Results
+{
+  Results (double binWidth)
+    : input (binWidth),
+      output (binWidth),
+      unpairedInputs (0),
+      unpairedOutputs (0)
+  {
+  }
+
+  DelaySeries input;
+  DelaySeries output;
+  DelayCorrelation pairs;
+  uint64_t unpairedInputs;
+  uint64_t unpairedOutputs;
+};
+
+/// Splits records into the delays of one kind
+uint32_t
+Select (const DelayLogRecord *records, uint32_t n, uint32_t kind, double *values)
+{
+  uint32_t m = 0;
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      if (records[i].kind == kind)
+        {
+          values[m++] = records[i].delayMs;
+        }
+    }
+  return m;
+}
+
+/**
+ * Pairs the n-th input with the n-th output of every file, in one pass: the
+ * delays of the side that is ahead wait in a queue for the other side. Past
+ * MAX_WAITING delays the oldest are dropped and counted as unpaired, and so
+ * are the delays of the other side that would have been their partners, so
+ * the delays that are paired keep their index. The delays of one file are
+ * never paired with those of another, as every file is a run of its own.
+ */
+bool
+AnalyzeByIndex (const std::vector<std::string> &files, Results &results, std::string &error)
+{
+  std::vector<DelayLogRecord> records (BLOCK);
+  std::vector<double> values[2];
+  for (uint32_t f = 0; f < files.size (); ++f)
+    {
+      DelaySource source (files[f]);
+      values[0].clear ();
+      values[1].clear ();
+      // first delay of each side not paired yet
+      size_t first[2] = { 0, 0 };
+      // delays of each side still to come whose partners were dropped
+      uint64_t skip[2] = { 0, 0 };
+      while (true)
+        {
+          uint32_t n = source.Next (&records[0], BLOCK, error);
+          if (!error.empty ())
+            {
+              return false;
+            }
+          if (n == 0)
+            {
+              break;
+            }
+          for (uint32_t side = 0; side < 2; ++side)
+            {
+              size_t count = values[side].size ();
+              values[side].resize (count + n);
+              uint32_t m = Select (&records[0], n, side == 0 ? DELAY_LOG_INPUT : DELAY_LOG_OUTPUT,
+                                   &values[side][count]);
+              values[side].resize (count + m);
+              if (!(side == 0 ? results.input : results.output).Add (&values[side][count], m))
+                {
+                  error = "delays span too many bins, raise --bin-width";
+                  return false;
+                }
+              // a side with delays to skip has none waiting, they come first
+              uint64_t skipped = std::min<uint64_t> (skip[side], m);
+              first[side] += skipped;
+              skip[side] -= skipped;
+              (side == 0 ? results.unpairedInputs : results.unpairedOutputs) += skipped;
+            }
+          size_t m = std::min (values[0].size () - first[0], values[1].size () - first[1]);
+          if (m > 0)
+            {
+              results.pairs.Add (&values[0][first[0]], &values[1][first[1]], m);
+            }
+          for (uint32_t side = 0; side < 2; ++side)
+            {
+              first[side] += m;
+              size_t waiting = values[side].size () - first[side];
+              if (waiting > MAX_WAITING)
+                {
+                  first[side] += waiting - MAX_WAITING;
+                  skip[1 - side] += waiting - MAX_WAITING;
+                  (side == 0 ? results.unpairedInputs : results.unpairedOutputs) += waiting - MAX_WAITING;
+                }
+              // erase only once half is done with, so every delay moves about once
+              if (first[side] >= BLOCK && first[side] * 2 >= values[side].size ())
+                {
+                  values[side].erase (values[side].begin (), values[side].begin () + first[side]);
+                  first[side] = 0;
+                }
+            }
+        }
+      results.unpairedInputs += values[0].size () - first[0];
+      results.unpairedOutputs += values[1].size () - first[1];
+    }
+  return true;
+}
+
+/// Input delays of a packet still waiting for its output delay
+struct Pending
+{
+  double inputMs;             ///< sum over the hops so far
+  int64_t timeNs;             ///< first input
+};
+
+/**
+ * Pairs the summed input delays of a packet with its output delay, binary
+ * logs only. Uids and times restart in every run, so the packets of one file
+ * are never paired with those of another.
+ */
+bool
+AnalyzeByUid (const std::vector<std::string> &files, int64_t windowNs, Results &results, std::string &error)
+{
+  std::vector<DelayLogRecord> records (BLOCK);
+  std::vector<double> values (BLOCK);
+  std::vector<double> pairX (BLOCK);
+  std::vector<double> pairY (BLOCK);
+  for (uint32_t f = 0; f < files.size (); ++f)
+    {
+      std::map<uint64_t, Pending> pending;
+      std::deque<std::pair<int64_t, uint64_t> > arrivals;
+      DelaySource source (files[f]);
+      while (true)
+        {
+          uint32_t n = source.Next (&records[0], BLOCK, error);
+          if (!error.empty ())
+            {
+              return false;
+            }
+          if (n == 0)
+            {
+              break;
+            }
+          uint32_t inputs = Select (&records[0], n, DELAY_LOG_INPUT, &values[0]);
+          uint32_t outputs = Select (&records[0], n, DELAY_LOG_OUTPUT, &values[inputs]);
+          if (!results.input.Add (&values[0], inputs) || !results.output.Add (&values[inputs], outputs))
+            {
+              error = "delays span too many bins, raise --bin-width";
+              return false;
+            }
+          uint32_t paired = 0;
+          for (uint32_t i = 0; i < n; ++i)
+            {
+              const DelayLogRecord &r = records[i];
+              if (r.timeNs == 0 && r.uid == 0)
+                {
+                  error = "--pair=uid needs binary delay logs";
+                  return false;
+                }
+              while (!arrivals.empty () && arrivals.front ().first < r.timeNs - windowNs)
+                {
+                  std::map<uint64_t, Pending>::iterator it = pending.find (arrivals.front ().second);
+                  if (it != pending.end () && it->second.timeNs == arrivals.front ().first)
+                    {
+                      ++results.unpairedInputs;
+                      pending.erase (it);
+                    }
+                  arrivals.pop_front ();
+                }
+              if (r.kind == DELAY_LOG_INPUT)
+                {
+                  std::pair<std::map<uint64_t, Pending>::iterator, bool> inserted =
+                    pending.insert (std::make_pair (r.uid, Pending ()));
+                  if (inserted.second)
+                    {
+                      inserted.first->second.inputMs = 0;
+                      inserted.first->second.timeNs = r.timeNs;
+                      arrivals.push_back (std::make_pair (r.timeNs, r.uid));
+                    }
+                  inserted.first->second.inputMs += r.delayMs;
+                  continue;
+                }
+              std::map<uint64_t, Pending>::iterator it = pending.find (r.uid);
+              if (it == pending.end ())
+                {
+                  ++results.unpairedOutputs;
+                  continue;
+                }
+              pairX[paired] = it->second.inputMs;
+              pairY[paired] = r.delayMs;
+              ++paired;
+              pending.erase (it);
+            }
+          results.pairs.Add (&pairX[0], &pairY[0], paired);
+        }
+      results.unpairedInputs += pending.size ();
+    }
+  return true;
+}
+
+void
+PrintSeries (const char *name, const DelaySeries &series)
+{
+  static const double q[] = { 0.5, 0.9, 0.99, 0.999 };
+  std::vector<double> quantiles (q, q + 4);
+  std::vector<double> values;
+  series.GetQuantiles (quantiles, values);
+  if (series.GetCount () == 0)
+    {
+      printf ("  %-14s %14u\n", name, 0);
+      return;
+    }
+  printf ("  %-14s %14llu %10.4f %10.4f %10.4f %10.4f %10.4f %10.4f %10.4f %10.4f\n", name,
+          (unsigned long long) series.GetCount (), series.GetMean (), series.GetStdDev (), series.GetMin (),
+          values[0], values[1], values[2], values[3], series.GetMax ());
+}
+
+/// \return false with the reason in error if a file cannot be written
+bool
+WritePlotData (const std::string &prefix, const Options &options, const Results &results, std::string &error)
+{
+  std::string histogram = prefix + "-histogram.csv";
+  FILE *file = fopen (histogram.c_str (), "w");
+  if (file == 0)
+    {
+      error = "cannot write " + histogram;
+      return false;
+    }
+  fprintf (file, "series,binStartMs,binEndMs,count,density\n");
+  results.input.WriteHistogram (file, "input", options.bins);
+  results.output.WriteHistogram (file, "output", options.bins);
+  if (ferror (file) || fclose (file) != 0)
+    {
+      error = "cannot write " + histogram;
+      return false;
+    }
+
+  std::string cdf = prefix + "-cdf.csv";
+  file = fopen (cdf.c_str (), "w");
+  if (file == 0)
+    {
+      error = "cannot write " + cdf;
+      return false;
+    }
+  fprintf (file, "series,delayMs,cdf\n");
+  results.input.WriteCdf (file, "input");
+  results.output.WriteCdf (file, "output");
+  if (ferror (file) || fclose (file) != 0)
+    {
+      error = "cannot write " + cdf;
+      return false;
+    }
+  return true;
+}
+
+void
+Usage (void)
+{
+  std::cerr << "Usage: delay-log-analyzer [--bin-width=MS] [--bins=N] [--pair=index|uid] [--pair-window=S]\n"
+            << "                          [--output=PREFIX] file...\n"
+            << "  --bin-width=MS   resolution of quantiles and CDF (default: 0.01)\n"
+            << "  --bins=N         bins of the plot histogram (default: 20)\n"
+            << "  --pair=index     pair the n-th input with the n-th output delay (default)\n"
+            << "  --pair=uid       pair the summed input delays of a packet with its output delay\n"
+            << "  --pair-window=S  simulated seconds an input waits for its output (default: 10)\n"
+            << "  --output=PREFIX  write PREFIX-histogram.csv and PREFIX-cdf.csv\n";
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  Options options;
+  options.binWidth = 0.01;
+  options.bins = 20;
+  options.pairByUid = false;
+  options.pairWindow = 10;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg.compare (0, 12, "--bin-width=") == 0)
+        {
+          options.binWidth = atof (arg.c_str () + 12);
+        }
+      else if (arg.compare (0, 7, "--bins=") == 0)
+        {
+          options.bins = atoi (arg.c_str () + 7);
+        }
+      else if (arg == "--pair=index" || arg == "--pair=uid")
+        {
+          options.pairByUid = arg == "--pair=uid";
+        }
+      else if (arg.compare (0, 14, "--pair-window=") == 0)
+        {
+          options.pairWindow = atof (arg.c_str () + 14);
+        }
+      else if (arg.compare (0, 9, "--output=") == 0)
+        {
+          options.prefix = arg.substr (9);
+        }
+      else if (arg.compare (0, 2, "--") == 0)
+        {
+          Usage ();
+          return 2;
+        }
+      else
+        {
+          files.push_back (arg);
+        }
+    }
+  if (files.empty () || !(options.binWidth > 0) || options.bins == 0)
+    {
+      Usage ();
+      return 2;
+    }
+
+  Results results (options.binWidth);
+  std::string error;
+  bool ok = options.pairByUid
+    ? AnalyzeByUid (files, static_cast<int64_t> (options.pairWindow * 1e9), results, error)
+    : AnalyzeByIndex (files, results, error);
+  if (!ok)
+    {
+      std::cerr << "delay-log-analyzer: " << error << "\n";
+      return 1;
+    }
+
+  printf ("  %-14s %14s %10s %10s %10s %10s %10s %10s %10s %10s\n", "[ms]", "count", "mean", "stddev",
+          "min", "p50", "p90", "p99", "p99.9", "max");
+  PrintSeries ("input delay", results.input);
+  PrintSeries ("output delay", results.output);
+  double slope, intercept;
+  results.pairs.GetFit (slope, intercept);
+  printf ("Pairs: %llu (by %s), unpaired inputs %llu, unpaired outputs %llu\n",
+          (unsigned long long) results.pairs.GetCount (), options.pairByUid ? "uid" : "index",
+          (unsigned long long) results.unpairedInputs, (unsigned long long) results.unpairedOutputs);
+  printf ("Correlation: r=%.6f output=%.6f*input%+.6f ms\n", results.pairs.GetCorrelation (), slope, intercept);
+
+  if (!options.prefix.empty () && !WritePlotData (options.prefix, options, results, error))
+    {
+      std::cerr << "delay-log-analyzer: " << error << "\n";
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,194 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DELAY_LOG_FORMAT_H
+#define DELAY_LOG_FORMAT_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+/*
+ * Binary per-packet delay log, version 1, the binary form of the
+ * "Input Delay: X ms" and "Output Delay: X ms" lines of
+ * Use-Case-Final-Version.cc. Does not depend on ns-3, so delay-log-analyzer
+ * reads it without linking the simulator.
+ *
+ * Native endian, a DelayLogHeader followed by DelayLogRecords in the order
+ * they were logged, i.e. in simulation time order.
+ */
+
+/// What a record holds
+enum DelayLogKind
+{
+  DELAY_LOG_INPUT = 0,   ///< delay inserted at a device by netDevCb
+  DELAY_LOG_OUTPUT = 1   ///< end-to-end delay measured by the receiving application
+};
+
+struct DelayLogHeader
+{
+  char magic[8];              ///< "DLYLOG" and two NULs
+  uint32_t version;           ///< DELAY_LOG_VERSION
+  uint32_t recordSize;        ///< sizeof (DelayLogRecord) of the writer
+};
+
+struct DelayLogRecord
+{
+  int64_t timeNs;             ///< simulation time the delay was logged at
+  uint64_t uid;               ///< Packet::GetUid (), kept along the path of a packet
+  double delayMs;
+  uint32_t kind;              ///< DelayLogKind
+  uint32_t reserved;
+};
+
+static const uint32_t DELAY_LOG_VERSION = 1;
+
+/**
+ * Appends records to a delay log through a 1 MB stdio buffer. The buffer is
+ * a FILE buffer so WarmStartForker's fflush before fork () leaves nothing
+ * behind that a forked run could write twice.
+ */
+class DelayLogWriter
+{
+public:
+  DelayLogWriter ()
+    : m_file (0),
+      m_buffer (1 << 20)
+  {
+  }
+
+  ~DelayLogWriter ()
+  {
+    std::string error;
+    Close (error);
+  }
+
+  /// Closes the current log, if any. \return false with the reason in error if the file cannot be written
+  bool Open (std::string filename, std::string &error)
+  {
+    if (!Close (error))
+      {
+        return false;
+      }
+    m_file = fopen (filename.c_str (), "wb");
+    if (m_file == 0)
+      {
+        error = "cannot write " + filename;
+        return false;
+      }
+    m_filename = filename;
+    setvbuf (m_file, &m_buffer[0], _IOFBF, m_buffer.size ());
+    DelayLogHeader header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, "DLYLOG", 6);
+    header.version = DELAY_LOG_VERSION;
+    header.recordSize = sizeof (DelayLogRecord);
+    fwrite (&header, sizeof (header), 1, m_file);
+    return true;
+  }
+
+  void Add (DelayLogKind kind, int64_t timeNs, uint64_t uid, double delayMs)
+  {
+    DelayLogRecord record;
+    record.timeNs = timeNs;
+    record.uid = uid;
+    record.delayMs = delayMs;
+    record.kind = kind;
+    record.reserved = 0;
+    fwrite (&record, sizeof (record), 1, m_file);
+  }
+
+  bool Close (std::string &error)
+  {
+    if (m_file == 0)
+      {
+        return true;
+      }
+    bool ok = !ferror (m_file);
+    ok = fclose (m_file) == 0 && ok;
+    m_file = 0;
+    if (!ok)
+      {
+        error = "cannot write " + m_filename;
+      }
+    return ok;
+  }
+
+private:
+  FILE *m_file;
+  std::string m_filename;
+  std::vector<char> m_buffer;
+};
+
+/// Reads the records of a delay log block by block
+class DelayLogReader
+{
+public:
+  DelayLogReader ()
+    : m_file (0)
+  {
+  }
+
+  ~DelayLogReader ()
+  {
+    if (m_file != 0)
+      {
+        fclose (m_file);
+      }
+  }
+
+  /// \return false with the reason in error if the file is not a delay log
+  bool Open (std::string filename, std::string &error)
+  {
+    m_file = fopen (filename.c_str (), "rb");
+    if (m_file == 0)
+      {
+        error = "cannot read " + filename;
+        return false;
+      }
+    DelayLogHeader header;
+    if (fread (&header, sizeof (header), 1, m_file) != 1 || !IsDelayLog (header))
+      {
+        error = filename + " is not a delay log";
+        return false;
+      }
+    if (header.version != DELAY_LOG_VERSION || header.recordSize != sizeof (DelayLogRecord))
+      {
+        error = filename + " is a delay log of another version";
+        return false;
+      }
+    return true;
+  }
+
+  /// \return the number of records read into records, 0 at the end of the file
+  uint32_t Read (DelayLogRecord *records, uint32_t maxRecords)
+  {
+    return fread (records, sizeof (DelayLogRecord), maxRecords, m_file);
+  }
+
+  /// \return true if the first bytes of a file are those of a delay log
+  static bool IsDelayLog (const DelayLogHeader &header)
+  {
+    return memcmp (header.magic, "DLYLOG", 6) == 0;
+  }
+
+private:
+  FILE *m_file;
+};
+
+#endif // DELAY_LOG_FORMAT_H
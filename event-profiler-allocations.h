@@ -0,0 +1,63 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef EVENT_PROFILER_ALLOCATIONS_H
+#define EVENT_PROFILER_ALLOCATIONS_H
+
+#include <new>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "event-profiler.h"
+
+/*
+ * Replaces the global operator new of the program to count the allocations
+ * of every thread for the EventProfiler. As any replacement it must be
+ * defined once, so only the translation unit with main () of a script that
+ * profiles events may include this header; everything else the program
+ * allocates pays an increment for it.
+ */
+
+/// operator new calls made by the thread
+static __thread uint64_t g_eventProfilerAllocations = 0;
+
+uint64_t
+EventProfilerAllocations (void)
+{
+  return g_eventProfilerAllocations;
+}
+
+void *operator new (std::size_t size)
+#if __cplusplus < 201103L
+  throw (std::bad_alloc)
+#endif
+{
+  ++g_eventProfilerAllocations;
+  void *p;
+  while ((p = std::malloc (size > 0 ? size : 1)) == 0)
+    {
+      std::new_handler handler = std::set_new_handler (0);
+      std::set_new_handler (handler);
+      if (handler == 0)
+        {
+          throw std::bad_alloc ();
+        }
+      handler ();
+    }
+  return p;
+}
+
+#endif // EVENT_PROFILER_ALLOCATIONS_H
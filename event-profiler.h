@@ -0,0 +1,318 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef EVENT_PROFILER_H
+#define EVENT_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <typeinfo>
+#include <cstdlib>
+#include <stdint.h>
+#include <time.h>
+#include <cxxabi.h>
+
+#include "ns3/core-module.h"
+
+/**
+ * \return the operator new calls made by the calling thread so far; only
+ * defined in a program that includes event-profiler-allocations.h
+ */
+uint64_t EventProfilerAllocations (void) __attribute__ ((weak));
+
+namespace ns3 {
+
+/**
+ * Charges the wall-clock time, the invocations and the operator new calls
+ * of every event the simulator runs to the function it was scheduled for.
+ *
+ * The function is known from the type of the EventImpl: MakeEvent () makes
+ * one class per member or function pointer type, named after it, e.g.
+ * "void (ns3::LteEnbPhy::*)()" for the subframe events of the eNB PHY.
+ * Functions of the same class and signature are not told apart. Trace
+ * callbacks and everything else an event calls are charged to that event,
+ * so a FlowMonitor probe shows up in the event that sent or received the
+ * packet.
+ *
+ * InstrumentedSimulatorImpl::SetProfiler () feeds it. At the end of every
+ * Simulator::Run () it writes the totals so far:
+ *
+ *   <prefix>.txt      one line per event type, by time spent
+ *   <prefix>.folded   "Simulator::Run;<class>;<function> <microseconds>"
+ *                     lines for flamegraph.pl or speedscope
+ *
+ * and prints one machine-readable line:
+ *   EventProfile: events=<n> types=<n> runSeconds=<s> eventSeconds=<s> allocations=<n>
+ * The run time not spent in events is the scheduler's, shown as
+ * "Simulator::Run;[scheduler]" in the folded stacks.
+ *
+ * The cost per event is two clock_gettime () calls through the vDSO and a
+ * map lookup, usually skipped because consecutive events often have the
+ * same type. Allocations are only counted in a program that includes
+ * event-profiler-allocations.h, which replaces its operator new; elsewhere
+ * they are reported as -1.
+ */
+class EventProfiler
+{
+public:
+  EventProfiler (std::string prefix)
+    : m_prefix (prefix),
+      m_countAllocations (EventProfilerAllocations != 0),
+      m_last (0),
+      m_runNs (0),
+      m_runStart (0)
+  {
+  }
+
+  ~EventProfiler ()
+  {
+    for (std::map<const std::type_info *, EventType *>::iterator it = m_types.begin (); it != m_types.end (); ++it)
+      {
+        delete it->second;
+      }
+  }
+
+  /// Runs event and charges it to its type
+  void Invoke (EventImpl *event)
+  {
+    const std::type_info *type = &typeid (*event);
+    uint64_t allocations = m_countAllocations ? EventProfilerAllocations () : 0;
+    int64_t start = Now ();
+    event->Invoke ();
+    int64_t ns = Now () - start;
+    if (m_last == 0 || m_last->type != type)
+      {
+        m_last = Find (type);
+      }
+    ++m_last->count;
+    m_last->ns += ns;
+    if (m_countAllocations)
+      {
+        m_last->allocations += EventProfilerAllocations () - allocations;
+      }
+  }
+
+  /// Called by the simulator when Simulator::Run () starts
+  void RunStarted (void)
+  {
+    m_runStart = Now ();
+  }
+
+  /// Called by the simulator when Simulator::Run () returns; writes the files
+  void RunFinished (void)
+  {
+    m_runNs += Now () - m_runStart;
+    Write ();
+  }
+
+private:
+  struct EventType
+  {
+    const std::type_info *type;
+    uint64_t count;
+    int64_t ns;
+    uint64_t allocations;
+  };
+
+  /// Totals of the event types with the same name, the frames of their folded stack
+  struct Row
+  {
+    std::string frames;
+    uint64_t count;
+    int64_t ns;
+    uint64_t allocations;
+
+    Row ()
+      : count (0),
+        ns (0),
+        allocations (0)
+    {
+    }
+
+    bool operator< (const Row &other) const
+    {
+      return ns > other.ns;
+    }
+  };
+
+  EventType *Find (const std::type_info *type)
+  {
+    std::map<const std::type_info *, EventType *>::iterator it = m_types.find (type);
+    if (it != m_types.end ())
+      {
+        return it->second;
+      }
+    EventType *eventType = new EventType;
+    eventType->type = type;
+    eventType->count = 0;
+    eventType->ns = 0;
+    eventType->allocations = 0;
+    m_types[type] = eventType;
+    return eventType;
+  }
+
+  static int64_t Now (void)
+  {
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t> (now.tv_sec) * 1000000000 + now.tv_nsec;
+  }
+
+  /**
+   * \return "<class>;<function pointer type>" for an event made by
+   * MakeEvent (), "[function];<function pointer type>" for a function that
+   * is not a member, or the demangled type name
+   */
+  static std::string GetFrames (const std::type_info *type)
+  {
+    int status = 0;
+    char *demangled = abi::__cxa_demangle (type->name (), 0, 0, &status);
+    std::string name = status == 0 && demangled != 0 ? demangled : type->name ();
+    free (demangled);
+    std::string::size_type start = name.find ("MakeEvent");
+    if (start == std::string::npos)
+      {
+        return name;
+      }
+    // the first parameter of MakeEvent (), the type of the function, after the template arguments
+    start += 9;
+    std::string::size_type end = start < name.size () && name[start] == '<' ? Skip (name, start) : start;
+    if (end >= name.size () || name[end] != '(')
+      {
+        return name;
+      }
+    start = end + 1;
+    for (end = start; end < name.size () && name[end] != ',' && name[end] != ')'; )
+      {
+        end = Skip (name, end);
+      }
+    std::string function = name.substr (start, end - start);
+    std::string::size_type member = function.find ("::*)");
+    std::string::size_type open = function.find ('(');
+    if (member == std::string::npos || open == std::string::npos || open > member)
+      {
+        return "[function];" + function;
+      }
+    return function.substr (open + 1, member - open - 1) + ";" + function;
+  }
+
+  /// \return the position after the <...> or (...) group at start of name, or after the character at start
+  static std::string::size_type Skip (const std::string &name, std::string::size_type start)
+  {
+    if (start >= name.size () || (name[start] != '<' && name[start] != '('))
+      {
+        return start + 1;
+      }
+    int depth = 0;
+    for (std::string::size_type i = start; i < name.size (); ++i)
+      {
+        if (name[i] == '<' || name[i] == '(')
+          {
+            ++depth;
+          }
+        else if ((name[i] == '>' || name[i] == ')') && --depth == 0)
+          {
+            return i + 1;
+          }
+      }
+    return name.size ();
+  }
+
+  void Write (void)
+  {
+    // the same type may have a type_info in every shared library that made it
+    std::map<std::string, Row> rows;
+    uint64_t events = 0;
+    int64_t eventNs = 0;
+    uint64_t allocations = 0;
+    for (std::map<const std::type_info *, EventType *>::const_iterator it = m_types.begin (); it != m_types.end (); ++it)
+      {
+        std::string frames = GetFrames (it->first);
+        Row &row = rows[frames];
+        row.frames = frames;
+        row.count += it->second->count;
+        row.ns += it->second->ns;
+        row.allocations += it->second->allocations;
+        events += it->second->count;
+        eventNs += it->second->ns;
+        allocations += it->second->allocations;
+      }
+    std::vector<Row> sorted;
+    for (std::map<std::string, Row>::const_iterator it = rows.begin (); it != rows.end (); ++it)
+      {
+        sorted.push_back (it->second);
+      }
+    std::sort (sorted.begin (), sorted.end ());
+
+    std::string report = m_prefix + ".txt";
+    std::ofstream os (report.c_str ());
+    os << "% share\tms\tcount\tusPerEvent\tallocations\tallocationsPerEvent\tclass;function\n";
+    os.setf (std::ios::fixed);
+    os.precision (3);
+    for (uint32_t i = 0; i < sorted.size (); ++i)
+      {
+        const Row &row = sorted[i];
+        os << (m_runNs > 0 ? 100.0 * row.ns / m_runNs : 0) << "\t" << row.ns * 1e-6 << "\t" << row.count << "\t"
+           << (row.count > 0 ? row.ns * 1e-3 / row.count : 0) << "\t";
+        if (m_countAllocations)
+          {
+            os << row.allocations << "\t" << (row.count > 0 ? static_cast<double> (row.allocations) / row.count : 0);
+          }
+        else
+          {
+            os << "-\t-";
+          }
+        os << "\t" << row.frames << "\n";
+      }
+    os << (m_runNs > 0 ? 100.0 * (m_runNs - eventNs) / m_runNs : 0) << "\t" << (m_runNs - eventNs) * 1e-6
+       << "\t-\t-\t-\t-\t[scheduler]\n";
+    if (!os)
+      {
+        NS_FATAL_ERROR ("Cannot write " << report);
+      }
+
+    std::string folded = m_prefix + ".folded";
+    std::ofstream fs (folded.c_str ());
+    for (uint32_t i = 0; i < sorted.size (); ++i)
+      {
+        fs << "Simulator::Run;" << sorted[i].frames << " " << sorted[i].ns / 1000 << "\n";
+      }
+    fs << "Simulator::Run;[scheduler] " << (m_runNs - eventNs) / 1000 << "\n";
+    if (!fs)
+      {
+        NS_FATAL_ERROR ("Cannot write " << folded);
+      }
+
+    std::cout << "EventProfile: events=" << events << " types=" << sorted.size () << " runSeconds=" << m_runNs * 1e-9
+              << " eventSeconds=" << eventNs * 1e-9 << " allocations="
+              << (m_countAllocations ? static_cast<int64_t> (allocations) : -1) << std::endl;
+  }
+
+  std::string m_prefix;
+  bool m_countAllocations;      ///< true if event-profiler-allocations.h counts them
+  std::map<const std::type_info *, EventType *> m_types;
+  EventType *m_last;            ///< type of the previous event
+  int64_t m_runNs;              ///< wall-clock time in Simulator::Run (), over all runs
+  int64_t m_runStart;
+};
+
+} // namespace ns3
+
+#endif // EVENT_PROFILER_H
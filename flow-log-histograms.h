@@ -0,0 +1,257 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_LOG_HISTOGRAMS_H
+#define FLOW_LOG_HISTOGRAMS_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+
+#include "hdr-histogram.h"
+#include "flow-stats-format.h"
+#include "flow-loss-tracker.h"
+
+namespace ns3 {
+
+/**
+ * Per-flow delay and jitter histograms with log-linear bins, as an
+ * alternative to the fixed DelayBinWidth/JitterBinWidth bins of FlowMonitor.
+ *
+ * A fixed width is either too coarse for small delays (everything lands in
+ * bin 0) or too fine for the tail. The bins of hdr-histogram.h keep the same
+ * relative precision from one microsecond up, and a histogram only grows to
+ * its largest value, so memory per flow stays bounded by the precision and
+ * the delay range rather than by the bin width.
+ *
+ * The histograms are fed from the delivered packets of a FlowLossTracker;
+ * flows are the tracker's five-tuples, numbered from 1 in order of
+ * appearance. Jitter is the difference between consecutive delays of a
+ * flow, as FlowMonitor computes it. Packet sizes go into a histogram with
+ * one-byte units.
+ *
+ * When the tracker samples, the histograms hold the followed packets only:
+ * their quantiles estimate those of all packets, the bin counts are sample
+ * counts. Jitter is taken only between packets that were sent one after the
+ * other, which the tracker samples in pairs. Packet counts are the tracker's
+ * exact ones, and the delay and jitter sums are the sample means times them.
+ * Both exports keep only non-empty bins:
+ * SerializeToXmlFile () writes FlowMonitor-style XML that flowmon-analyzer
+ * and flowmon-aggregate read, WriteFlowStats () the binary format of
+ * flow-stats-format.h.
+ */
+class FlowLogHistograms
+{
+public:
+  /// \param relativePrecision widest bin relative to the values in it, e.g. 0.01
+  FlowLogHistograms (double relativePrecision)
+    : m_tracker (0),
+      m_bits (LogLinearHistogram::BitsForPrecision (relativePrecision))
+  {
+  }
+
+  /// Receives the delivered packets of tracker, which has to outlive this
+  void Install (FlowLossTracker &tracker)
+  {
+    m_tracker = &tracker;
+    tracker.SetDeliveryCallback (MakeCallback (&FlowLogHistograms::Delivered, this));
+  }
+
+  void SerializeToXmlFile (std::string filename)
+  {
+    Complete ();
+    std::ofstream os (filename.c_str ());
+    if (!os)
+      {
+        NS_FATAL_ERROR ("Cannot write the flow histograms to " << filename);
+      }
+    os << "<?xml version=\"1.0\" ?>\n<FlowMonitor>\n  <FlowStats>\n";
+    for (uint32_t i = 0; i < m_flows.size (); ++i)
+      {
+        const Flow &flow = m_flows[i];
+        uint64_t rx = m_tracker->GetRxPackets (i);
+        os << "    <Flow flowId=\"" << i + 1 << "\" timeFirstRxPacket=\"+" << flow.firstRxNs
+           << ".0ns\" timeLastRxPacket=\"+" << flow.lastRxNs << ".0ns\" delaySum=\"+"
+           << Scale (flow.delaySumNs, flow.delay.GetCount (), rx) << ".0ns\" jitterSum=\"+"
+           << Scale (flow.jitterSumNs, flow.jitter.GetCount (), rx > 0 ? rx - 1 : 0) << ".0ns\" lastDelay=\"+"
+           << flow.lastDelayNs << ".0ns\" txBytes=\"" << m_tracker->GetTxBytes (i) << "\" rxBytes=\""
+           << m_tracker->GetRxBytes (i) << "\" txPackets=\"" << m_tracker->GetTxPackets (i) << "\" rxPackets=\"" << rx
+           << "\" lostPackets=\"" << m_tracker->GetLostPackets (i) << "\">\n";
+        flow.delay.SerializeToXmlStream (os, 6, "delayHistogram");
+        flow.jitter.SerializeToXmlStream (os, 6, "jitterHistogram");
+        flow.size.SerializeToXmlStream (os, 6, "packetSizeHistogram");
+        os << "    </Flow>\n";
+      }
+    os << "  </FlowStats>\n  <Ipv4FlowClassifier>\n";
+    for (uint32_t i = 0; i < m_flows.size (); ++i)
+      {
+        const FlowLossTracker::FiveTuple &t = m_tracker->GetFiveTuple (i);
+        os << "    <Flow flowId=\"" << i + 1 << "\" sourceAddress=\"" << Ipv4Address (t.source)
+           << "\" destinationAddress=\"" << Ipv4Address (t.destination) << "\" protocol=\"" << (uint32_t) t.protocol
+           << "\" sourcePort=\"" << t.sourcePort << "\" destinationPort=\"" << t.destinationPort << "\" />\n";
+      }
+    os << "  </Ipv4FlowClassifier>\n</FlowMonitor>\n";
+  }
+
+  void WriteFlowStats (std::string filename)
+  {
+    Complete ();
+    FlowStatsFileWriter writer;
+    writer.SetSimulationTime (Simulator::Now ().GetNanoSeconds ());
+    writer.SetBinWidth (FLOW_STATS_DELAY_HISTOGRAM, Unit ());
+    writer.SetSubBucketBits (FLOW_STATS_DELAY_HISTOGRAM, m_bits);
+    writer.SetBinWidth (FLOW_STATS_JITTER_HISTOGRAM, Unit ());
+    writer.SetSubBucketBits (FLOW_STATS_JITTER_HISTOGRAM, m_bits);
+    writer.SetBinWidth (FLOW_STATS_PACKET_SIZE_HISTOGRAM, 1);
+    writer.SetSubBucketBits (FLOW_STATS_PACKET_SIZE_HISTOGRAM, m_bits);
+    for (uint32_t i = 0; i < m_flows.size (); ++i)
+      {
+        const Flow &flow = m_flows[i];
+        const FlowLossTracker::FiveTuple &t = m_tracker->GetFiveTuple (i);
+        FlowStatsRecord record;
+        memset (&record, 0, sizeof (record));
+        record.flowId = i + 1;
+        record.timeFirstRxNs = flow.firstRxNs;
+        record.timeLastRxNs = flow.lastRxNs;
+        record.rxPackets = m_tracker->GetRxPackets (i);
+        record.delaySumNs = Scale (flow.delaySumNs, flow.delay.GetCount (), record.rxPackets);
+        record.jitterSumNs = Scale (flow.jitterSumNs, flow.jitter.GetCount (),
+                                    record.rxPackets > 0 ? record.rxPackets - 1 : 0);
+        record.lastDelayNs = flow.lastDelayNs;
+        record.txBytes = m_tracker->GetTxBytes (i);
+        record.rxBytes = m_tracker->GetRxBytes (i);
+        record.txPackets = m_tracker->GetTxPackets (i);
+        record.lostPackets = m_tracker->GetLostPackets (i);
+        record.sourceAddress = t.source;
+        record.destinationAddress = t.destination;
+        record.sourcePort = t.sourcePort;
+        record.destinationPort = t.destinationPort;
+        record.protocol = t.protocol;
+        writer.AddFlow (record);
+        for (uint32_t bin = 0; bin < flow.delay.GetNBins (); ++bin)
+          {
+            writer.AddBin (FLOW_STATS_DELAY_HISTOGRAM, bin, flow.delay.GetBinCount (bin));
+          }
+        for (uint32_t bin = 0; bin < flow.jitter.GetNBins (); ++bin)
+          {
+            writer.AddBin (FLOW_STATS_JITTER_HISTOGRAM, bin, flow.jitter.GetBinCount (bin));
+          }
+        for (uint32_t bin = 0; bin < flow.size.GetNBins (); ++bin)
+          {
+            writer.AddBin (FLOW_STATS_PACKET_SIZE_HISTOGRAM, bin, flow.size.GetBinCount (bin));
+          }
+      }
+    std::string error;
+    if (!writer.Write (filename, error))
+      {
+        NS_FATAL_ERROR ("Cannot write flow stats: " << error);
+      }
+  }
+
+private:
+  /// \return the narrowest bin, in seconds
+  static double Unit (void)
+  {
+    return 1e-6;
+  }
+
+  struct Flow
+  {
+    Flow (uint32_t bits)
+      : delay (Unit (), bits),
+        jitter (Unit (), bits),
+        size (1, bits),
+        samples (0),
+        lastSequence (0),
+        firstRxNs (0),
+        lastRxNs (0),
+        delaySumNs (0),
+        jitterSumNs (0),
+        lastDelayNs (0)
+    {
+    }
+    LogLinearHistogram delay;
+    LogLinearHistogram jitter;
+    LogLinearHistogram size;
+    uint64_t samples;
+    uint64_t lastSequence;
+    int64_t firstRxNs;
+    int64_t lastRxNs;
+    int64_t delaySumNs;
+    int64_t jitterSumNs;
+    int64_t lastDelayNs;
+  };
+
+  /// \return sum over count samples scaled to total packets
+  static int64_t Scale (int64_t sum, uint64_t count, uint64_t total)
+  {
+    if (count == 0 || count == total)
+      {
+        return sum;
+      }
+    return static_cast<int64_t> (static_cast<double> (sum) / count * total);
+  }
+
+  /// Counts the latest losses and adds the flows that never delivered a packet
+  void Complete (void)
+  {
+    m_tracker->Update ();
+    while (m_flows.size () < m_tracker->GetFlowCount ())
+      {
+        m_flows.push_back (Flow (m_bits));
+      }
+  }
+
+  void Delivered (uint32_t flowIndex, uint64_t sequence, Time delay, uint32_t size)
+  {
+    while (flowIndex >= m_flows.size ())
+      {
+        m_flows.push_back (Flow (m_bits));
+      }
+    Flow &flow = m_flows[flowIndex];
+    int64_t now = Simulator::Now ().GetNanoSeconds ();
+    int64_t delayNs = delay.GetNanoSeconds ();
+    if (flow.samples == 0)
+      {
+        flow.firstRxNs = now;
+      }
+    else if (m_tracker->GetSampling () == 1 || sequence == flow.lastSequence + 1)
+      {
+        int64_t jitterNs = delayNs > flow.lastDelayNs ? delayNs - flow.lastDelayNs : flow.lastDelayNs - delayNs;
+        flow.jitter.AddValue (jitterNs * 1e-9);
+        flow.jitterSumNs += jitterNs;
+      }
+    flow.delay.AddValue (delayNs * 1e-9);
+    flow.size.AddValue (size);
+    flow.delaySumNs += delayNs;
+    flow.lastDelayNs = delayNs;
+    flow.lastSequence = sequence;
+    flow.lastRxNs = now;
+    ++flow.samples;
+  }
+
+  FlowLossTracker *m_tracker;
+  uint32_t m_bits;
+  std::vector<Flow> m_flows;
+};
+
+} // namespace ns3
+
+#endif // FLOW_LOG_HISTOGRAMS_H
@@ -0,0 +1,785 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_LOSS_TRACKER_H
+#define FLOW_LOSS_TRACKER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+namespace ns3 {
+
+/**
+ * Detects lost packets incrementally, as an alternative to calling
+ * FlowMonitor::CheckForLostPackets () during the run.
+ *
+ * CheckForLostPackets () scans every packet in flight each time it is
+ * called. This tracker follows the same packets through the Ipv4L3Protocol
+ * traces of the nodes it is installed on (sent, forwarded, delivered,
+ * dropped) and keeps them in an expiry queue: every packet waits for
+ * maxPerHopDelay after it was last seen, the same rule FlowMonitor applies.
+ * Since all packets wait equally long, the expiry timer wheel degenerates
+ * into a FIFO in the order packets were seen; a packet seen again on a later
+ * hop is queued again and its older entry is skipped when it expires.
+ * Packets in flight are looked up by uid in an open addressing table, and
+ * flows by five-tuple in another one, so each packet costs amortized O(1)
+ * and expiry runs as a side effect of the traces, without events of its own.
+ *
+ * Losses are counted per flow (five-tuple, numbered in order of appearance)
+ * and per binWidth of simulated time at which the packet was last seen; a
+ * packet an Ipv4L3Protocol drops counts as lost at once. Delivered packets
+ * are handed to the delivery callback with their flow and delay.
+ *
+ * SetSampling (n) follows only one packet in n through the network. Whether
+ * a packet is followed is a hash of its five-tuple and its sequence number
+ * in the flow, so it is the same decision on every node and independent of
+ * the delay the packet will see. Packets are sampled in consecutive pairs so
+ * jitter stays measurable. Sent and received packets and bytes are still
+ * counted exactly per flow; losses are the loss ratio of the sampled
+ * packets applied to all sent packets.
+ *
+ * InstallCheckpoint () adds the eNBs and the SGW/PGW of an EPC as
+ * intermediate points: a packet is stamped with the time it first reaches
+ * each of them, which also counts as being seen for expiry. The EPC carries
+ * a user packet through the radio stack and the GTP-U tunnel as the same
+ * ns3::Packet, so its uid identifies it on every hop even though the eNB's
+ * IP stack only sees the tunnelled copy. A delivered packet that passed
+ * both checkpoints splits its delay into the radio (UE-eNB), S1-U
+ * (eNB-PGW) and SGi (PGW-remote host) segments, in whichever direction it
+ * travelled; UE-to-UE packets pass the eNBs twice and are not split.
+ */
+class FlowLossTracker
+{
+public:
+  FlowLossTracker (Time maxPerHopDelay, Time binWidth)
+    : m_maxPerHopDelay (maxPerHopDelay),
+      m_binWidth (binWidth),
+      m_slots (1024),
+      m_used (0),
+      m_flowSlots (64, 0),
+      m_txPackets (0),
+      m_sampling (1),
+      m_sampledPackets (0),
+      m_lostPackets (0)
+  {
+  }
+
+  /// The flow of a packet
+  struct FiveTuple
+  {
+    uint32_t source;
+    uint32_t destination;
+    uint16_t sourcePort;
+    uint16_t destinationPort;
+    uint8_t protocol;
+
+    bool operator== (const FiveTuple &other) const
+    {
+      return source == other.source && destination == other.destination && protocol == other.protocol
+             && sourcePort == other.sourcePort && destinationPort == other.destinationPort;
+    }
+
+    bool operator< (const FiveTuple &other) const
+    {
+      if (source != other.source)
+        {
+          return source < other.source;
+        }
+      if (destination != other.destination)
+        {
+          return destination < other.destination;
+        }
+      if (protocol != other.protocol)
+        {
+          return protocol < other.protocol;
+        }
+      if (sourcePort != other.sourcePort)
+        {
+          return sourcePort < other.sourcePort;
+        }
+      return destinationPort < other.destinationPort;
+    }
+  };
+
+  /// Intermediate nodes of the EPC path that stamp the packets passing them
+  enum Checkpoint
+  {
+    ENB_CHECKPOINT = 0,
+    PGW_CHECKPOINT = 1,
+    CHECKPOINTS = 2
+  };
+
+  /// Segments of the EPC path between the checkpoints and the end points
+  enum Segment
+  {
+    RADIO_SEGMENT = 0,          ///< UE to eNB
+    S1U_SEGMENT = 1,            ///< eNB to SGW/PGW
+    SGI_SEGMENT = 2,            ///< SGW/PGW to remote host
+    SEGMENTS = 3
+  };
+
+  /// Follows one packet in n; 1, the default, follows every packet
+  void SetSampling (uint32_t n)
+  {
+    m_sampling = n > 0 ? n : 1;
+  }
+
+  uint32_t GetSampling (void) const
+  {
+    return m_sampling;
+  }
+
+  /**
+   * Called with the flow index, sequence number in the flow, end-to-end
+   * delay and IP size of every delivered packet that was followed
+   */
+  void SetDeliveryCallback (Callback<void, uint32_t, uint64_t, Time, uint32_t> callback)
+  {
+    m_delivered = callback;
+  }
+
+  /// Connects to the Ipv4L3Protocol of every node, like FlowMonitorHelper::Install ()
+  void Install (NodeContainer nodes)
+  {
+    for (NodeContainer::Iterator it = nodes.Begin (); it != nodes.End (); ++it)
+      {
+        Ptr<Ipv4L3Protocol> ipv4 = (*it)->GetObject<Ipv4L3Protocol> ();
+        if (ipv4 == 0)
+          {
+            continue;
+          }
+        ipv4->TraceConnectWithoutContext ("SendOutgoing", MakeCallback (&FlowLossTracker::SendOutgoing, this));
+        ipv4->TraceConnectWithoutContext ("UnicastForward", MakeCallback (&FlowLossTracker::Forward, this));
+        ipv4->TraceConnectWithoutContext ("LocalDeliver", MakeCallback (&FlowLossTracker::LocalDeliver, this));
+        ipv4->TraceConnectWithoutContext ("Drop", MakeCallback (&FlowLossTracker::Drop, this));
+      }
+  }
+
+  /// Stamps the packets sent, forwarded, delivered or dropped by nodes as passing checkpoint
+  void InstallCheckpoint (NodeContainer nodes, Checkpoint checkpoint)
+  {
+    for (NodeContainer::Iterator it = nodes.Begin (); it != nodes.End (); ++it)
+      {
+        Ptr<Ipv4L3Protocol> ipv4 = (*it)->GetObject<Ipv4L3Protocol> ();
+        if (ipv4 == 0)
+          {
+            continue;
+          }
+        Callback<void, const Ipv4Header &, Ptr<const Packet>, uint32_t> reached =
+          checkpoint == ENB_CHECKPOINT ? MakeCallback (&FlowLossTracker::ReachedEnb, this)
+                                       : MakeCallback (&FlowLossTracker::ReachedPgw, this);
+        ipv4->TraceConnectWithoutContext ("SendOutgoing", reached);
+        ipv4->TraceConnectWithoutContext ("UnicastForward", reached);
+        ipv4->TraceConnectWithoutContext ("LocalDeliver", reached);
+        ipv4->TraceConnectWithoutContext ("Drop", MakeCallback (&FlowLossTracker::Drop, this));
+      }
+  }
+
+  /// Counts the packets that expired by now; the traces do this as they fire
+  void Update (void)
+  {
+    Expire (Simulator::Now ());
+  }
+
+  /// \return packets lost so far, over all flows, estimated when sampling
+  uint64_t GetLostPackets (void) const
+  {
+    return Estimate (m_lostPackets, m_sampledPackets, m_txPackets);
+  }
+
+  /// \return packets sent so far, over all flows
+  uint64_t GetTxPackets (void) const
+  {
+    return m_txPackets;
+  }
+
+  /// \return flows seen so far; flow indexes run from 0 to this
+  uint32_t GetFlowCount (void) const
+  {
+    return m_flows.size ();
+  }
+
+  const FiveTuple &GetFiveTuple (uint32_t flow) const
+  {
+    return m_tuples[flow];
+  }
+
+  uint64_t GetTxPackets (uint32_t flow) const
+  {
+    return m_flows[flow].txPackets;
+  }
+
+  uint64_t GetRxPackets (uint32_t flow) const
+  {
+    return m_flows[flow].rxPackets;
+  }
+
+  uint64_t GetTxBytes (uint32_t flow) const
+  {
+    return m_flows[flow].txBytes;
+  }
+
+  uint64_t GetRxBytes (uint32_t flow) const
+  {
+    return m_flows[flow].rxBytes;
+  }
+
+  /// \return packets of flow lost so far, estimated when sampling
+  uint64_t GetLostPackets (uint32_t flow) const
+  {
+    const Counters &c = m_flows[flow];
+    return Estimate (c.lostPackets, c.sampledPackets, c.txPackets);
+  }
+
+  /// \return delivered packets of flow whose delay was split into segments
+  uint64_t GetSplitPackets (uint32_t flow) const
+  {
+    return flow < m_segments.size () ? m_segments[flow].packets : 0;
+  }
+
+  /// \return mean delay of the split packets of flow on segment
+  Time GetSegmentMeanDelay (uint32_t flow, Segment segment) const
+  {
+    uint64_t packets = GetSplitPackets (flow);
+    return packets > 0 ? TimeStep (m_segments[flow].sum[segment] / static_cast<int64_t> (packets)) : Time (0);
+  }
+
+  Time GetSegmentMaxDelay (uint32_t flow, Segment segment) const
+  {
+    return GetSplitPackets (flow) > 0 ? TimeStep (m_segments[flow].max[segment]) : Time (0);
+  }
+
+  /// \return packets in flight, not yet delivered, dropped or expired
+  uint64_t GetInFlight (void) const
+  {
+    return m_used;
+  }
+
+  /**
+   * Prints "Loss: flow=<src>:<port>-><dst>:<port> protocol= txPackets= rxPackets= lostPackets="
+   * per flow, in five-tuple order
+   */
+  void Report (std::ostream &os)
+  {
+    Update ();
+    std::vector<std::pair<FiveTuple, uint32_t> > flows;
+    for (uint32_t flow = 0; flow < m_tuples.size (); ++flow)
+      {
+        flows.push_back (std::make_pair (m_tuples[flow], flow));
+      }
+    std::sort (flows.begin (), flows.end (), CompareTuples);
+    for (uint32_t i = 0; i < flows.size (); ++i)
+      {
+        const FiveTuple &key = flows[i].first;
+        os << "Loss: flow=" << Ipv4Address (key.source) << ":" << key.sourcePort << "->"
+           << Ipv4Address (key.destination) << ":" << key.destinationPort
+           << " protocol=" << (uint32_t) key.protocol
+           << " txPackets=" << GetTxPackets (flows[i].second)
+           << " rxPackets=" << GetRxPackets (flows[i].second)
+           << " lostPackets=" << GetLostPackets (flows[i].second) << "\n";
+      }
+  }
+
+  /// Writes timeS,txPackets,lostPackets per bin of the time packets were sent or last seen
+  void WriteTimeSeries (std::string filename)
+  {
+    Update ();
+    FILE *file = fopen (filename.c_str (), "w");
+    if (file == 0)
+      {
+        NS_FATAL_ERROR ("Cannot write the loss time series to " << filename);
+      }
+    fprintf (file, "timeS,txPackets,lostPackets\n");
+    for (uint32_t bin = 0; bin < m_bins.size (); ++bin)
+      {
+        const Counters &c = m_bins[bin];
+        fprintf (file, "%.9g,%llu,%llu\n", (m_binWidth * bin).GetSeconds (), (unsigned long long) c.txPackets,
+                 (unsigned long long) Estimate (c.lostPackets, c.sampledPackets, c.txPackets));
+      }
+    fclose (file);
+  }
+
+  /**
+   * Writes flow,source,destination,packets and the mean and maximum delay in
+   * ms of the radio, S1-U and SGi segments, for the flows with split packets
+   */
+  void WriteSegmentDelays (std::string filename) const
+  {
+    FILE *file = fopen (filename.c_str (), "w");
+    if (file == 0)
+      {
+        NS_FATAL_ERROR ("Cannot write the segment delays to " << filename);
+      }
+    fprintf (file, "flow,source,destination,packets,radioMeanMs,s1uMeanMs,sgiMeanMs,radioMaxMs,s1uMaxMs,sgiMaxMs\n");
+    for (uint32_t flow = 0; flow < m_segments.size (); ++flow)
+      {
+        if (m_segments[flow].packets == 0)
+          {
+            continue;
+          }
+        std::ostringstream source, destination;
+        source << Ipv4Address (m_tuples[flow].source) << ":" << m_tuples[flow].sourcePort;
+        destination << Ipv4Address (m_tuples[flow].destination) << ":" << m_tuples[flow].destinationPort;
+        fprintf (file, "%u,%s,%s,%llu", flow + 1, source.str ().c_str (), destination.str ().c_str (),
+                 (unsigned long long) m_segments[flow].packets);
+        for (int segment = 0; segment < SEGMENTS; ++segment)
+          {
+            fprintf (file, ",%.6f", GetSegmentMeanDelay (flow, Segment (segment)).GetSeconds () * 1000);
+          }
+        for (int segment = 0; segment < SEGMENTS; ++segment)
+          {
+            fprintf (file, ",%.6f", GetSegmentMaxDelay (flow, Segment (segment)).GetSeconds () * 1000);
+          }
+        fprintf (file, "\n");
+      }
+    fclose (file);
+  }
+
+private:
+  /// Delay of the split packets of a flow, per segment, in time steps
+  struct SegmentDelays
+  {
+    SegmentDelays ()
+      : packets (0)
+    {
+      for (int i = 0; i < SEGMENTS; ++i)
+        {
+          sum[i] = 0;
+          max[i] = 0;
+        }
+    }
+    uint64_t packets;
+    int64_t sum[SEGMENTS];
+    int64_t max[SEGMENTS];
+  };
+
+  struct Counters
+  {
+    Counters ()
+      : txPackets (0),
+        rxPackets (0),
+        txBytes (0),
+        rxBytes (0),
+        sampledPackets (0),
+        lostPackets (0)
+    {
+    }
+    uint64_t txPackets;
+    uint64_t rxPackets;
+    uint64_t txBytes;
+    uint64_t rxBytes;
+    uint64_t sampledPackets;    ///< sent packets that are followed
+    uint64_t lostPackets;       ///< followed packets that were lost
+  };
+
+  /// A packet in flight; uid 0 marks a free slot, so uids are stored plus one
+  struct Slot
+  {
+    Slot ()
+      : key (0),
+        flow (0),
+        sequence (0),
+        sent (0),
+        lastSeen (0)
+    {
+      reached[ENB_CHECKPOINT] = -1;
+      reached[PGW_CHECKPOINT] = -1;
+    }
+    uint64_t key;
+    uint32_t flow;
+    uint64_t sequence;          ///< sent packets of the flow before this one
+    int64_t sent;               ///< time step the packet was sent at
+    int64_t lastSeen;           ///< time step of the last trace that saw the packet
+    int64_t reached[CHECKPOINTS]; ///< time step it first passed each checkpoint, -1 if not yet
+  };
+
+  /// Queue entry: the packet expires at lastSeen + maxPerHopDelay unless it was seen since
+  struct Expiry
+  {
+    int64_t lastSeen;
+    uint64_t uid;
+  };
+
+  void SendOutgoing (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    Time now = Simulator::Now ();
+    Expire (now);
+    uint8_t protocol = header.GetProtocol ();
+    if (protocol != UdpL4Protocol::PROT_NUMBER && protocol != TcpL4Protocol::PROT_NUMBER)
+      {
+        return;
+      }
+    uint32_t flow = GetFlow (header, packet);
+    Counters &counters = m_flows[flow];
+    uint64_t sequence = counters.txPackets++;
+    counters.txBytes += packet->GetSize () + header.GetSerializedSize ();
+    Counters &bin = GetBin (now);
+    ++bin.txPackets;
+    ++m_txPackets;
+    if (m_sampling > 1 && Mix (m_tupleHashes[flow] + (sequence >> 1)) % m_sampling != 0)
+      {
+        return;
+      }
+    ++counters.sampledPackets;
+    ++bin.sampledPackets;
+    ++m_sampledPackets;
+    Slot &slot = Find (packet->GetUid ());
+    if (slot.key == 0)
+      {
+        slot.key = packet->GetUid () + 1;
+        slot.sequence = sequence;
+        slot.sent = now.GetTimeStep ();
+        ++m_used;
+        Grow ();
+      }
+    Seen (Find (packet->GetUid ()), flow, now, packet->GetUid ());
+  }
+
+  void Forward (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    Time now = Simulator::Now ();
+    Expire (now);
+    Slot &slot = Find (packet->GetUid ());
+    if (slot.key != 0)
+      {
+        Seen (slot, slot.flow, now, packet->GetUid ());
+      }
+  }
+
+  void LocalDeliver (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    Time now = Simulator::Now ();
+    Expire (now);
+    uint8_t protocol = header.GetProtocol ();
+    if (protocol != UdpL4Protocol::PROT_NUMBER && protocol != TcpL4Protocol::PROT_NUMBER)
+      {
+        return;
+      }
+    Slot &slot = Find (packet->GetUid ());
+    // a followed packet knows its flow, any other one is classified for the exact counters
+    uint32_t flow = slot.key != 0 ? slot.flow : GetFlow (header, packet);
+    uint32_t size = packet->GetSize () + header.GetSerializedSize ();
+    ++m_flows[flow].rxPackets;
+    m_flows[flow].rxBytes += size;
+    if (slot.key != 0)
+      {
+        uint64_t sequence = slot.sequence;
+        Time delay = now - TimeStep (slot.sent);
+        Split (slot, flow, now);
+        Erase (slot);
+        if (!m_delivered.IsNull ())
+          {
+            m_delivered (flow, sequence, delay, size);
+          }
+      }
+  }
+
+  void ReachedEnb (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    Reached (packet->GetUid (), ENB_CHECKPOINT);
+  }
+
+  void ReachedPgw (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    Reached (packet->GetUid (), PGW_CHECKPOINT);
+  }
+
+  void Reached (uint64_t uid, Checkpoint checkpoint)
+  {
+    Time now = Simulator::Now ();
+    Expire (now);
+    Slot &slot = Find (uid);
+    if (slot.key != 0)
+      {
+        int64_t &enb = slot.reached[ENB_CHECKPOINT];
+        int64_t &pgw = slot.reached[PGW_CHECKPOINT];
+        if (checkpoint == ENB_CHECKPOINT && enb >= 0 && pgw > enb)
+          {
+            // back at an eNB after the PGW, UE-to-UE: not split
+            pgw = -2;
+          }
+        else if (slot.reached[checkpoint] == -1)
+          {
+            slot.reached[checkpoint] = now.GetTimeStep ();
+          }
+        Seen (slot, slot.flow, now, uid);
+      }
+  }
+
+  /// Adds the segment delays of a delivered packet that passed both checkpoints
+  void Split (const Slot &slot, uint32_t flow, Time now)
+  {
+    int64_t enb = slot.reached[ENB_CHECKPOINT];
+    int64_t pgw = slot.reached[PGW_CHECKPOINT];
+    if (enb < 0 || pgw < 0)
+      {
+        return;
+      }
+    int64_t delay[SEGMENTS];
+    if (enb <= pgw)
+      {
+        // uplink
+        delay[RADIO_SEGMENT] = enb - slot.sent;
+        delay[S1U_SEGMENT] = pgw - enb;
+        delay[SGI_SEGMENT] = now.GetTimeStep () - pgw;
+      }
+    else
+      {
+        delay[SGI_SEGMENT] = pgw - slot.sent;
+        delay[S1U_SEGMENT] = enb - pgw;
+        delay[RADIO_SEGMENT] = now.GetTimeStep () - enb;
+      }
+    if (flow >= m_segments.size ())
+      {
+        m_segments.resize (flow + 1);
+      }
+    SegmentDelays &segments = m_segments[flow];
+    ++segments.packets;
+    for (int i = 0; i < SEGMENTS; ++i)
+      {
+        segments.sum[i] += delay[i];
+        segments.max[i] = std::max (segments.max[i], delay[i]);
+      }
+  }
+
+  void Drop (const Ipv4Header &header, Ptr<const Packet> packet, Ipv4L3Protocol::DropReason reason,
+             Ptr<Ipv4> ipv4, uint32_t interface)
+  {
+    Time now = Simulator::Now ();
+    Expire (now);
+    Slot &slot = Find (packet->GetUid ());
+    if (slot.key != 0)
+      {
+        Lost (slot.flow, now);
+        Erase (slot);
+      }
+  }
+
+  void Seen (Slot &slot, uint32_t flow, Time now, uint64_t uid)
+  {
+    slot.flow = flow;
+    slot.lastSeen = now.GetTimeStep ();
+    Expiry entry;
+    entry.lastSeen = slot.lastSeen;
+    entry.uid = uid;
+    m_queue.push_back (entry);
+  }
+
+  /// Pops every queue entry that is due; those still current are lost
+  void Expire (Time now)
+  {
+    int64_t due = (now - m_maxPerHopDelay).GetTimeStep ();
+    while (!m_queue.empty () && m_queue.front ().lastSeen < due)
+      {
+        Expiry entry = m_queue.front ();
+        m_queue.pop_front ();
+        Slot &slot = Find (entry.uid);
+        if (slot.key != 0 && slot.lastSeen == entry.lastSeen)
+          {
+            Lost (slot.flow, TimeStep (entry.lastSeen));
+            Erase (slot);
+          }
+      }
+  }
+
+  void Lost (uint32_t flow, Time lastSeen)
+  {
+    ++m_flows[flow].lostPackets;
+    ++GetBin (lastSeen).lostPackets;
+    ++m_lostPackets;
+  }
+
+  uint32_t GetFlow (const Ipv4Header &header, Ptr<const Packet> packet)
+  {
+    FiveTuple key;
+    key.source = header.GetSource ().Get ();
+    key.destination = header.GetDestination ().Get ();
+    key.protocol = header.GetProtocol ();
+    key.sourcePort = 0;
+    key.destinationPort = 0;
+    // the transport header is at the front of an outgoing packet, both start with the ports
+    uint8_t ports[4];
+    if (packet->CopyData (ports, 4) == 4)
+      {
+        key.sourcePort = (ports[0] << 8) | ports[1];
+        key.destinationPort = (ports[2] << 8) | ports[3];
+      }
+    uint64_t addresses = static_cast<uint64_t> (key.source) << 32 | key.destination;
+    uint64_t rest = static_cast<uint64_t> (key.sourcePort) << 24 | key.destinationPort << 8 | key.protocol;
+    uint64_t hash = Mix (addresses ^ Mix (rest));
+    uint32_t &slot = FindFlow (key, hash);
+    if (slot != 0)
+      {
+        return slot - 1;
+      }
+    uint32_t flow = m_flows.size ();
+    slot = flow + 1;
+    m_flows.push_back (Counters ());
+    m_tuples.push_back (key);
+    m_tupleHashes.push_back (hash);
+    GrowFlows ();
+    return flow;
+  }
+
+  /// \return the flow slot of key, flow index plus one, or the free slot it would go to
+  uint32_t &FindFlow (const FiveTuple &key, uint64_t hash)
+  {
+    uint64_t mask = m_flowSlots.size () - 1;
+    uint64_t i = hash & mask;
+    while (m_flowSlots[i] != 0
+           && (m_tupleHashes[m_flowSlots[i] - 1] != hash || !(m_tuples[m_flowSlots[i] - 1] == key)))
+      {
+        i = (i + 1) & mask;
+      }
+    return m_flowSlots[i];
+  }
+
+  /// Doubles the flow table once it is half full
+  void GrowFlows (void)
+  {
+    if (2 * m_flows.size () <= m_flowSlots.size ())
+      {
+        return;
+      }
+    m_flowSlots.assign (2 * m_flowSlots.size (), 0);
+    for (uint32_t flow = 0; flow < m_flows.size (); ++flow)
+      {
+        FindFlow (m_tuples[flow], m_tupleHashes[flow]) = flow + 1;
+      }
+  }
+
+  static bool CompareTuples (const std::pair<FiveTuple, uint32_t> &a, const std::pair<FiveTuple, uint32_t> &b)
+  {
+    return a.first < b.first;
+  }
+
+  Counters &GetBin (Time time)
+  {
+    uint64_t bin = time.GetTimeStep () / m_binWidth.GetTimeStep ();
+    if (bin >= m_bins.size ())
+      {
+        m_bins.resize (bin + 1);
+      }
+    return m_bins[bin];
+  }
+
+  /// \return the slot of uid, or the free slot it would go to
+  Slot &Find (uint64_t uid)
+  {
+    uint64_t mask = m_slots.size () - 1;
+    uint64_t i = Hash (uid) & mask;
+    while (m_slots[i].key != 0 && m_slots[i].key != uid + 1)
+      {
+        i = (i + 1) & mask;
+      }
+    return m_slots[i];
+  }
+
+  /// Removes a slot, moving later entries of its probe sequence back so lookups need no tombstones
+  void Erase (Slot &slot)
+  {
+    uint64_t mask = m_slots.size () - 1;
+    uint64_t hole = &slot - &m_slots[0];
+    m_slots[hole].key = 0;
+    --m_used;
+    for (uint64_t i = (hole + 1) & mask; m_slots[i].key != 0; i = (i + 1) & mask)
+      {
+        uint64_t home = Hash (m_slots[i].key - 1) & mask;
+        // move the entry if the hole lies between its home slot and where it is now
+        if (((i - home) & mask) >= ((i - hole) & mask))
+          {
+            m_slots[hole] = m_slots[i];
+            m_slots[i].key = 0;
+            hole = i;
+          }
+      }
+  }
+
+  /// Doubles the table once it is half full
+  void Grow (void)
+  {
+    if (2 * m_used <= m_slots.size ())
+      {
+        return;
+      }
+    std::vector<Slot> old;
+    old.swap (m_slots);
+    m_slots.resize (2 * old.size ());
+    for (uint64_t i = 0; i < old.size (); ++i)
+      {
+        if (old[i].key != 0)
+          {
+            Find (old[i].key - 1) = old[i];
+          }
+      }
+  }
+
+  /// \return lost scaled from the sampled to all sent packets
+  static uint64_t Estimate (uint64_t lost, uint64_t sampled, uint64_t sent)
+  {
+    if (sampled == 0 || sampled == sent)
+      {
+        return lost;
+      }
+    return static_cast<uint64_t> (static_cast<double> (lost) * sent / sampled + 0.5);
+  }
+
+  /// splitmix64 finalizer, every input bit affects every output bit
+  static uint64_t Mix (uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  static uint64_t Hash (uint64_t uid)
+  {
+    // uids are sequential, spread them over the table
+    return uid * 0x9e3779b97f4a7c15ULL >> 20;
+  }
+
+  Time m_maxPerHopDelay;
+  Time m_binWidth;
+  std::vector<Slot> m_slots;
+  uint64_t m_used;
+  std::deque<Expiry> m_queue;
+  std::vector<uint32_t> m_flowSlots;  ///< flow index plus one by five-tuple hash, 0 if free
+  std::vector<Counters> m_flows;
+  std::vector<FiveTuple> m_tuples;
+  std::vector<uint64_t> m_tupleHashes;
+  std::vector<Counters> m_bins;
+  std::vector<SegmentDelays> m_segments;
+  uint64_t m_txPackets;
+  uint32_t m_sampling;
+  uint64_t m_sampledPackets;
+  uint64_t m_lostPackets;
+  Callback<void, uint32_t, uint64_t, Time, uint32_t> m_delivered;
+};
+
+} // namespace ns3
+
+#endif // FLOW_LOSS_TRACKER_H
@@ -0,0 +1,133 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+#include "flow-snapshot-format.h"
+
+/**
+ * Prints a flow snapshot file (--snapshotFile, flow-snapshot-format.h) as CSV,
+ * one line per snapshot with the totals over all flows that changed in it,
+ * or over one flow with --flow. Can be run on the file of a simulation that
+ * is still going on.
+ *
+ * Needs no ns-3, build it on its own with
+ *   g++ -O2 -o flow-snapshot-dump flow-snapshot-dump.cc
+ *
+ * Usage: flow-snapshot-dump [--flow=ID] file
+ */
+
+namespace {
+
+struct Interval
+{
+  int64_t timeNs;
+  uint32_t flows;
+  uint64_t txPackets;
+  uint64_t rxPackets;
+  uint64_t lostPackets;
+  uint64_t rxBytes;
+  int64_t delaySumNs;
+};
+
+void
+PrintInterval (const Interval &interval, int64_t previousNs)
+{
+  double seconds = (interval.timeNs - previousNs) * 1e-9;
+  printf ("%.9g,%u,%llu,%llu,%llu,%.6g,%.9g\n", interval.timeNs * 1e-9, interval.flows,
+          (unsigned long long) interval.txPackets, (unsigned long long) interval.rxPackets,
+          (unsigned long long) interval.lostPackets, seconds > 0 ? interval.rxBytes * 8 / seconds : 0.0,
+          interval.rxPackets > 0 ? interval.delaySumNs * 1e-9 / interval.rxPackets : 0.0);
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  std::string filename;
+  bool oneFlow = false;
+  uint32_t flowId = 0;
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg.compare (0, 7, "--flow=") == 0)
+        {
+          oneFlow = true;
+          flowId = strtoul (arg.c_str () + 7, 0, 10);
+        }
+      else if (arg.compare (0, 2, "--") != 0 && filename.empty ())
+        {
+          filename = arg;
+        }
+      else
+        {
+          filename.clear ();
+          break;
+        }
+    }
+  if (filename.empty ())
+    {
+      std::cerr << "Usage: flow-snapshot-dump [--flow=ID] file\n";
+      return 2;
+    }
+
+  FlowSnapshotReader reader;
+  std::string error;
+  if (!reader.Open (filename, error))
+    {
+      std::cerr << "flow-snapshot-dump: " << error << "\n";
+      return 1;
+    }
+  printf ("timeS,flows,txPackets,rxPackets,lostPackets,throughputBps,meanDelayS\n");
+  std::vector<FlowSnapshotRecord> records (4096);
+  Interval interval = Interval ();
+  int64_t previousNs = 0;
+  uint32_t n;
+  while ((n = reader.Read (&records[0], records.size ())) > 0)
+    {
+      for (uint32_t i = 0; i < n; ++i)
+        {
+          const FlowSnapshotRecord &r = records[i];
+          if (oneFlow && r.flowId != flowId)
+            {
+              continue;
+            }
+          if (r.timeNs != interval.timeNs && interval.flows > 0)
+            {
+              PrintInterval (interval, previousNs);
+              previousNs = interval.timeNs;
+              interval = Interval ();
+            }
+          interval.timeNs = r.timeNs;
+          ++interval.flows;
+          interval.txPackets += r.txPackets;
+          interval.rxPackets += r.rxPackets;
+          interval.lostPackets += r.lostPackets;
+          interval.rxBytes += r.rxBytes;
+          interval.delaySumNs += r.delaySumNs;
+        }
+    }
+  if (interval.flows > 0)
+    {
+      PrintInterval (interval, previousNs);
+    }
+  return 0;
+}
@@ -0,0 +1,117 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_SNAPSHOT_FORMAT_H
+#define FLOW_SNAPSHOT_FORMAT_H
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+/*
+ * Time series of FlowMonitor snapshots, version 1, written by
+ * flow-snapshot.h while the simulation runs. Does not depend on ns-3.
+ *
+ * Native endian, a FlowSnapshotHeader followed by FlowSnapshotRecords. A
+ * snapshot appends one record per flow that changed since the previous
+ * snapshot, all with the same timeNs; the counters of a record are the
+ * increments since the previous record of its flow. Summing the records of a
+ * flow gives its FlowMonitor::FlowStats counters at that time.
+ */
+
+struct FlowSnapshotHeader
+{
+  char magic[8];              ///< "FLOWSNP" and a NUL
+  uint32_t version;           ///< FLOW_SNAPSHOT_VERSION
+  uint32_t recordSize;        ///< sizeof (FlowSnapshotRecord) of the writer
+  int64_t intervalNs;         ///< simulated time between snapshots
+};
+
+struct FlowSnapshotRecord
+{
+  int64_t timeNs;             ///< simulation time of the snapshot
+  uint32_t flowId;
+  uint32_t txPackets;
+  uint32_t rxPackets;
+  uint32_t lostPackets;
+  uint64_t txBytes;
+  uint64_t rxBytes;
+  int64_t delaySumNs;
+  int64_t jitterSumNs;
+};
+
+static const uint32_t FLOW_SNAPSHOT_VERSION = 1;
+
+/// Reads the records of a snapshot file block by block
+class FlowSnapshotReader
+{
+public:
+  FlowSnapshotReader ()
+    : m_file (0),
+      m_intervalNs (0)
+  {
+  }
+
+  ~FlowSnapshotReader ()
+  {
+    if (m_file != 0)
+      {
+        fclose (m_file);
+      }
+  }
+
+  /// \return false with the reason in error if the file is not a snapshot file
+  bool Open (std::string filename, std::string &error)
+  {
+    m_file = fopen (filename.c_str (), "rb");
+    if (m_file == 0)
+      {
+        error = "cannot read " + filename;
+        return false;
+      }
+    FlowSnapshotHeader header;
+    if (fread (&header, sizeof (header), 1, m_file) != 1 || memcmp (header.magic, "FLOWSNP", 8) != 0)
+      {
+        error = filename + " is not a flow snapshot file";
+        return false;
+      }
+    if (header.version != FLOW_SNAPSHOT_VERSION || header.recordSize != sizeof (FlowSnapshotRecord))
+      {
+        error = filename + " is a flow snapshot file of another version";
+        return false;
+      }
+    m_intervalNs = header.intervalNs;
+    return true;
+  }
+
+  int64_t GetIntervalNs (void) const
+  {
+    return m_intervalNs;
+  }
+
+  /// \return the number of records read into records, 0 at the end of the file
+  uint32_t Read (FlowSnapshotRecord *records, uint32_t maxRecords)
+  {
+    return fread (records, sizeof (FlowSnapshotRecord), maxRecords, m_file);
+  }
+
+private:
+  FILE *m_file;
+  int64_t m_intervalNs;
+};
+
+#endif // FLOW_SNAPSHOT_FORMAT_H
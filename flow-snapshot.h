@@ -0,0 +1,264 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_SNAPSHOT_H
+#define FLOW_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor-module.h"
+
+#include "flow-snapshot-format.h"
+#include "flow-loss-tracker.h"
+#include "flow-table.h"
+
+namespace ns3 {
+
+/**
+ * Appends FlowMonitor snapshots to a file every interval of simulated time,
+ * in the format of flow-snapshot-format.h, without stopping the simulation.
+ *
+ * Every snapshot compares the counters of each flow with those it last
+ * wrote, kept next to a FlowTable of the monitor, both indexed by flow ID,
+ * and writes a delta record only for the flows that changed. The file is flushed after every snapshot so it
+ * can be followed while the run goes on.
+ *
+ * With SetAbortThresholds () a run whose loss ratio or mean delay over the
+ * last interval exceeds a limit is stopped at that snapshot. Losses are only
+ * known after FlowMonitor::CheckForLostPackets (), which then runs before
+ * every snapshot; it scans all packets in flight, so it is left out when no
+ * loss limit is set. With SetLossTracker () the limit is checked against the
+ * losses a FlowLossTracker found incrementally instead.
+ */
+class FlowSnapshotWriter
+{
+public:
+  FlowSnapshotWriter ()
+    : m_file (0),
+      m_table (0),
+      m_tracker (0),
+      m_trackerLost (0),
+      m_maxLossRatio (0),
+      m_minPackets (0),
+      m_aborted (false)
+  {
+  }
+
+  ~FlowSnapshotWriter ()
+  {
+    if (m_file != 0)
+      {
+        fclose (m_file);
+      }
+    delete m_table;
+  }
+
+  /**
+   * Stops the run at the first snapshot whose interval has at least
+   * minPackets received or lost packets and a loss ratio above maxLossRatio
+   * or a mean delay above maxMeanDelay. A zero limit is not checked.
+   */
+  void SetAbortThresholds (double maxLossRatio, Time maxMeanDelay, uint32_t minPackets)
+  {
+    m_maxLossRatio = maxLossRatio;
+    m_maxMeanDelay = maxMeanDelay;
+    m_minPackets = minPackets;
+  }
+
+  /// Takes the losses of the loss limit from tracker instead of CheckForLostPackets ()
+  void SetLossTracker (FlowLossTracker *tracker)
+  {
+    m_tracker = tracker;
+  }
+
+  /// Creates filename and schedules the first snapshot one interval from now
+  void Start (Ptr<FlowMonitor> monitor, std::string filename, Time interval)
+  {
+    m_monitor = monitor;
+    m_table = new FlowTable (monitor);
+    m_interval = interval;
+    m_file = fopen (filename.c_str (), "wb");
+    if (m_file == 0)
+      {
+        NS_FATAL_ERROR ("Cannot write flow snapshots to " << filename);
+      }
+    FlowSnapshotHeader header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, "FLOWSNP", 8);
+    header.version = FLOW_SNAPSHOT_VERSION;
+    header.recordSize = sizeof (FlowSnapshotRecord);
+    header.intervalNs = interval.GetNanoSeconds ();
+    fwrite (&header, sizeof (header), 1, m_file);
+    fflush (m_file);
+    m_event = Simulator::Schedule (interval, &FlowSnapshotWriter::Snapshot, this);
+  }
+
+  /// Writes the changes since the last snapshot, e.g. after the final CheckForLostPackets (), and closes the file
+  void Finish (void)
+  {
+    if (m_file == 0)
+      {
+        return;
+      }
+    m_event.Cancel ();
+    uint64_t rx, lost;
+    int64_t delaySumNs;
+    Write (rx, lost, delaySumNs);
+    fclose (m_file);
+    m_file = 0;
+  }
+
+  /// \return true if a threshold stopped the run
+  bool IsAborted (void) const
+  {
+    return m_aborted;
+  }
+
+private:
+  /// Last written counters of a flow
+  struct FlowState
+  {
+    uint32_t txPackets;
+    uint32_t rxPackets;
+    uint32_t lostPackets;
+    uint64_t txBytes;
+    uint64_t rxBytes;
+    int64_t delaySumNs;
+    int64_t jitterSumNs;
+  };
+
+  void Snapshot (void)
+  {
+    if (m_tracker == 0 && m_maxLossRatio > 0)
+      {
+        m_monitor->CheckForLostPackets ();
+      }
+    uint64_t rx, lost;
+    int64_t delaySumNs;
+    Write (rx, lost, delaySumNs);
+    if (m_tracker != 0)
+      {
+        m_tracker->Update ();
+        lost = m_tracker->GetLostPackets () - m_trackerLost;
+        m_trackerLost = m_tracker->GetLostPackets ();
+      }
+    CheckThresholds (rx, lost, delaySumNs);
+    if (m_aborted)
+      {
+        Simulator::Stop ();
+        return;
+      }
+    m_event = Simulator::Schedule (m_interval, &FlowSnapshotWriter::Snapshot, this);
+  }
+
+  /// Appends a record for every changed flow, returns the totals over the interval
+  void Write (uint64_t &rx, uint64_t &lost, int64_t &delaySumNs)
+  {
+    int64_t now = Simulator::Now ().GetNanoSeconds ();
+    rx = 0;
+    lost = 0;
+    delaySumNs = 0;
+    m_table->Update ();
+    if (m_flows.size () < m_table->GetSize ())
+      {
+        FlowState empty;
+        memset (&empty, 0, sizeof (empty));
+        m_flows.resize (m_table->GetSize (), empty);
+      }
+    for (FlowId flowId = 0; flowId < m_table->GetSize (); ++flowId)
+      {
+        const FlowMonitor::FlowStats *stats = m_table->Get (flowId).stats;
+        if (stats == 0)
+          {
+            continue;
+          }
+        const FlowMonitor::FlowStats &flow = *stats;
+        FlowState &last = m_flows[flowId];
+        if (flow.txPackets == last.txPackets && flow.rxPackets == last.rxPackets
+            && flow.lostPackets == last.lostPackets)
+          {
+            continue;
+          }
+        FlowSnapshotRecord record;
+        record.timeNs = now;
+        record.flowId = flowId;
+        record.txPackets = flow.txPackets - last.txPackets;
+        record.rxPackets = flow.rxPackets - last.rxPackets;
+        record.lostPackets = flow.lostPackets - last.lostPackets;
+        record.txBytes = flow.txBytes - last.txBytes;
+        record.rxBytes = flow.rxBytes - last.rxBytes;
+        record.delaySumNs = flow.delaySum.GetNanoSeconds () - last.delaySumNs;
+        record.jitterSumNs = flow.jitterSum.GetNanoSeconds () - last.jitterSumNs;
+        fwrite (&record, sizeof (record), 1, m_file);
+        rx += record.rxPackets;
+        lost += record.lostPackets;
+        delaySumNs += record.delaySumNs;
+        last.txPackets = flow.txPackets;
+        last.rxPackets = flow.rxPackets;
+        last.lostPackets = flow.lostPackets;
+        last.txBytes = flow.txBytes;
+        last.rxBytes = flow.rxBytes;
+        last.delaySumNs = flow.delaySum.GetNanoSeconds ();
+        last.jitterSumNs = flow.jitterSum.GetNanoSeconds ();
+      }
+    fflush (m_file);
+  }
+
+  /// Marks the run aborted if the interval broke a limit
+  void CheckThresholds (uint64_t rx, uint64_t lost, int64_t delaySumNs)
+  {
+    if (rx + lost == 0 || rx + lost < m_minPackets)
+      {
+        return;
+      }
+    double lossRatio = static_cast<double> (lost) / (rx + lost);
+    Time meanDelay = rx > 0 ? NanoSeconds (delaySumNs / static_cast<int64_t> (rx)) : Time (0);
+    if (m_maxLossRatio > 0 && lossRatio > m_maxLossRatio)
+      {
+        std::cout << "Snapshot: aborting at " << Simulator::Now ().GetSeconds () << " s, loss ratio "
+                  << lossRatio << " over the last interval\n";
+        m_aborted = true;
+      }
+    else if (m_maxMeanDelay.IsStrictlyPositive () && meanDelay > m_maxMeanDelay)
+      {
+        std::cout << "Snapshot: aborting at " << Simulator::Now ().GetSeconds () << " s, mean delay "
+                  << meanDelay.GetSeconds () * 1000 << " ms over the last interval\n";
+        m_aborted = true;
+      }
+  }
+
+  Ptr<FlowMonitor> m_monitor;
+  Time m_interval;
+  FILE *m_file;
+  EventId m_event;
+  FlowTable *m_table;
+  FlowLossTracker *m_tracker;
+  uint64_t m_trackerLost;
+  std::vector<FlowState> m_flows;
+  double m_maxLossRatio;
+  Time m_maxMeanDelay;
+  uint32_t m_minPackets;
+  bool m_aborted;
+};
+
+} // namespace ns3
+
+#endif // FLOW_SNAPSHOT_H
@@ -0,0 +1,746 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_STATS_FORMAT_H
+#define FLOW_STATS_FORMAT_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hdr-histogram.h"
+
+/*
+ * Binary columnar FlowMonitor export, version 1. Does not depend on ns-3 so
+ * the analysis tools can read and write it without linking the simulator;
+ * flow-stats-writer.h fills it from a running FlowMonitor.
+ *
+ * All integers are native endian, all offsets are counted from the start of
+ * the file and every column starts on an 8 byte boundary:
+ *
+ *   FlowStatsHeader
+ *   FlowStatsColumnInfo[columnCount]
+ *   FlowStatsHistogramInfo[histogramCount]
+ *   column data, flowCount values per column
+ *   histogram data, per histogram:
+ *     uint64_t rowStart[flowCount + 1]   first entry of every row
+ *     uint32_t bin[entries]              index of every non-empty bin
+ *     uint32_t count[entries]            packets in that bin
+ *
+ * Rows are sorted by flow ID, so the FLOW_ID column is the flow-ID index:
+ * FlowStatsReader::Find () looks a flow up by binary search.
+ *
+ * A histogram with subBucketBits 0 has bins of binWidth, as ns3::Histogram;
+ * otherwise its bins are log-linear (hdr-histogram.h) with binWidth as the
+ * unit. FlowStatsBinStart () and FlowStatsBinWidth () handle both.
+ */
+
+/// Column identifiers, one per FlowMonitor::FlowStats field plus the five-tuple
+enum FlowStatsColumn
+{
+  FLOW_STATS_FLOW_ID = 0,             ///< uint32_t
+  FLOW_STATS_TIME_FIRST_TX = 1,       ///< int64_t, ns
+  FLOW_STATS_TIME_FIRST_RX = 2,       ///< int64_t, ns
+  FLOW_STATS_TIME_LAST_TX = 3,        ///< int64_t, ns
+  FLOW_STATS_TIME_LAST_RX = 4,        ///< int64_t, ns
+  FLOW_STATS_DELAY_SUM = 5,           ///< int64_t, ns
+  FLOW_STATS_JITTER_SUM = 6,          ///< int64_t, ns
+  FLOW_STATS_LAST_DELAY = 7,          ///< int64_t, ns
+  FLOW_STATS_TX_BYTES = 8,            ///< uint64_t
+  FLOW_STATS_RX_BYTES = 9,            ///< uint64_t
+  FLOW_STATS_TX_PACKETS = 10,         ///< uint32_t
+  FLOW_STATS_RX_PACKETS = 11,         ///< uint32_t
+  FLOW_STATS_LOST_PACKETS = 12,       ///< uint32_t
+  FLOW_STATS_TIMES_FORWARDED = 13,    ///< uint32_t
+  FLOW_STATS_PACKETS_DROPPED = 14,    ///< uint32_t, sum over all drop reasons
+  FLOW_STATS_BYTES_DROPPED = 15,      ///< uint64_t, sum over all drop reasons
+  FLOW_STATS_SOURCE_ADDRESS = 16,     ///< uint32_t, IPv4 host order
+  FLOW_STATS_DESTINATION_ADDRESS = 17, ///< uint32_t, IPv4 host order
+  FLOW_STATS_SOURCE_PORT = 18,        ///< uint16_t
+  FLOW_STATS_DESTINATION_PORT = 19,   ///< uint16_t
+  FLOW_STATS_PROTOCOL = 20,           ///< uint8_t
+  FLOW_STATS_COLUMN_COUNT = 21
+};
+
+/// Histograms of FlowMonitor::FlowStats
+enum FlowStatsHistogram
+{
+  FLOW_STATS_DELAY_HISTOGRAM = 0,
+  FLOW_STATS_JITTER_HISTOGRAM = 1,
+  FLOW_STATS_PACKET_SIZE_HISTOGRAM = 2,
+  FLOW_STATS_FLOW_INTERRUPTIONS_HISTOGRAM = 3,
+  FLOW_STATS_HISTOGRAM_COUNT = 4
+};
+
+struct FlowStatsHeader
+{
+  char magic[8];              ///< "FLOWSTS" and a NUL
+  uint32_t version;           ///< FLOW_STATS_VERSION
+  uint32_t headerSize;        ///< sizeof (FlowStatsHeader) of the writer
+  uint64_t flowCount;
+  uint32_t columnCount;
+  uint32_t histogramCount;
+  uint64_t columnInfoOffset;
+  uint64_t histogramInfoOffset;
+  int64_t simulationTimeNs;   ///< time the stats were taken at
+};
+
+struct FlowStatsColumnInfo
+{
+  uint32_t column;            ///< FlowStatsColumn
+  uint32_t width;             ///< bytes per value
+  uint64_t offset;
+};
+
+struct FlowStatsHistogramInfo
+{
+  uint32_t histogram;         ///< FlowStatsHistogram
+  uint32_t subBucketBits;     ///< 0 for linear bins, else log-linear bins with binWidth as unit
+  double binWidth;            ///< seconds for delay, jitter and interruptions, bytes for sizes
+  uint64_t entries;           ///< non-empty bins over all flows
+  uint64_t rowStartOffset;
+  uint64_t binOffset;
+  uint64_t countOffset;
+};
+
+static const uint32_t FLOW_STATS_VERSION = 1;
+
+/// \return bytes per value of a column
+inline uint32_t
+FlowStatsColumnWidth (uint32_t column)
+{
+  switch (column)
+    {
+    case FLOW_STATS_TIME_FIRST_TX:
+    case FLOW_STATS_TIME_FIRST_RX:
+    case FLOW_STATS_TIME_LAST_TX:
+    case FLOW_STATS_TIME_LAST_RX:
+    case FLOW_STATS_DELAY_SUM:
+    case FLOW_STATS_JITTER_SUM:
+    case FLOW_STATS_LAST_DELAY:
+    case FLOW_STATS_TX_BYTES:
+    case FLOW_STATS_RX_BYTES:
+    case FLOW_STATS_BYTES_DROPPED:
+      return 8;
+    case FLOW_STATS_SOURCE_PORT:
+    case FLOW_STATS_DESTINATION_PORT:
+      return 2;
+    case FLOW_STATS_PROTOCOL:
+      return 1;
+    default:
+      return 4;
+    }
+}
+
+/// \return an IPv4 address in dotted notation, as stored in the address columns
+inline std::string
+FlowStatsFormatAddress (uint32_t address)
+{
+  char text[16];
+  snprintf (text, sizeof (text), "%u.%u.%u.%u", address >> 24, (address >> 16) & 0xff,
+            (address >> 8) & 0xff, address & 0xff);
+  return text;
+}
+
+/// \return a dotted IPv4 address in host order, 0 if text is 0
+inline uint32_t
+FlowStatsParseAddress (const char *text)
+{
+  unsigned int b[4] = { 0, 0, 0, 0 };
+  if (text != 0)
+    {
+      sscanf (text, "%u.%u.%u.%u", &b[0], &b[1], &b[2], &b[3]);
+    }
+  return (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+/// \return offset rounded up to the next 8 byte boundary
+inline uint64_t
+FlowStatsAlign (uint64_t offset)
+{
+  return (offset + 7) & ~static_cast<uint64_t> (7);
+}
+
+/// \return the first value of a bin, for linear (bits 0) and log-linear bins
+inline double
+FlowStatsBinStart (double binWidth, uint32_t subBucketBits, uint32_t bin)
+{
+  return subBucketBits == 0 ? bin * binWidth : LogLinearBinStart (bin, subBucketBits) * binWidth;
+}
+
+/// \return the width of a bin, for linear (bits 0) and log-linear bins
+inline double
+FlowStatsBinWidth (double binWidth, uint32_t subBucketBits, uint32_t bin)
+{
+  return subBucketBits == 0 ? binWidth : LogLinearBinWidth (bin, subBucketBits) * binWidth;
+}
+
+/// One row of the file, every column of FlowStatsColumn
+struct FlowStatsRecord
+{
+  uint32_t flowId;
+  int64_t timeFirstTxNs;
+  int64_t timeFirstRxNs;
+  int64_t timeLastTxNs;
+  int64_t timeLastRxNs;
+  int64_t delaySumNs;
+  int64_t jitterSumNs;
+  int64_t lastDelayNs;
+  uint64_t txBytes;
+  uint64_t rxBytes;
+  uint32_t txPackets;
+  uint32_t rxPackets;
+  uint32_t lostPackets;
+  uint32_t timesForwarded;
+  uint32_t packetsDropped;
+  uint64_t bytesDropped;
+  uint32_t sourceAddress;
+  uint32_t destinationAddress;
+  uint16_t sourcePort;
+  uint16_t destinationPort;
+  uint8_t protocol;
+};
+
+/**
+ * Read-only view of a flow stats file, mapped with mmap. Columns are handed
+ * out as typed pointers into the mapping, so reading a column of a million
+ * flows touches only the pages of that column.
+ */
+class FlowStatsReader
+{
+public:
+  FlowStatsReader ()
+    : m_data (0),
+      m_size (0),
+      m_header (0)
+  {
+    memset (m_columns, 0, sizeof (m_columns));
+    memset (m_histograms, 0, sizeof (m_histograms));
+  }
+
+  ~FlowStatsReader ()
+  {
+    if (m_data != 0)
+      {
+        munmap (m_data, m_size);
+      }
+  }
+
+  /// \return false with the reason in error if the file cannot be used
+  bool Open (std::string filename, std::string &error)
+  {
+    int fd = open (filename.c_str (), O_RDONLY);
+    if (fd < 0)
+      {
+        error = "cannot open " + filename;
+        return false;
+      }
+    struct stat st;
+    if (fstat (fd, &st) != 0 || st.st_size < (off_t) sizeof (FlowStatsHeader))
+      {
+        close (fd);
+        error = filename + " is too short";
+        return false;
+      }
+    m_size = st.st_size;
+    m_data = mmap (0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (m_data == MAP_FAILED)
+      {
+        m_data = 0;
+        error = "cannot map " + filename;
+        return false;
+      }
+    m_header = static_cast<const FlowStatsHeader *> (m_data);
+    if (memcmp (m_header->magic, "FLOWSTS", 8) != 0)
+      {
+        error = filename + " is not a flow stats file";
+        return false;
+      }
+    if (m_header->version != FLOW_STATS_VERSION || m_header->headerSize != sizeof (FlowStatsHeader))
+      {
+        error = filename + " has an unsupported flow stats version";
+        return false;
+      }
+    if (m_header->columnInfoOffset + m_header->columnCount * sizeof (FlowStatsColumnInfo) > m_size
+        || m_header->histogramInfoOffset + m_header->histogramCount * sizeof (FlowStatsHistogramInfo) > m_size)
+      {
+        error = filename + " is truncated";
+        return false;
+      }
+    const char *data = static_cast<const char *> (m_data);
+    const FlowStatsColumnInfo *columns = reinterpret_cast<const FlowStatsColumnInfo *> (data + m_header->columnInfoOffset);
+    for (uint32_t i = 0; i < m_header->columnCount; ++i)
+      {
+        if (columns[i].offset + columns[i].width * m_header->flowCount > m_size)
+          {
+            error = filename + " is truncated";
+            return false;
+          }
+        // columns added by later versions are skipped
+        if (columns[i].column < FLOW_STATS_COLUMN_COUNT
+            && columns[i].width == FlowStatsColumnWidth (columns[i].column))
+          {
+            m_columns[columns[i].column] = data + columns[i].offset;
+          }
+      }
+    const FlowStatsHistogramInfo *histograms = reinterpret_cast<const FlowStatsHistogramInfo *> (data + m_header->histogramInfoOffset);
+    for (uint32_t i = 0; i < m_header->histogramCount; ++i)
+      {
+        if (histograms[i].rowStartOffset + (m_header->flowCount + 1) * sizeof (uint64_t) > m_size
+            || histograms[i].binOffset + histograms[i].entries * sizeof (uint32_t) > m_size
+            || histograms[i].countOffset + histograms[i].entries * sizeof (uint32_t) > m_size)
+          {
+            error = filename + " is truncated";
+            return false;
+          }
+        const uint64_t *rowStart = reinterpret_cast<const uint64_t *> (data + histograms[i].rowStartOffset);
+        if (rowStart[m_header->flowCount] != histograms[i].entries)
+          {
+            error = filename + " has a corrupt histogram index";
+            return false;
+          }
+        if (histograms[i].histogram < FLOW_STATS_HISTOGRAM_COUNT)
+          {
+            m_histograms[histograms[i].histogram] = &histograms[i];
+          }
+      }
+    if (m_columns[FLOW_STATS_FLOW_ID] == 0)
+      {
+        error = filename + " has no flow ID column";
+        return false;
+      }
+    return true;
+  }
+
+  uint64_t GetFlowCount (void) const
+  {
+    return m_header->flowCount;
+  }
+
+  int64_t GetSimulationTimeNs (void) const
+  {
+    return m_header->simulationTimeNs;
+  }
+
+  bool HasColumn (FlowStatsColumn column) const
+  {
+    return m_columns[column] != 0;
+  }
+
+  /**
+   * \return the values of a column, one per row, or 0 if the file does not
+   *         have it. T must match FlowStatsColumnWidth ().
+   */
+  template <typename T>
+  const T *GetColumn (FlowStatsColumn column) const
+  {
+    return reinterpret_cast<const T *> (m_columns[column]);
+  }
+
+  /// \return the row of a flow, or -1 if the file does not have it
+  int64_t Find (uint32_t flowId) const
+  {
+    const uint32_t *ids = GetColumn<uint32_t> (FLOW_STATS_FLOW_ID);
+    uint64_t low = 0;
+    uint64_t high = m_header->flowCount;
+    while (low < high)
+      {
+        uint64_t middle = low + (high - low) / 2;
+        if (ids[middle] < flowId)
+          {
+            low = middle + 1;
+          }
+        else
+          {
+            high = middle;
+          }
+      }
+    return low < m_header->flowCount && ids[low] == flowId ? static_cast<int64_t> (low) : -1;
+  }
+
+  /// \return all columns of a row, 0 for the columns the file does not have
+  FlowStatsRecord GetRecord (uint64_t row) const
+  {
+    FlowStatsRecord r;
+    r.flowId = Value<uint32_t> (FLOW_STATS_FLOW_ID, row);
+    r.timeFirstTxNs = Value<int64_t> (FLOW_STATS_TIME_FIRST_TX, row);
+    r.timeFirstRxNs = Value<int64_t> (FLOW_STATS_TIME_FIRST_RX, row);
+    r.timeLastTxNs = Value<int64_t> (FLOW_STATS_TIME_LAST_TX, row);
+    r.timeLastRxNs = Value<int64_t> (FLOW_STATS_TIME_LAST_RX, row);
+    r.delaySumNs = Value<int64_t> (FLOW_STATS_DELAY_SUM, row);
+    r.jitterSumNs = Value<int64_t> (FLOW_STATS_JITTER_SUM, row);
+    r.lastDelayNs = Value<int64_t> (FLOW_STATS_LAST_DELAY, row);
+    r.txBytes = Value<uint64_t> (FLOW_STATS_TX_BYTES, row);
+    r.rxBytes = Value<uint64_t> (FLOW_STATS_RX_BYTES, row);
+    r.txPackets = Value<uint32_t> (FLOW_STATS_TX_PACKETS, row);
+    r.rxPackets = Value<uint32_t> (FLOW_STATS_RX_PACKETS, row);
+    r.lostPackets = Value<uint32_t> (FLOW_STATS_LOST_PACKETS, row);
+    r.timesForwarded = Value<uint32_t> (FLOW_STATS_TIMES_FORWARDED, row);
+    r.packetsDropped = Value<uint32_t> (FLOW_STATS_PACKETS_DROPPED, row);
+    r.bytesDropped = Value<uint64_t> (FLOW_STATS_BYTES_DROPPED, row);
+    r.sourceAddress = Value<uint32_t> (FLOW_STATS_SOURCE_ADDRESS, row);
+    r.destinationAddress = Value<uint32_t> (FLOW_STATS_DESTINATION_ADDRESS, row);
+    r.sourcePort = Value<uint16_t> (FLOW_STATS_SOURCE_PORT, row);
+    r.destinationPort = Value<uint16_t> (FLOW_STATS_DESTINATION_PORT, row);
+    r.protocol = Value<uint8_t> (FLOW_STATS_PROTOCOL, row);
+    return r;
+  }
+
+  bool HasHistogram (FlowStatsHistogram histogram) const
+  {
+    return m_histograms[histogram] != 0;
+  }
+
+  double GetBinWidth (FlowStatsHistogram histogram) const
+  {
+    return m_histograms[histogram]->binWidth;
+  }
+
+  /// \return 0 for linear bins, else the bits of log-linear bins
+  uint32_t GetSubBucketBits (FlowStatsHistogram histogram) const
+  {
+    return m_histograms[histogram]->subBucketBits;
+  }
+
+  /**
+   * \param bins set to the indexes of the non-empty bins of the row
+   * \param counts set to the packet count of each of those bins
+   * \return the number of non-empty bins
+   */
+  uint64_t GetHistogram (FlowStatsHistogram histogram, uint64_t row,
+                         const uint32_t *&bins, const uint32_t *&counts) const
+  {
+    const FlowStatsHistogramInfo *info = m_histograms[histogram];
+    const char *data = static_cast<const char *> (m_data);
+    const uint64_t *rowStart = reinterpret_cast<const uint64_t *> (data + info->rowStartOffset);
+    bins = reinterpret_cast<const uint32_t *> (data + info->binOffset) + rowStart[row];
+    counts = reinterpret_cast<const uint32_t *> (data + info->countOffset) + rowStart[row];
+    return rowStart[row + 1] - rowStart[row];
+  }
+
+private:
+  FlowStatsReader (const FlowStatsReader &);
+  FlowStatsReader &operator= (const FlowStatsReader &);
+
+  template <typename T>
+  T Value (FlowStatsColumn column, uint64_t row) const
+  {
+    const T *values = GetColumn<T> (column);
+    return values != 0 ? values[row] : 0;
+  }
+
+  void *m_data;
+  size_t m_size;
+  const FlowStatsHeader *m_header;
+  const char *m_columns[FLOW_STATS_COLUMN_COUNT];
+  const FlowStatsHistogramInfo *m_histograms[FLOW_STATS_HISTOGRAM_COUNT];
+};
+
+/**
+ * Collects rows and their histogram bins, then writes them as a flow stats
+ * file front to back through a large stdio buffer. Rows may be added in any
+ * order; they are sorted by flow ID on Write ().
+ */
+class FlowStatsFileWriter
+{
+public:
+  FlowStatsFileWriter ()
+    : m_simulationTimeNs (0)
+  {
+    for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+      {
+        m_binWidth[h] = 0;
+        m_subBucketBits[h] = 0;
+        m_rowStart[h].push_back (0);
+      }
+  }
+
+  void SetBinWidth (FlowStatsHistogram histogram, double width)
+  {
+    m_binWidth[histogram] = width;
+  }
+
+  /// Makes the bins of histogram log-linear, with the width set by SetBinWidth () as unit
+  void SetSubBucketBits (FlowStatsHistogram histogram, uint32_t bits)
+  {
+    m_subBucketBits[histogram] = bits;
+  }
+
+  void SetSimulationTime (int64_t ns)
+  {
+    m_simulationTimeNs = ns;
+  }
+
+  /// Starts a new row; AddBin () adds to the histograms of the last one
+  void AddFlow (const FlowStatsRecord &record)
+  {
+    m_records.push_back (record);
+    for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+      {
+        m_rowStart[h].push_back (m_bins[h].size ());
+      }
+  }
+
+  uint64_t GetFlowCount (void) const
+  {
+    return m_records.size ();
+  }
+
+  /// Rows can be completed after AddFlow (), e.g. once their five-tuple is known
+  FlowStatsRecord &GetFlow (uint64_t row)
+  {
+    return m_records[row];
+  }
+
+  double GetBinWidth (FlowStatsHistogram histogram) const
+  {
+    return m_binWidth[histogram];
+  }
+
+  uint32_t GetSubBucketBits (FlowStatsHistogram histogram) const
+  {
+    return m_subBucketBits[histogram];
+  }
+
+  /// Same as FlowStatsReader::GetHistogram (), for the rows added so far
+  uint64_t GetHistogram (FlowStatsHistogram histogram, uint64_t row,
+                         const uint32_t *&bins, const uint32_t *&counts) const
+  {
+    const std::vector<uint64_t> &rowStart = m_rowStart[histogram];
+    uint64_t n = rowStart[row + 1] - rowStart[row];
+    bins = n > 0 ? &m_bins[histogram][rowStart[row]] : 0;
+    counts = n > 0 ? &m_counts[histogram][rowStart[row]] : 0;
+    return n;
+  }
+
+  void AddBin (FlowStatsHistogram histogram, uint32_t bin, uint32_t count)
+  {
+    if (count == 0)
+      {
+        return;
+      }
+    m_bins[histogram].push_back (bin);
+    m_counts[histogram].push_back (count);
+    ++m_rowStart[histogram].back ();
+  }
+
+  /// \return false with the reason in error if the file cannot be written
+  bool Write (std::string filename, std::string &error) const
+  {
+    uint64_t n = m_records.size ();
+    std::vector<std::pair<uint32_t, uint32_t> > order;
+    order.reserve (n);
+    for (uint32_t row = 0; row < n; ++row)
+      {
+        order.push_back (std::make_pair (m_records[row].flowId, row));
+      }
+    std::sort (order.begin (), order.end ());
+
+    FlowStatsHeader header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, "FLOWSTS", 8);
+    header.version = FLOW_STATS_VERSION;
+    header.headerSize = sizeof (FlowStatsHeader);
+    header.flowCount = n;
+    header.columnCount = FLOW_STATS_COLUMN_COUNT;
+    header.histogramCount = FLOW_STATS_HISTOGRAM_COUNT;
+    header.columnInfoOffset = sizeof (FlowStatsHeader);
+    header.histogramInfoOffset = header.columnInfoOffset + FLOW_STATS_COLUMN_COUNT * sizeof (FlowStatsColumnInfo);
+    header.simulationTimeNs = m_simulationTimeNs;
+
+    uint64_t offset = FlowStatsAlign (header.histogramInfoOffset + FLOW_STATS_HISTOGRAM_COUNT * sizeof (FlowStatsHistogramInfo));
+    FlowStatsColumnInfo columns[FLOW_STATS_COLUMN_COUNT];
+    for (uint32_t c = 0; c < FLOW_STATS_COLUMN_COUNT; ++c)
+      {
+        columns[c].column = c;
+        columns[c].width = FlowStatsColumnWidth (c);
+        columns[c].offset = offset;
+        offset = FlowStatsAlign (offset + columns[c].width * n);
+      }
+    FlowStatsHistogramInfo histograms[FLOW_STATS_HISTOGRAM_COUNT];
+    for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+      {
+        memset (&histograms[h], 0, sizeof (FlowStatsHistogramInfo));
+        histograms[h].histogram = h;
+        histograms[h].subBucketBits = m_subBucketBits[h];
+        histograms[h].binWidth = m_binWidth[h];
+        histograms[h].entries = m_bins[h].size ();
+        histograms[h].rowStartOffset = offset;
+        histograms[h].binOffset = FlowStatsAlign (offset + (n + 1) * sizeof (uint64_t));
+        histograms[h].countOffset = FlowStatsAlign (histograms[h].binOffset + histograms[h].entries * sizeof (uint32_t));
+        offset = FlowStatsAlign (histograms[h].countOffset + histograms[h].entries * sizeof (uint32_t));
+      }
+
+    FILE *file = fopen (filename.c_str (), "wb");
+    if (file == 0)
+      {
+        error = "cannot write " + filename;
+        return false;
+      }
+    std::vector<char> buffer (1 << 20);
+    setvbuf (file, &buffer[0], _IOFBF, buffer.size ());
+    uint64_t written = 0;
+    Put (file, written, &header, sizeof (header));
+    Put (file, written, columns, sizeof (columns));
+    Put (file, written, histograms, sizeof (histograms));
+    for (uint32_t c = 0; c < FLOW_STATS_COLUMN_COUNT; ++c)
+      {
+        Pad (file, written, columns[c].offset);
+        for (uint64_t i = 0; i < n; ++i)
+          {
+            PutColumn (file, written, c, m_records[order[i].second]);
+          }
+      }
+    for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+      {
+        const std::vector<uint64_t> &rowStart = m_rowStart[h];
+        Pad (file, written, histograms[h].rowStartOffset);
+        uint64_t start = 0;
+        Put (file, written, &start, sizeof (start));
+        for (uint64_t i = 0; i < n; ++i)
+          {
+            uint32_t row = order[i].second;
+            start += rowStart[row + 1] - rowStart[row];
+            Put (file, written, &start, sizeof (start));
+          }
+        for (uint32_t pass = 0; pass < 2; ++pass)
+          {
+            const std::vector<uint32_t> &values = pass == 0 ? m_bins[h] : m_counts[h];
+            Pad (file, written, pass == 0 ? histograms[h].binOffset : histograms[h].countOffset);
+            for (uint64_t i = 0; i < n; ++i)
+              {
+                uint32_t row = order[i].second;
+                if (rowStart[row + 1] > rowStart[row])
+                  {
+                    Put (file, written, &values[rowStart[row]], (rowStart[row + 1] - rowStart[row]) * sizeof (uint32_t));
+                  }
+              }
+          }
+      }
+    Pad (file, written, offset);
+    if (ferror (file) || fclose (file) != 0)
+      {
+        error = "cannot write " + filename;
+        return false;
+      }
+    return true;
+  }
+
+private:
+  static void PutColumn (FILE *file, uint64_t &written, uint32_t column, const FlowStatsRecord &r)
+  {
+    switch (column)
+      {
+      case FLOW_STATS_FLOW_ID:
+        Put (file, written, &r.flowId, 4);
+        break;
+      case FLOW_STATS_TIME_FIRST_TX:
+        Put (file, written, &r.timeFirstTxNs, 8);
+        break;
+      case FLOW_STATS_TIME_FIRST_RX:
+        Put (file, written, &r.timeFirstRxNs, 8);
+        break;
+      case FLOW_STATS_TIME_LAST_TX:
+        Put (file, written, &r.timeLastTxNs, 8);
+        break;
+      case FLOW_STATS_TIME_LAST_RX:
+        Put (file, written, &r.timeLastRxNs, 8);
+        break;
+      case FLOW_STATS_DELAY_SUM:
+        Put (file, written, &r.delaySumNs, 8);
+        break;
+      case FLOW_STATS_JITTER_SUM:
+        Put (file, written, &r.jitterSumNs, 8);
+        break;
+      case FLOW_STATS_LAST_DELAY:
+        Put (file, written, &r.lastDelayNs, 8);
+        break;
+      case FLOW_STATS_TX_BYTES:
+        Put (file, written, &r.txBytes, 8);
+        break;
+      case FLOW_STATS_RX_BYTES:
+        Put (file, written, &r.rxBytes, 8);
+        break;
+      case FLOW_STATS_TX_PACKETS:
+        Put (file, written, &r.txPackets, 4);
+        break;
+      case FLOW_STATS_RX_PACKETS:
+        Put (file, written, &r.rxPackets, 4);
+        break;
+      case FLOW_STATS_LOST_PACKETS:
+        Put (file, written, &r.lostPackets, 4);
+        break;
+      case FLOW_STATS_TIMES_FORWARDED:
+        Put (file, written, &r.timesForwarded, 4);
+        break;
+      case FLOW_STATS_PACKETS_DROPPED:
+        Put (file, written, &r.packetsDropped, 4);
+        break;
+      case FLOW_STATS_BYTES_DROPPED:
+        Put (file, written, &r.bytesDropped, 8);
+        break;
+      case FLOW_STATS_SOURCE_ADDRESS:
+        Put (file, written, &r.sourceAddress, 4);
+        break;
+      case FLOW_STATS_DESTINATION_ADDRESS:
+        Put (file, written, &r.destinationAddress, 4);
+        break;
+      case FLOW_STATS_SOURCE_PORT:
+        Put (file, written, &r.sourcePort, 2);
+        break;
+      case FLOW_STATS_DESTINATION_PORT:
+        Put (file, written, &r.destinationPort, 2);
+        break;
+      default:
+        Put (file, written, &r.protocol, 1);
+        break;
+      }
+  }
+
+  static void Put (FILE *file, uint64_t &written, const void *data, size_t size)
+  {
+    fwrite (data, 1, size, file);
+    written += size;
+  }
+
+  /// Writes zeros up to offset
+  static void Pad (FILE *file, uint64_t &written, uint64_t offset)
+  {
+    static const char zeros[8] = { 0 };
+    while (written < offset)
+      {
+        Put (file, written, zeros, std::min<uint64_t> (offset - written, sizeof (zeros)));
+      }
+  }
+
+  int64_t m_simulationTimeNs;
+  double m_binWidth[FLOW_STATS_HISTOGRAM_COUNT];
+  uint32_t m_subBucketBits[FLOW_STATS_HISTOGRAM_COUNT];
+  std::vector<FlowStatsRecord> m_records;
+  std::vector<uint64_t> m_rowStart[FLOW_STATS_HISTOGRAM_COUNT];
+  std::vector<uint32_t> m_bins[FLOW_STATS_HISTOGRAM_COUNT];
+  std::vector<uint32_t> m_counts[FLOW_STATS_HISTOGRAM_COUNT];
+};
+
+#endif // FLOW_STATS_FORMAT_H
@@ -0,0 +1,136 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_STATS_WRITER_H
+#define FLOW_STATS_WRITER_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/flow-monitor-module.h"
+
+#include "flow-stats-format.h"
+#include "flow-table.h"
+
+namespace ns3 {
+
+/**
+ * Writes the stats of a FlowMonitor in the binary columnar format of
+ * flow-stats-format.h, as a compact alternative to SerializeToXmlFile.
+ * Histograms are stored sparse: only the non-empty bins of every flow.
+ * Five-tuples come from a FlowTable.
+ */
+class FlowStatsWriter
+{
+public:
+  static void Write (std::string filename, Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier)
+  {
+    FlowTable table (monitor, classifier);
+
+    FlowStatsFileWriter writer;
+    writer.SetSimulationTime (Simulator::Now ().GetNanoSeconds ());
+    const char *widthAttributes[FLOW_STATS_HISTOGRAM_COUNT] = {
+      "DelayBinWidth", "JitterBinWidth", "PacketSizeBinWidth", "FlowInterruptionsBinWidth"
+    };
+    for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+      {
+        DoubleValue width;
+        monitor->GetAttribute (widthAttributes[h], width);
+        writer.SetBinWidth (static_cast<FlowStatsHistogram> (h), width.Get ());
+      }
+
+    for (FlowId flowId = 0; flowId < table.GetSize (); ++flowId)
+      {
+        const FlowTable::Entry &entry = table.Get (flowId);
+        if (entry.stats == 0)
+          {
+            continue;
+          }
+        const FlowMonitor::FlowStats &flow = *entry.stats;
+        FlowStatsRecord record;
+        memset (&record, 0, sizeof (record));
+        record.flowId = flowId;
+        record.timeFirstTxNs = flow.timeFirstTxPacket.GetNanoSeconds ();
+        record.timeFirstRxNs = flow.timeFirstRxPacket.GetNanoSeconds ();
+        record.timeLastTxNs = flow.timeLastTxPacket.GetNanoSeconds ();
+        record.timeLastRxNs = flow.timeLastRxPacket.GetNanoSeconds ();
+        record.delaySumNs = flow.delaySum.GetNanoSeconds ();
+        record.jitterSumNs = flow.jitterSum.GetNanoSeconds ();
+        record.lastDelayNs = flow.lastDelay.GetNanoSeconds ();
+        record.txBytes = flow.txBytes;
+        record.rxBytes = flow.rxBytes;
+        record.txPackets = flow.txPackets;
+        record.rxPackets = flow.rxPackets;
+        record.lostPackets = flow.lostPackets;
+        record.timesForwarded = flow.timesForwarded;
+        for (uint32_t i = 0; i < flow.packetsDropped.size (); ++i)
+          {
+            record.packetsDropped += flow.packetsDropped[i];
+          }
+        for (uint32_t i = 0; i < flow.bytesDropped.size (); ++i)
+          {
+            record.bytesDropped += flow.bytesDropped[i];
+          }
+        record.sourceAddress = entry.tuple.sourceAddress.Get ();
+        record.destinationAddress = entry.tuple.destinationAddress.Get ();
+        record.sourcePort = entry.tuple.sourcePort;
+        record.destinationPort = entry.tuple.destinationPort;
+        record.protocol = entry.tuple.protocol;
+        writer.AddFlow (record);
+        for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+          {
+            Histogram &histogram = GetHistogram (flow, h);
+            for (uint32_t bin = 0; bin < histogram.GetNBins (); ++bin)
+              {
+                writer.AddBin (static_cast<FlowStatsHistogram> (h), bin, histogram.GetBinCount (bin));
+              }
+          }
+      }
+
+    std::string error;
+    if (!writer.Write (filename, error))
+      {
+        NS_FATAL_ERROR ("Cannot write flow stats: " << error);
+      }
+  }
+
+private:
+  /// Histogram::GetBinCount () is not const, hence the cast
+  static Histogram &GetHistogram (const FlowMonitor::FlowStats &flow, uint32_t histogram)
+  {
+    FlowMonitor::FlowStats &stats = const_cast<FlowMonitor::FlowStats &> (flow);
+    switch (histogram)
+      {
+      case FLOW_STATS_DELAY_HISTOGRAM:
+        return stats.delayHistogram;
+      case FLOW_STATS_JITTER_HISTOGRAM:
+        return stats.jitterHistogram;
+      case FLOW_STATS_PACKET_SIZE_HISTOGRAM:
+        return stats.packetSizeHistogram;
+      default:
+        return stats.flowInterruptionsHistogram;
+      }
+  }
+};
+
+} // namespace ns3
+
+#endif // FLOW_STATS_WRITER_H
@@ -0,0 +1,114 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_TABLE_H
+#define FLOW_TABLE_H
+
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/flow-monitor-module.h"
+
+namespace ns3 {
+
+/**
+ * The flows of a FlowMonitor in a vector indexed by FlowId, each entry
+ * holding the five-tuple and a pointer to the monitor's own stats.
+ *
+ * Copying GetFlowStats () into a std::map copies every flow. The table
+ * points into the monitor's container instead, whose elements stay where
+ * they are, and keeps the five-tuple of every flow once it has been looked
+ * up in the classifier. Reports and snapshots then walk it as a linear scan.
+ *
+ * Update () adds the flows the monitor classified since the last call,
+ * looking only at FlowIds past the end of the table; only the five-tuples of
+ * those new flows are looked up, and only when a classifier was given.
+ */
+class FlowTable
+{
+public:
+  struct Entry
+  {
+    Entry ()
+      : stats (0)
+    {
+      tuple.sourcePort = 0;
+      tuple.destinationPort = 0;
+      tuple.protocol = 0;
+    }
+    const FlowMonitor::FlowStats *stats;        ///< 0 for FlowIds the monitor does not have
+    Ipv4FlowClassifier::FiveTuple tuple;
+  };
+
+  /// Without a classifier the five-tuples stay zero
+  FlowTable (Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier = 0)
+    : m_monitor (monitor),
+      m_classifier (classifier)
+  {
+    Update ();
+  }
+
+  void Update (void)
+  {
+    const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats ();
+    FlowId first = m_entries.size ();
+    for (FlowMonitor::FlowStatsContainerCI it = stats.lower_bound (first); it != stats.end (); ++it)
+      {
+        if (it->first >= m_entries.size ())
+          {
+            m_entries.resize (it->first + 1);
+          }
+        m_entries[it->first].stats = &it->second;
+      }
+    if (m_classifier != 0 && m_entries.size () > first)
+      {
+        ReadFiveTuples (first);
+      }
+  }
+
+  /// \return one past the highest FlowId
+  uint32_t GetSize (void) const
+  {
+    return m_entries.size ();
+  }
+
+  const Entry &Get (FlowId flowId) const
+  {
+    return m_entries[flowId];
+  }
+
+private:
+  /// Looks up the five-tuples of the flows from first on that the monitor has stats for
+  void ReadFiveTuples (FlowId first)
+  {
+    for (FlowId flowId = first; flowId < m_entries.size (); ++flowId)
+      {
+        if (m_entries[flowId].stats != 0)
+          {
+            m_entries[flowId].tuple = m_classifier->FindFlow (flowId);
+          }
+      }
+  }
+
+  Ptr<FlowMonitor> m_monitor;
+  Ptr<Ipv4FlowClassifier> m_classifier;
+  std::vector<Entry> m_entries;
+};
+
+} // namespace ns3
+
+#endif // FLOW_TABLE_H
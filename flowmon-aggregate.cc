@@ -0,0 +1,808 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "flow-stats-format.h"
+#include "flowmon-xml-reader.h"
+
+/**
+ * Aggregates the FlowMonitor output of many runs into one summary table.
+ *
+ * Inputs are FlowMonitor XML files or .flowstats files, or directories that
+ * are searched for them. Files are grouped into configurations by their path
+ * with the run token taken out: "nodes10/flow-monitor-file-run3.xml" and
+ * "nodes10/flow-monitor-file-run4.xml" are two runs of the configuration
+ * "nodes10/flow-monitor-file"; "run=3/", "RngRun3" and "_run3" are
+ * recognized the same way. A run written both as XML and as .flowstats
+ * ("run3.xml" and "run3.flowstats" or "run3.xml.flowstats") is one run, and
+ * only its .flowstats file is loaded. Files are loaded in parallel, --jobs at
+ * a time.
+ *
+ * For every configuration the table gives the mean over runs and the
+ * half-width of its Student t confidence interval (--confidence, 0.95 by
+ * default) for loss ratio, mean packet delay, mean jitter and throughput, plus
+ * packet delay percentiles from the delay histograms of all flows of all
+ * runs. Histograms are merged exactly, bin by bin, which requires the same
+ * bin width in every run; --histograms writes the merged histograms as CSV.
+ *
+ * Needs no ns-3, build it on its own with
+ *   g++ -O2 -o flowmon-aggregate flowmon-aggregate.cc -lpthread
+ *
+ * Usage: flowmon-aggregate [--jobs=N] [--skip-port=P] [--confidence=C]
+ *                          [--csv=FILE] [--histograms=FILE] dir-or-file...
+ */
+
+namespace {
+
+enum Metric
+{
+  LOSS_RATIO,
+  DELAY,
+  JITTER,
+  THROUGHPUT,
+  METRIC_COUNT
+};
+
+const char *g_metricNames[METRIC_COUNT] = { "lossRatio", "delayS", "jitterS", "throughputBps" };
+
+struct MergedHistogram
+{
+  double binWidth;
+  uint32_t subBucketBits;     ///< 0 for linear bins, see flow-stats-format.h
+  bool widthMismatch;
+  std::map<uint32_t, uint64_t> bins;
+};
+
+/// Everything kept of one file once it has been loaded
+struct RunResult
+{
+  std::string config;
+  std::string error;
+  uint64_t flows;
+  double metrics[METRIC_COUNT];
+  MergedHistogram histograms[FLOW_STATS_HISTOGRAM_COUNT];
+};
+
+struct ConfigResult
+{
+  uint32_t runs;
+  uint64_t flows;
+  std::vector<double> metrics[METRIC_COUNT];
+  MergedHistogram histograms[FLOW_STATS_HISTOGRAM_COUNT];
+};
+
+struct Options
+{
+  uint32_t jobs;
+  uint32_t skipPort;
+  double confidence;
+  std::string csv;
+  std::string histograms;
+};
+
+bool
+IsSeparator (char c)
+{
+  return c == '/' || c == '-' || c == '_' || c == '.';
+}
+
+/**
+ * \return path without its run token, e.g. "a/flow-run3" gives "a/flow";
+ *         the path itself if it has no run token
+ */
+std::string
+ConfigKey (const std::string &path)
+{
+  std::string lower = path;
+  for (uint32_t i = 0; i < lower.size (); ++i)
+    {
+      lower[i] = tolower (lower[i]);
+    }
+  std::string::size_type pos = 0;
+  while ((pos = lower.find ("run", pos)) != std::string::npos)
+    {
+      std::string::size_type start = pos;
+      if (start >= 3 && lower.compare (start - 3, 3, "rng") == 0)
+        {
+          start -= 3;
+        }
+      std::string::size_type end = pos + 3;
+      if (end < lower.size () && (lower[end] == '=' || lower[end] == '-' || lower[end] == '_'))
+        {
+          ++end;
+        }
+      std::string::size_type digits = end;
+      while (end < lower.size () && isdigit (lower[end]))
+        {
+          ++end;
+        }
+      bool boundedBefore = start == 0 || IsSeparator (lower[start - 1]);
+      bool boundedAfter = end == lower.size () || IsSeparator (lower[end]);
+      if (end > digits && boundedBefore && boundedAfter)
+        {
+          // drop the separator in front of the token as well, or the one
+          // after it when the token starts the path or a directory
+          if (start > 0 && lower[start - 1] != '/')
+            {
+              --start;
+            }
+          else if (end < lower.size ())
+            {
+              ++end;
+            }
+          return path.substr (0, start) + path.substr (end);
+        }
+      pos += 3;
+    }
+  return path;
+}
+
+bool
+HasSuffix (const std::string &path, const std::string &suffix)
+{
+  return path.size () > suffix.size () && path.compare (path.size () - suffix.size (), suffix.size (), suffix) == 0;
+}
+
+/// \return path without its .xml, .flowstats or .xml.flowstats extension
+std::string
+StripExtension (const std::string &path)
+{
+  const char *extensions[] = { ".xml.flowstats", ".flowstats", ".xml" };
+  for (uint32_t i = 0; i < 3; ++i)
+    {
+      if (HasSuffix (path, extensions[i]))
+        {
+          return path.substr (0, path.size () - strlen (extensions[i]));
+        }
+    }
+  return path;
+}
+
+void
+FindInputs (const std::string &path, std::vector<std::string> &files)
+{
+  struct stat st;
+  if (stat (path.c_str (), &st) != 0)
+    {
+      std::cerr << "flowmon-aggregate: cannot open " << path << "\n";
+      return;
+    }
+  if (!S_ISDIR (st.st_mode))
+    {
+      files.push_back (path);
+      return;
+    }
+  DIR *dir = opendir (path.c_str ());
+  if (dir == 0)
+    {
+      return;
+    }
+  std::vector<std::string> entries;
+  struct dirent *entry;
+  while ((entry = readdir (dir)) != 0)
+    {
+      std::string name = entry->d_name;
+      if (name != "." && name != "..")
+        {
+          entries.push_back (name);
+        }
+    }
+  closedir (dir);
+  std::sort (entries.begin (), entries.end ());
+  for (uint32_t i = 0; i < entries.size (); ++i)
+    {
+      std::string child = path + "/" + entries[i];
+      if (stat (child.c_str (), &st) != 0)
+        {
+          continue;
+        }
+      if (S_ISDIR (st.st_mode))
+        {
+          FindInputs (child, files);
+        }
+      else if (HasSuffix (child, ".xml") || HasSuffix (child, ".flowstats"))
+        {
+          files.push_back (child);
+        }
+    }
+}
+
+/// Keeps one file per run, the .flowstats file of a run that has both
+void
+SelectRuns (std::vector<std::string> &files)
+{
+  std::map<std::string, std::string> runs;
+  for (uint32_t i = 0; i < files.size (); ++i)
+    {
+      std::string run = StripExtension (files[i]);
+      std::map<std::string, std::string>::iterator it = runs.find (run);
+      if (it == runs.end ())
+        {
+          runs[run] = files[i];
+        }
+      else if (HasSuffix (files[i], ".flowstats"))
+        {
+          it->second = files[i];
+        }
+    }
+  files.clear ();
+  for (std::map<std::string, std::string>::const_iterator it = runs.begin (); it != runs.end (); ++it)
+    {
+      files.push_back (it->second);
+    }
+}
+
+void
+MergeBins (MergedHistogram &into, double binWidth, uint32_t subBucketBits,
+           const uint32_t *bins, const uint32_t *counts, uint64_t n)
+{
+  if (n == 0)
+    {
+      return;
+    }
+  if (into.bins.empty () && into.binWidth == 0)
+    {
+      into.binWidth = binWidth;
+      into.subBucketBits = subBucketBits;
+    }
+  else if (binWidth != into.binWidth || subBucketBits != into.subBucketBits)
+    {
+      into.widthMismatch = true;
+      return;
+    }
+  for (uint64_t i = 0; i < n; ++i)
+    {
+      into.bins[bins[i]] += counts[i];
+    }
+}
+
+void
+MergeHistogram (MergedHistogram &into, const MergedHistogram &from)
+{
+  if (from.widthMismatch)
+    {
+      into.widthMismatch = true;
+    }
+  if (from.bins.empty ())
+    {
+      return;
+    }
+  if (into.bins.empty () && into.binWidth == 0)
+    {
+      into.binWidth = from.binWidth;
+      into.subBucketBits = from.subBucketBits;
+    }
+  else if (from.binWidth != into.binWidth || from.subBucketBits != into.subBucketBits)
+    {
+      into.widthMismatch = true;
+      return;
+    }
+  for (std::map<uint32_t, uint64_t>::const_iterator it = from.bins.begin (); it != from.bins.end (); ++it)
+    {
+      into.bins[it->first] += it->second;
+    }
+}
+
+/// Sums over the flows of one run, skipping flows to skipPort
+class RunAccumulator
+{
+public:
+  RunAccumulator (RunResult &result, uint32_t skipPort)
+    : m_result (result),
+      m_skipPort (skipPort),
+      m_tx (0),
+      m_rx (0),
+      m_lost (0),
+      m_rxBytes (0),
+      m_jitterSamples (0),
+      m_delayNs (0),
+      m_jitterNs (0),
+      m_firstTxNs (0),
+      m_lastRxNs (0)
+  {
+    m_result.flows = 0;
+  }
+
+  /// \return false if the flow is skipped
+  bool AddFlow (const FlowStatsRecord &r)
+  {
+    if (m_skipPort != 0 && r.destinationPort == m_skipPort)
+      {
+        return false;
+      }
+    if (m_result.flows == 0 || r.timeFirstTxNs < m_firstTxNs)
+      {
+        m_firstTxNs = r.timeFirstTxNs;
+      }
+    m_lastRxNs = std::max (m_lastRxNs, r.timeLastRxNs);
+    ++m_result.flows;
+    m_tx += r.txPackets;
+    m_rx += r.rxPackets;
+    m_lost += r.lostPackets;
+    m_rxBytes += r.rxBytes;
+    m_delayNs += r.delaySumNs;
+    m_jitterNs += r.jitterSumNs;
+    m_jitterSamples += r.rxPackets > 1 ? r.rxPackets - 1 : 0;
+    return true;
+  }
+
+  void AddBins (FlowStatsHistogram histogram, double binWidth, uint32_t subBucketBits,
+                const uint32_t *bins, const uint32_t *counts, uint64_t n)
+  {
+    MergeBins (m_result.histograms[histogram], binWidth, subBucketBits, bins, counts, n);
+  }
+
+  void Finish (void)
+  {
+    double duration = (m_lastRxNs - m_firstTxNs) * 1e-9;
+    m_result.metrics[LOSS_RATIO] = m_tx > 0 ? static_cast<double> (m_lost) / m_tx : 0;
+    m_result.metrics[DELAY] = m_rx > 0 ? m_delayNs * 1e-9 / m_rx : 0;
+    m_result.metrics[JITTER] = m_jitterSamples > 0 ? m_jitterNs * 1e-9 / m_jitterSamples : 0;
+    m_result.metrics[THROUGHPUT] = duration > 0 ? m_rxBytes * 8 / duration : 0;
+  }
+
+private:
+  RunResult &m_result;
+  uint32_t m_skipPort;
+  uint64_t m_tx;
+  uint64_t m_rx;
+  uint64_t m_lost;
+  uint64_t m_rxBytes;
+  uint64_t m_jitterSamples;
+  double m_delayNs;
+  double m_jitterNs;
+  int64_t m_firstTxNs;
+  int64_t m_lastRxNs;
+};
+
+void
+LoadRun (const std::string &filename, const Options &options, RunResult &result)
+{
+  result.config = ConfigKey (StripExtension (filename));
+  for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+    {
+      result.histograms[h].binWidth = 0;
+      result.histograms[h].subBucketBits = 0;
+      result.histograms[h].widthMismatch = false;
+    }
+  RunAccumulator run (result, options.skipPort);
+  const uint32_t *bins;
+  const uint32_t *counts;
+  if (HasSuffix (filename, ".flowstats"))
+    {
+      FlowStatsReader reader;
+      if (!reader.Open (filename, result.error))
+        {
+          return;
+        }
+      for (uint64_t row = 0; row < reader.GetFlowCount (); ++row)
+        {
+          if (!run.AddFlow (reader.GetRecord (row)))
+            {
+              continue;
+            }
+          for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+            {
+              FlowStatsHistogram histogram = static_cast<FlowStatsHistogram> (h);
+              if (reader.HasHistogram (histogram))
+                {
+                  uint64_t n = reader.GetHistogram (histogram, row, bins, counts);
+                  run.AddBins (histogram, reader.GetBinWidth (histogram), reader.GetSubBucketBits (histogram), bins, counts, n);
+                }
+            }
+        }
+    }
+  else
+    {
+      FlowStatsFileWriter flows;
+      FlowMonXmlFlowLoader loader (flows, ~0u);
+      if (!FlowMonXmlReader::Parse (filename, loader, result.error))
+        {
+          return;
+        }
+      for (uint64_t row = 0; row < flows.GetFlowCount (); ++row)
+        {
+          if (!run.AddFlow (flows.GetFlow (row)))
+            {
+              continue;
+            }
+          for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+            {
+              FlowStatsHistogram histogram = static_cast<FlowStatsHistogram> (h);
+              uint64_t n = flows.GetHistogram (histogram, row, bins, counts);
+              run.AddBins (histogram, flows.GetBinWidth (histogram), flows.GetSubBucketBits (histogram), bins, counts, n);
+            }
+        }
+    }
+  run.Finish ();
+}
+
+/// Regularized incomplete beta function I_x(a, b), by continued fraction
+double
+IncompleteBeta (double a, double b, double x)
+{
+  if (x <= 0)
+    {
+      return 0;
+    }
+  if (x >= 1)
+    {
+      return 1;
+    }
+  if (x > (a + 1) / (a + b + 2))
+    {
+      return 1 - IncompleteBeta (b, a, 1 - x);
+    }
+  double front = exp (lgamma (a + b) - lgamma (a) - lgamma (b) + a * log (x) + b * log (1 - x)) / a;
+  double tiny = 1e-300;
+  double c = 1;
+  double d = 1 - (a + b) * x / (a + 1);
+  d = 1 / (fabs (d) < tiny ? tiny : d);
+  double f = d;
+  for (int m = 1; m <= 300; ++m)
+    {
+      double numerator = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+      d = 1 + numerator * d;
+      d = 1 / (fabs (d) < tiny ? tiny : d);
+      c = 1 + numerator / c;
+      c = fabs (c) < tiny ? tiny : c;
+      f *= c * d;
+      numerator = -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+      d = 1 + numerator * d;
+      d = 1 / (fabs (d) < tiny ? tiny : d);
+      c = 1 + numerator / c;
+      c = fabs (c) < tiny ? tiny : c;
+      double delta = c * d;
+      f *= delta;
+      if (fabs (delta - 1) < 1e-12)
+        {
+          break;
+        }
+    }
+  return front * f;
+}
+
+/// \return t such that a Student t variable with dof degrees of freedom is within +-t with probability confidence
+double
+StudentT (double confidence, uint32_t dof)
+{
+  double low = 0;
+  double high = 1e3;
+  for (int i = 0; i < 100; ++i)
+    {
+      double t = (low + high) / 2;
+      // P(|T| <= t) = 1 - I_{dof / (dof + t^2)} (dof / 2, 1 / 2)
+      double inside = 1 - IncompleteBeta (dof / 2.0, 0.5, dof / (dof + t * t));
+      if (inside < confidence)
+        {
+          low = t;
+        }
+      else
+        {
+          high = t;
+        }
+    }
+  return (low + high) / 2;
+}
+
+/// Mean and confidence interval half-width of values
+void
+MeanAndInterval (const std::vector<double> &values, double confidence, double &mean, double &halfWidth)
+{
+  uint32_t n = values.size ();
+  mean = 0;
+  halfWidth = 0;
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      mean += values[i];
+    }
+  mean /= n;
+  if (n < 2)
+    {
+      return;
+    }
+  double squares = 0;
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      squares += (values[i] - mean) * (values[i] - mean);
+    }
+  halfWidth = StudentT (confidence, n - 1) * sqrt (squares / (n - 1) / n);
+}
+
+/// \return the value below which quantile of the histogram lies, at bin centers
+double
+HistogramQuantile (const MergedHistogram &histogram, double quantile)
+{
+  uint64_t total = 0;
+  for (std::map<uint32_t, uint64_t>::const_iterator it = histogram.bins.begin (); it != histogram.bins.end (); ++it)
+    {
+      total += it->second;
+    }
+  uint64_t seen = 0;
+  for (std::map<uint32_t, uint64_t>::const_iterator it = histogram.bins.begin (); it != histogram.bins.end (); ++it)
+    {
+      seen += it->second;
+      if (seen >= quantile * total)
+        {
+          return FlowStatsBinStart (histogram.binWidth, histogram.subBucketBits, it->first)
+            + FlowStatsBinWidth (histogram.binWidth, histogram.subBucketBits, it->first) / 2;
+        }
+    }
+  return 0;
+}
+
+struct Work
+{
+  const Options *options;
+  const std::vector<std::string> *files;
+  std::vector<RunResult> *results;
+  uint32_t next;
+  pthread_mutex_t lock;
+};
+
+void *
+Worker (void *arg)
+{
+  Work *work = static_cast<Work *> (arg);
+  while (true)
+    {
+      pthread_mutex_lock (&work->lock);
+      uint32_t index = work->next++;
+      pthread_mutex_unlock (&work->lock);
+      if (index >= work->files->size ())
+        {
+          return 0;
+        }
+      LoadRun ((*work->files)[index], *work->options, (*work->results)[index]);
+    }
+}
+
+void
+Usage (void)
+{
+  std::cerr << "Usage: flowmon-aggregate [--jobs=N] [--skip-port=P] [--confidence=C] [--csv=FILE] [--histograms=FILE] dir-or-file...\n"
+            << "  --jobs=N           files loaded in parallel (default: one per CPU)\n"
+            << "  --skip-port=P      leave flows to destination port P out, 0 for none (default: 698)\n"
+            << "  --confidence=C     confidence level of the intervals (default: 0.95)\n"
+            << "  --csv=FILE         also write the summary table as CSV\n"
+            << "  --histograms=FILE  write the merged histograms of every configuration as CSV\n";
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  Options options;
+  options.jobs = 0;
+  options.skipPort = 698;
+  options.confidence = 0.95;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg.compare (0, 7, "--jobs=") == 0)
+        {
+          options.jobs = atoi (arg.c_str () + 7);
+        }
+      else if (arg.compare (0, 12, "--skip-port=") == 0)
+        {
+          options.skipPort = atoi (arg.c_str () + 12);
+        }
+      else if (arg.compare (0, 13, "--confidence=") == 0)
+        {
+          options.confidence = atof (arg.c_str () + 13);
+        }
+      else if (arg.compare (0, 6, "--csv=") == 0)
+        {
+          options.csv = arg.substr (6);
+        }
+      else if (arg.compare (0, 13, "--histograms=") == 0)
+        {
+          options.histograms = arg.substr (13);
+        }
+      else if (arg.compare (0, 2, "--") == 0)
+        {
+          Usage ();
+          return 2;
+        }
+      else
+        {
+          FindInputs (arg, files);
+        }
+    }
+  SelectRuns (files);
+  if (files.empty () || options.confidence <= 0 || options.confidence >= 1)
+    {
+      Usage ();
+      return 2;
+    }
+  if (options.jobs == 0)
+    {
+      long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+      options.jobs = cpus > 0 ? cpus : 1;
+    }
+  options.jobs = std::min<uint32_t> (options.jobs, files.size ());
+
+  std::vector<RunResult> results (files.size ());
+  Work work;
+  work.options = &options;
+  work.files = &files;
+  work.results = &results;
+  work.next = 0;
+  pthread_mutex_init (&work.lock, 0);
+  std::vector<pthread_t> threads (options.jobs);
+  for (uint32_t i = 0; i < options.jobs; ++i)
+    {
+      pthread_create (&threads[i], 0, &Worker, &work);
+    }
+  for (uint32_t i = 0; i < options.jobs; ++i)
+    {
+      pthread_join (threads[i], 0);
+    }
+  pthread_mutex_destroy (&work.lock);
+
+  int status = 0;
+  std::map<std::string, ConfigResult> configs;
+  for (uint32_t i = 0; i < results.size (); ++i)
+    {
+      const RunResult &run = results[i];
+      if (!run.error.empty ())
+        {
+          std::cerr << "flowmon-aggregate: " << run.error << "\n";
+          status = 1;
+          continue;
+        }
+      std::map<std::string, ConfigResult>::iterator it = configs.find (run.config);
+      if (it == configs.end ())
+        {
+          ConfigResult empty;
+          empty.runs = 0;
+          empty.flows = 0;
+          for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+            {
+              empty.histograms[h].binWidth = 0;
+              empty.histograms[h].subBucketBits = 0;
+              empty.histograms[h].widthMismatch = false;
+            }
+          it = configs.insert (std::make_pair (run.config, empty)).first;
+        }
+      ConfigResult &config = it->second;
+      ++config.runs;
+      config.flows += run.flows;
+      for (uint32_t m = 0; m < METRIC_COUNT; ++m)
+        {
+          config.metrics[m].push_back (run.metrics[m]);
+        }
+      for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+        {
+          MergeHistogram (config.histograms[h], run.histograms[h]);
+        }
+    }
+
+  FILE *csv = 0;
+  if (!options.csv.empty ())
+    {
+      csv = fopen (options.csv.c_str (), "w");
+      if (csv == 0)
+        {
+          std::cerr << "flowmon-aggregate: cannot write " << options.csv << "\n";
+          return 1;
+        }
+      fprintf (csv, "config,runs,flows");
+      for (uint32_t m = 0; m < METRIC_COUNT; ++m)
+        {
+          fprintf (csv, ",%s,%sCi", g_metricNames[m], g_metricNames[m]);
+        }
+      fprintf (csv, ",packetDelayP50S,packetDelayP99S\n");
+    }
+  printf ("%-40s %5s %8s %20s %20s %20s %22s %10s %10s\n", "configuration", "runs", "flows",
+          "loss [%]", "delay [ms]", "jitter [ms]", "throughput [Mbit/s]", "p50 [ms]", "p99 [ms]");
+  const double scale[METRIC_COUNT] = { 100, 1e3, 1e3, 1e-6 };
+  for (std::map<std::string, ConfigResult>::const_iterator it = configs.begin (); it != configs.end (); ++it)
+    {
+      const ConfigResult &config = it->second;
+      const MergedHistogram &delay = config.histograms[FLOW_STATS_DELAY_HISTOGRAM];
+      double p50 = delay.widthMismatch ? NAN : HistogramQuantile (delay, 0.5);
+      double p99 = delay.widthMismatch ? NAN : HistogramQuantile (delay, 0.99);
+      printf ("%-40s %5u %8llu", it->first.c_str (), config.runs, (unsigned long long) config.flows);
+      if (csv != 0)
+        {
+          fprintf (csv, "%s,%u,%llu", it->first.c_str (), config.runs, (unsigned long long) config.flows);
+        }
+      for (uint32_t m = 0; m < METRIC_COUNT; ++m)
+        {
+          double mean;
+          double halfWidth;
+          MeanAndInterval (config.metrics[m], options.confidence, mean, halfWidth);
+          char cell[64];
+          snprintf (cell, sizeof (cell), "%.4g +- %.2g", mean * scale[m], halfWidth * scale[m]);
+          printf (m == THROUGHPUT ? " %22s" : " %20s", cell);
+          if (csv != 0)
+            {
+              fprintf (csv, ",%.9g,%.9g", mean, halfWidth);
+            }
+        }
+      printf (" %10.4g %10.4g\n", p50 * 1e3, p99 * 1e3);
+      if (csv != 0)
+        {
+          fprintf (csv, ",%.9g,%.9g\n", p50, p99);
+        }
+      for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+        {
+          if (config.histograms[h].widthMismatch)
+            {
+              std::cerr << "flowmon-aggregate: " << it->first << ": histogram " << h
+                        << " has different bin widths across runs and was not merged\n";
+            }
+        }
+    }
+  if (csv != 0 && fclose (csv) != 0)
+    {
+      std::cerr << "flowmon-aggregate: cannot write " << options.csv << "\n";
+      status = 1;
+    }
+
+  if (!options.histograms.empty ())
+    {
+      const char *names[FLOW_STATS_HISTOGRAM_COUNT] = { "delay", "jitter", "packetSize", "flowInterruptions" };
+      FILE *file = fopen (options.histograms.c_str (), "w");
+      if (file == 0)
+        {
+          std::cerr << "flowmon-aggregate: cannot write " << options.histograms << "\n";
+          return 1;
+        }
+      fprintf (file, "config,histogram,bin,binStart,binWidth,count\n");
+      for (std::map<std::string, ConfigResult>::const_iterator it = configs.begin (); it != configs.end (); ++it)
+        {
+          for (uint32_t h = 0; h < FLOW_STATS_HISTOGRAM_COUNT; ++h)
+            {
+              const MergedHistogram &histogram = it->second.histograms[h];
+              if (histogram.widthMismatch)
+                {
+                  continue;
+                }
+              for (std::map<uint32_t, uint64_t>::const_iterator bin = histogram.bins.begin (); bin != histogram.bins.end (); ++bin)
+                {
+                  fprintf (file, "%s,%s,%u,%.9g,%.9g,%llu\n", it->first.c_str (), names[h], bin->first,
+                           FlowStatsBinStart (histogram.binWidth, histogram.subBucketBits, bin->first),
+                           FlowStatsBinWidth (histogram.binWidth, histogram.subBucketBits, bin->first),
+                           (unsigned long long) bin->second);
+                }
+            }
+        }
+      if (fclose (file) != 0)
+        {
+          std::cerr << "flowmon-aggregate: cannot write " << options.histograms << "\n";
+          status = 1;
+        }
+    }
+  return status;
+}
@@ -0,0 +1,356 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "flow-stats-format.h"
+#include "flowmon-xml-reader.h"
+
+/**
+ * Analyzes FlowMonitor XML files, the native replacement of xmlread.py.
+ *
+ * Every file is streamed once through FlowMonXmlFlowLoader, so a multi-GB file
+ * never has to fit in memory; per flow only a fixed-size record is kept. The
+ * classifier five-tuples come after the stats in the file and are joined
+ * through a table indexed by flow ID (FlowMonitor numbers its flows densely
+ * from 1). Flows to --skip-port (698, OLSR, by default, like xmlread.py) are
+ * left out of the statistics.
+ *
+ * For every file it prints the distribution of flow bitrate, lost packets and
+ * mean flow delay, plus the packet delay distribution from the merged delay
+ * histograms. --csv writes <file>.csv with one line per flow, --binary writes
+ * <file>.flowstats in the format of flow-stats-format.h. Files are analyzed
+ * in parallel, --jobs at a time (one per CPU by default).
+ *
+ * Needs no ns-3, build it on its own with
+ *   g++ -O2 -o flowmon-analyzer flowmon-analyzer.cc -lpthread
+ *
+ * Usage: flowmon-analyzer [--jobs=N] [--csv] [--binary] [--skip-port=P] file.xml...
+ */
+
+namespace {
+
+struct Options
+{
+  uint32_t jobs;
+  bool csv;
+  bool binary;
+  uint32_t skipPort;
+};
+
+/// Prints count, mean, min, percentiles and max of values, which it sorts
+void
+PrintDistribution (std::ostream &os, const char *name, std::vector<double> &values)
+{
+  char line[256];
+  if (values.empty ())
+    {
+      snprintf (line, sizeof (line), "  %-22s %10u\n", name, 0);
+      os << line;
+      return;
+    }
+  std::sort (values.begin (), values.end ());
+  double sum = 0;
+  for (uint32_t i = 0; i < values.size (); ++i)
+    {
+      sum += values[i];
+    }
+  size_t last = values.size () - 1;
+  snprintf (line, sizeof (line), "  %-22s %10lu %12.6g %12.6g %12.6g %12.6g %12.6g %12.6g\n", name,
+            (unsigned long) values.size (), sum / values.size (), values[0],
+            values[(size_t) (0.5 * last + 0.5)], values[(size_t) (0.9 * last + 0.5)],
+            values[(size_t) (0.99 * last + 0.5)], values[last]);
+  os << line;
+}
+
+/// \return the center of a bin, linear or log-linear
+double
+BinCenter (double width, uint32_t bits, uint32_t bin)
+{
+  return FlowStatsBinStart (width, bits, bin) + FlowStatsBinWidth (width, bits, bin) / 2;
+}
+
+/// Packet delay percentiles from a merged histogram, at bin centers
+void
+PrintHistogramDistribution (std::ostream &os, const char *name, const std::map<uint32_t, uint64_t> &bins,
+                            double width, uint32_t bits)
+{
+  uint64_t total = 0;
+  double sum = 0;
+  for (std::map<uint32_t, uint64_t>::const_iterator it = bins.begin (); it != bins.end (); ++it)
+    {
+      total += it->second;
+      sum += BinCenter (width, bits, it->first) * it->second;
+    }
+  char line[256];
+  if (total == 0)
+    {
+      snprintf (line, sizeof (line), "  %-22s %10u\n", name, 0);
+      os << line;
+      return;
+    }
+  const double quantiles[3] = { 0.5, 0.9, 0.99 };
+  double values[3];
+  uint32_t q = 0;
+  uint64_t seen = 0;
+  for (std::map<uint32_t, uint64_t>::const_iterator it = bins.begin (); it != bins.end () && q < 3; ++it)
+    {
+      seen += it->second;
+      while (q < 3 && seen >= quantiles[q] * total)
+        {
+          values[q++] = BinCenter (width, bits, it->first);
+        }
+    }
+  snprintf (line, sizeof (line), "  %-22s %10llu %12.6g %12.6g %12.6g %12.6g %12.6g %12.6g\n", name,
+            (unsigned long long) total, sum / total, BinCenter (width, bits, bins.begin ()->first),
+            values[0], values[1], values[2], BinCenter (width, bits, bins.rbegin ()->first));
+  os << line;
+}
+
+/// \return false with the reason in error if the file cannot be analyzed
+bool
+AnalyzeFile (const std::string &filename, const Options &options, std::string &report, std::string &error)
+{
+  FlowStatsFileWriter flows;
+  FlowMonXmlFlowLoader loader (flows, options.binary ? ~0u : 1u << FLOW_STATS_DELAY_HISTOGRAM);
+  if (!FlowMonXmlReader::Parse (filename, loader, error))
+    {
+      return false;
+    }
+
+  FILE *csv = 0;
+  std::vector<char> csvBuffer;
+  if (options.csv)
+    {
+      csv = fopen ((filename + ".csv").c_str (), "w");
+      if (csv == 0)
+        {
+          error = "cannot write " + filename + ".csv";
+          return false;
+        }
+      csvBuffer.resize (1 << 20);
+      setvbuf (csv, &csvBuffer[0], _IOFBF, csvBuffer.size ());
+      fprintf (csv, "flowId,sourceAddress,destinationAddress,protocol,sourcePort,destinationPort,"
+               "txPackets,rxPackets,lostPackets,txBytes,rxBytes,bitrateBps,lossRatio,meanDelayS,meanJitterS\n");
+    }
+
+  std::vector<double> bitrates;
+  std::vector<double> losses;
+  std::vector<double> delays;
+  std::map<uint32_t, uint64_t> delayBins;
+  uint64_t skipped = 0;
+  for (uint64_t row = 0; row < flows.GetFlowCount (); ++row)
+    {
+      const FlowStatsRecord &r = flows.GetFlow (row);
+      if (options.skipPort != 0 && r.destinationPort == options.skipPort)
+        {
+          ++skipped;
+          continue;
+        }
+      double bitrate = 0;
+      double delay = 0;
+      double jitter = 0;
+      if (r.rxPackets > 0)
+        {
+          double duration = (r.timeLastRxNs - r.timeFirstRxNs) * 1e-9;
+          bitrate = duration > 0 ? r.rxBytes * 8 / duration : 0;
+          delay = r.delaySumNs * 1e-9 / r.rxPackets;
+          delays.push_back (delay);
+        }
+      if (r.rxPackets > 1)
+        {
+          jitter = r.jitterSumNs * 1e-9 / (r.rxPackets - 1);
+        }
+      bitrates.push_back (bitrate);
+      losses.push_back (r.lostPackets);
+      const uint32_t *bins;
+      const uint32_t *counts;
+      uint64_t n = flows.GetHistogram (FLOW_STATS_DELAY_HISTOGRAM, row, bins, counts);
+      for (uint64_t i = 0; i < n; ++i)
+        {
+          delayBins[bins[i]] += counts[i];
+        }
+      if (csv != 0)
+        {
+          fprintf (csv, "%u,%s,%s,%u,%u,%u,%u,%u,%u,%llu,%llu,%.6g,%.6g,%.9g,%.9g\n",
+                   r.flowId, FlowStatsFormatAddress (r.sourceAddress).c_str (), FlowStatsFormatAddress (r.destinationAddress).c_str (),
+                   r.protocol, r.sourcePort, r.destinationPort, r.txPackets, r.rxPackets, r.lostPackets,
+                   (unsigned long long) r.txBytes, (unsigned long long) r.rxBytes, bitrate,
+                   r.txPackets > 0 ? (double) r.lostPackets / r.txPackets : 0.0, delay, jitter);
+        }
+    }
+  if (csv != 0 && (ferror (csv) || fclose (csv) != 0))
+    {
+      error = "cannot write " + filename + ".csv";
+      return false;
+    }
+  if (options.binary && !flows.Write (filename + ".flowstats", error))
+    {
+      return false;
+    }
+
+  std::ostringstream os;
+  os << filename << ": " << flows.GetFlowCount () << " flows, " << skipped << " skipped\n";
+  char header[256];
+  snprintf (header, sizeof (header), "  %-22s %10s %12s %12s %12s %12s %12s %12s\n",
+            "", "count", "mean", "min", "p50", "p90", "p99", "max");
+  os << header;
+  PrintDistribution (os, "bitrate [bit/s]", bitrates);
+  PrintDistribution (os, "lost packets", losses);
+  PrintDistribution (os, "flow mean delay [s]", delays);
+  PrintHistogramDistribution (os, "packet delay [s]", delayBins, flows.GetBinWidth (FLOW_STATS_DELAY_HISTOGRAM),
+                              flows.GetSubBucketBits (FLOW_STATS_DELAY_HISTOGRAM));
+  report = os.str ();
+  return true;
+}
+
+struct Work
+{
+  const Options *options;
+  const std::vector<std::string> *files;
+  std::vector<std::string> reports;
+  std::vector<std::string> errors;
+  uint32_t next;
+  pthread_mutex_t lock;
+};
+
+void *
+Worker (void *arg)
+{
+  Work *work = static_cast<Work *> (arg);
+  while (true)
+    {
+      pthread_mutex_lock (&work->lock);
+      uint32_t index = work->next++;
+      pthread_mutex_unlock (&work->lock);
+      if (index >= work->files->size ())
+        {
+          return 0;
+        }
+      std::string report;
+      std::string error;
+      if (!AnalyzeFile ((*work->files)[index], *work->options, report, error))
+        {
+          report.clear ();
+        }
+      // every index is written by one thread only
+      work->reports[index] = report;
+      work->errors[index] = error;
+    }
+}
+
+void
+Usage (void)
+{
+  std::cerr << "Usage: flowmon-analyzer [--jobs=N] [--csv] [--binary] [--skip-port=P] file.xml...\n"
+            << "  --jobs=N       files analyzed in parallel (default: one per CPU)\n"
+            << "  --csv          write <file>.csv with one line per flow\n"
+            << "  --binary       write <file>.flowstats (see flow-stats-format.h)\n"
+            << "  --skip-port=P  leave flows to destination port P out, 0 for none (default: 698)\n";
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  Options options;
+  options.jobs = 0;
+  options.csv = false;
+  options.binary = false;
+  options.skipPort = 698;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg.compare (0, 7, "--jobs=") == 0)
+        {
+          options.jobs = atoi (arg.c_str () + 7);
+        }
+      else if (arg == "--csv")
+        {
+          options.csv = true;
+        }
+      else if (arg == "--binary")
+        {
+          options.binary = true;
+        }
+      else if (arg.compare (0, 12, "--skip-port=") == 0)
+        {
+          options.skipPort = atoi (arg.c_str () + 12);
+        }
+      else if (arg.compare (0, 2, "--") == 0)
+        {
+          Usage ();
+          return 2;
+        }
+      else
+        {
+          files.push_back (arg);
+        }
+    }
+  if (files.empty ())
+    {
+      Usage ();
+      return 2;
+    }
+  if (options.jobs == 0)
+    {
+      long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+      options.jobs = cpus > 0 ? cpus : 1;
+    }
+  options.jobs = std::min<uint32_t> (options.jobs, files.size ());
+
+  Work work;
+  work.options = &options;
+  work.files = &files;
+  work.reports.resize (files.size ());
+  work.errors.resize (files.size ());
+  work.next = 0;
+  pthread_mutex_init (&work.lock, 0);
+  std::vector<pthread_t> threads (options.jobs);
+  for (uint32_t i = 0; i < options.jobs; ++i)
+    {
+      pthread_create (&threads[i], 0, &Worker, &work);
+    }
+  for (uint32_t i = 0; i < options.jobs; ++i)
+    {
+      pthread_join (threads[i], 0);
+    }
+  pthread_mutex_destroy (&work.lock);
+
+  int status = 0;
+  for (uint32_t i = 0; i < files.size (); ++i)
+    {
+      if (!work.errors[i].empty ())
+        {
+          std::cerr << "flowmon-analyzer: " << work.errors[i] << "\n";
+          status = 1;
+        }
+      std::cout << work.reports[i];
+    }
+  return status;
+}
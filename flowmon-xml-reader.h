@@ -0,0 +1,422 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOWMON_XML_READER_H
+#define FLOWMON_XML_READER_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdint.h>
+
+#include "flow-stats-format.h"
+
+/**
+ * Attributes of the element being reported. Names and values point into the
+ * reader buffer and are only valid during the callback.
+ */
+class FlowMonXmlAttributes
+{
+public:
+  /// \return the value of an attribute, or 0 if the element does not have it
+  const char *Get (const char *name) const
+  {
+    for (uint32_t i = 0; i < m_names.size (); ++i)
+      {
+        if (strcmp (m_names[i], name) == 0)
+          {
+            return m_values[i];
+          }
+      }
+    return 0;
+  }
+
+  uint64_t GetUnsigned (const char *name) const
+  {
+    const char *value = Get (name);
+    return value != 0 ? strtoull (value, 0, 10) : 0;
+  }
+
+  double GetDouble (const char *name) const
+  {
+    const char *value = Get (name);
+    return value != 0 ? strtod (value, 0) : 0;
+  }
+
+  /**
+   * Parses an ns-3 Time as printed by FlowMonitor, e.g. "+2015918797.0ns".
+   * \return the time in nanoseconds, 0 if the attribute is missing
+   */
+  int64_t GetTimeNs (const char *name) const
+  {
+    const char *value = Get (name);
+    if (value == 0)
+      {
+        return 0;
+      }
+    char *unit;
+    double time = strtod (value, &unit);
+    if (strcmp (unit, "ns") == 0)
+      {
+        return static_cast<int64_t> (time);
+      }
+    if (strcmp (unit, "ps") == 0)
+      {
+        return static_cast<int64_t> (time / 1e3);
+      }
+    if (strcmp (unit, "fs") == 0)
+      {
+        return static_cast<int64_t> (time / 1e6);
+      }
+    if (strcmp (unit, "us") == 0)
+      {
+        return static_cast<int64_t> (time * 1e3);
+      }
+    if (strcmp (unit, "ms") == 0)
+      {
+        return static_cast<int64_t> (time * 1e6);
+      }
+    return static_cast<int64_t> (time * 1e9);
+  }
+
+private:
+  friend class FlowMonXmlReader;
+
+  std::vector<const char *> m_names;
+  std::vector<const char *> m_values;
+};
+
+/**
+ * Streaming reader for the XML written by FlowMonitor::SerializeToXmlFile.
+ *
+ * The file is read through a fixed buffer and every start and end tag is
+ * handed to a handler as soon as it is complete, so memory does not grow with
+ * the file. Only what FlowMonitor writes is supported: elements with quoted
+ * attributes, an XML declaration, comments and whitespace; no entities or
+ * CDATA.
+ */
+class FlowMonXmlReader
+{
+public:
+  class Handler
+  {
+  public:
+    virtual ~Handler ()
+    {
+    }
+    virtual void StartElement (const char *name, const FlowMonXmlAttributes &attributes) = 0;
+    virtual void EndElement (const char *name) = 0;
+  };
+
+  /// \return false with the reason in error if the file cannot be read
+  static bool Parse (std::string filename, Handler &handler, std::string &error)
+  {
+    FILE *file = fopen (filename.c_str (), "rb");
+    if (file == 0)
+      {
+        error = "cannot open " + filename;
+        return false;
+      }
+    std::vector<char> buffer (1 << 20);
+    FlowMonXmlAttributes attributes;
+    size_t used = 0;
+    bool eof = false;
+    while (!eof || used > 0)
+      {
+        if (!eof)
+          {
+            if (used == buffer.size ())
+              {
+                // a single tag larger than the buffer
+                buffer.resize (buffer.size () * 2);
+              }
+            size_t n = fread (&buffer[used], 1, buffer.size () - used, file);
+            used += n;
+            eof = n == 0;
+          }
+        char *data = &buffer[0];
+        size_t pos = 0;
+        while (true)
+          {
+            char *open = static_cast<char *> (memchr (data + pos, '<', used - pos));
+            if (open == 0)
+              {
+                pos = used;
+                break;
+              }
+            pos = open - data;
+            char *close = static_cast<char *> (memchr (open, '>', used - pos));
+            if (close == 0)
+              {
+                break;
+              }
+            *close = '\0';
+            if (!HandleTag (open + 1, close, handler, attributes, error))
+              {
+                fclose (file);
+                error = filename + ": " + error;
+                return false;
+              }
+            pos = close + 1 - data;
+          }
+        if (eof && pos < used)
+          {
+            fclose (file);
+            error = filename + " ends inside a tag";
+            return false;
+          }
+        memmove (data, data + pos, used - pos);
+        used -= pos;
+      }
+    bool failed = ferror (file) != 0;
+    fclose (file);
+    if (failed)
+      {
+        error = "cannot read " + filename;
+        return false;
+      }
+    return true;
+  }
+
+private:
+  /// tag is the text between '<' and '>', NUL terminated at end
+  static bool HandleTag (char *tag, char *end, Handler &handler, FlowMonXmlAttributes &attributes, std::string &error)
+  {
+    if (*tag == '?' || *tag == '!')
+      {
+        return true;
+      }
+    if (*tag == '/')
+      {
+        char *name = tag + 1;
+        name[strcspn (name, " \t\r\n")] = '\0';
+        handler.EndElement (name);
+        return true;
+      }
+    bool selfClosing = end > tag && end[-1] == '/';
+    if (selfClosing)
+      {
+        end[-1] = '\0';
+      }
+    char *name = tag;
+    char *p = tag + strcspn (tag, " \t\r\n");
+    attributes.m_names.clear ();
+    attributes.m_values.clear ();
+    if (*p != '\0')
+      {
+        *p++ = '\0';
+      }
+    while (true)
+      {
+        p += strspn (p, " \t\r\n");
+        if (*p == '\0')
+          {
+            break;
+          }
+        char *attributeName = p;
+        char *equals = strchr (p, '=');
+        if (equals == 0 || equals[1] != '"')
+          {
+            error = std::string ("malformed attribute in <") + name + ">";
+            return false;
+          }
+        *equals = '\0';
+        attributeName[strcspn (attributeName, " \t\r\n")] = '\0';
+        char *value = equals + 2;
+        char *quote = strchr (value, '"');
+        if (quote == 0)
+          {
+            error = std::string ("unterminated attribute in <") + name + ">";
+            return false;
+          }
+        *quote = '\0';
+        attributes.m_names.push_back (attributeName);
+        attributes.m_values.push_back (value);
+        p = quote + 1;
+      }
+    handler.StartElement (name, attributes);
+    if (selfClosing)
+      {
+        handler.EndElement (name);
+      }
+    return true;
+  }
+};
+
+/**
+ * Handler that loads the FlowStats and Ipv4FlowClassifier sections of a
+ * FlowMonitor XML file into the rows of a FlowStatsFileWriter.
+ *
+ * One fixed-size record is kept per flow, plus the non-empty bins of the
+ * histograms asked for. The classifier comes after the stats in the file and
+ * is joined through a table indexed by flow ID, which FlowMonitor assigns
+ * densely from 1.
+ */
+class FlowMonXmlFlowLoader : public FlowMonXmlReader::Handler
+{
+public:
+  /// \param histograms bit mask of (1 << FlowStatsHistogram) to keep
+  FlowMonXmlFlowLoader (FlowStatsFileWriter &flows, uint32_t histograms)
+    : m_flows (flows),
+      m_histograms (histograms),
+      m_depth (0),
+      m_section (NONE),
+      m_histogram (-1)
+  {
+  }
+
+  virtual void StartElement (const char *name, const FlowMonXmlAttributes &attributes)
+  {
+    ++m_depth;
+    if (m_depth == 2)
+      {
+        m_section = strcmp (name, "FlowStats") == 0 ? STATS
+          : strcmp (name, "Ipv4FlowClassifier") == 0 ? CLASSIFIER : NONE;
+      }
+    else if (m_section == STATS && m_depth == 3 && strcmp (name, "Flow") == 0)
+      {
+        StartFlow (attributes);
+      }
+    else if (m_section == STATS && m_depth == 4)
+      {
+        StartFlowChild (name, attributes);
+      }
+    else if (m_section == STATS && m_depth == 5 && m_histogram >= 0 && strcmp (name, "bin") == 0)
+      {
+        FlowStatsHistogram histogram = static_cast<FlowStatsHistogram> (m_histogram);
+        if (m_flows.GetSubBucketBits (histogram) == 0)
+          {
+            m_flows.SetBinWidth (histogram, attributes.GetDouble ("width"));
+          }
+        m_flows.AddBin (histogram, attributes.GetUnsigned ("index"), attributes.GetUnsigned ("count"));
+      }
+    else if (m_section == CLASSIFIER && m_depth == 3 && strcmp (name, "Flow") == 0)
+      {
+        AddFiveTuple (attributes);
+      }
+  }
+
+  virtual void EndElement (const char *)
+  {
+    if (m_depth == 4)
+      {
+        m_histogram = -1;
+      }
+    --m_depth;
+  }
+
+private:
+  enum Section
+  {
+    NONE,
+    STATS,
+    CLASSIFIER
+  };
+
+  void StartFlow (const FlowMonXmlAttributes &a)
+  {
+    FlowStatsRecord r;
+    memset (&r, 0, sizeof (r));
+    r.flowId = a.GetUnsigned ("flowId");
+    r.timeFirstTxNs = a.GetTimeNs ("timeFirstTxPacket");
+    r.timeFirstRxNs = a.GetTimeNs ("timeFirstRxPacket");
+    r.timeLastTxNs = a.GetTimeNs ("timeLastTxPacket");
+    r.timeLastRxNs = a.GetTimeNs ("timeLastRxPacket");
+    r.delaySumNs = a.GetTimeNs ("delaySum");
+    r.jitterSumNs = a.GetTimeNs ("jitterSum");
+    r.lastDelayNs = a.GetTimeNs ("lastDelay");
+    r.txBytes = a.GetUnsigned ("txBytes");
+    r.rxBytes = a.GetUnsigned ("rxBytes");
+    r.txPackets = a.GetUnsigned ("txPackets");
+    r.rxPackets = a.GetUnsigned ("rxPackets");
+    r.lostPackets = a.GetUnsigned ("lostPackets");
+    r.timesForwarded = a.GetUnsigned ("timesForwarded");
+    if (r.flowId >= m_rowOfFlow.size ())
+      {
+        m_rowOfFlow.resize (std::max<size_t> (r.flowId + 1, m_rowOfFlow.size () * 2), 0);
+      }
+    m_rowOfFlow[r.flowId] = m_flows.GetFlowCount () + 1;
+    m_flows.AddFlow (r);
+  }
+
+  void StartFlowChild (const char *name, const FlowMonXmlAttributes &a)
+  {
+    FlowStatsRecord &r = m_flows.GetFlow (m_flows.GetFlowCount () - 1);
+    int histogram = -1;
+    if (strcmp (name, "packetsDropped") == 0)
+      {
+        r.packetsDropped += a.GetUnsigned ("number");
+      }
+    else if (strcmp (name, "bytesDropped") == 0)
+      {
+        r.bytesDropped += a.GetUnsigned ("bytes");
+      }
+    else if (strcmp (name, "delayHistogram") == 0)
+      {
+        histogram = FLOW_STATS_DELAY_HISTOGRAM;
+      }
+    else if (strcmp (name, "jitterHistogram") == 0)
+      {
+        histogram = FLOW_STATS_JITTER_HISTOGRAM;
+      }
+    else if (strcmp (name, "packetSizeHistogram") == 0)
+      {
+        histogram = FLOW_STATS_PACKET_SIZE_HISTOGRAM;
+      }
+    else if (strcmp (name, "flowInterruptionsHistogram") == 0)
+      {
+        histogram = FLOW_STATS_FLOW_INTERRUPTIONS_HISTOGRAM;
+      }
+    if (histogram >= 0 && (m_histograms & (1 << histogram)) != 0)
+      {
+        m_histogram = histogram;
+        // log-linear histograms (hdr-histogram.h) carry their unit, their bins differ in width
+        uint32_t bits = a.GetUnsigned ("subBucketBits");
+        if (bits > 0)
+          {
+            m_flows.SetSubBucketBits (static_cast<FlowStatsHistogram> (histogram), bits);
+            m_flows.SetBinWidth (static_cast<FlowStatsHistogram> (histogram), a.GetDouble ("unit"));
+          }
+      }
+  }
+
+  void AddFiveTuple (const FlowMonXmlAttributes &a)
+  {
+    uint64_t flowId = a.GetUnsigned ("flowId");
+    if (flowId >= m_rowOfFlow.size () || m_rowOfFlow[flowId] == 0)
+      {
+        return;
+      }
+    FlowStatsRecord &r = m_flows.GetFlow (m_rowOfFlow[flowId] - 1);
+    r.sourceAddress = FlowStatsParseAddress (a.Get ("sourceAddress"));
+    r.destinationAddress = FlowStatsParseAddress (a.Get ("destinationAddress"));
+    r.protocol = a.GetUnsigned ("protocol");
+    r.sourcePort = a.GetUnsigned ("sourcePort");
+    r.destinationPort = a.GetUnsigned ("destinationPort");
+  }
+
+  FlowStatsFileWriter &m_flows;
+  uint32_t m_histograms;
+  uint32_t m_depth;
+  Section m_section;
+  int m_histogram;
+  std::vector<uint64_t> m_rowOfFlow;  ///< flow ID to row + 1, 0 if unknown
+};
+
+#endif // FLOWMON_XML_READER_H
@@ -0,0 +1,211 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cmath>
+#include <stdint.h>
+
+/*
+ * Log-linear bins in the style of HdrHistogram. Values are counted in
+ * integer units; the first 2^bits bins are one unit wide, after that every
+ * power of two is split into 2^(bits-1) bins, so a bin is never wider than
+ * 2^(1-bits) of the values in it. With bits = 7 that is 1.6%, whether the
+ * delay is 50 us or 5 s, and a histogram up to 2^k units has at most
+ * 2^bits + (k - bits) * 2^(bits-1) bins.
+ *
+ * Does not depend on ns-3, so flow-stats-format.h and the analysis tools
+ * use the same bin arithmetic.
+ */
+
+/// \return the bin of a value of n units
+inline uint32_t
+LogLinearBinIndex (uint64_t n, uint32_t bits)
+{
+  uint64_t sub = static_cast<uint64_t> (1) << bits;
+  if (n < sub)
+    {
+      return n;
+    }
+  uint32_t exponent = 64 - __builtin_clzll (n) - bits;
+  uint64_t half = sub >> 1;
+  return sub + (exponent - 1) * half + ((n >> exponent) - half);
+}
+
+/// \return the first value of a bin, in units
+inline uint64_t
+LogLinearBinStart (uint32_t index, uint32_t bits)
+{
+  uint64_t sub = static_cast<uint64_t> (1) << bits;
+  if (index < sub)
+    {
+      return index;
+    }
+  uint64_t half = sub >> 1;
+  uint64_t k = index - sub;
+  return (k % half + half) << (k / half + 1);
+}
+
+/// \return the width of a bin, in units
+inline uint64_t
+LogLinearBinWidth (uint32_t index, uint32_t bits)
+{
+  uint64_t sub = static_cast<uint64_t> (1) << bits;
+  if (index < sub)
+    {
+      return 1;
+    }
+  return static_cast<uint64_t> (1) << ((index - sub) / (sub >> 1) + 1);
+}
+
+/// A histogram of non-negative values with log-linear bins
+class LogLinearHistogram
+{
+public:
+  /**
+   * \param unit width of the narrowest bins, e.g. 1e-6 for delays in seconds
+   * \param bits log2 of the number of bins per power of two, see BitsForPrecision ()
+   */
+  LogLinearHistogram (double unit = 1e-6, uint32_t bits = 7)
+    : m_unit (unit),
+      m_bits (bits),
+      m_total (0)
+  {
+  }
+
+  /// \return the fewest bits whose bins are at most relativePrecision wide
+  static uint32_t BitsForPrecision (double relativePrecision)
+  {
+    uint32_t bits = 1;
+    while (bits < 20 && std::ldexp (1.0, 1 - static_cast<int> (bits)) > relativePrecision)
+      {
+        ++bits;
+      }
+    return bits;
+  }
+
+  /// Counts value; negative values count as 0
+  void AddValue (double value)
+  {
+    double units = value > 0 ? value / m_unit : 0;
+    uint64_t n = units < 9.2e18 ? static_cast<uint64_t> (units) : static_cast<uint64_t> (9.2e18);
+    uint32_t index = LogLinearBinIndex (n, m_bits);
+    if (index >= m_counts.size ())
+      {
+        m_counts.resize (index + 1, 0);
+      }
+    ++m_counts[index];
+    ++m_total;
+  }
+
+  /// Adds the counts of other, which must have the same unit and bits
+  void Merge (const LogLinearHistogram &other)
+  {
+    if (other.m_counts.size () > m_counts.size ())
+      {
+        m_counts.resize (other.m_counts.size (), 0);
+      }
+    for (uint32_t i = 0; i < other.m_counts.size (); ++i)
+      {
+        m_counts[i] += other.m_counts[i];
+      }
+    m_total += other.m_total;
+  }
+
+  double GetUnit (void) const
+  {
+    return m_unit;
+  }
+
+  uint32_t GetBits (void) const
+  {
+    return m_bits;
+  }
+
+  /// \return one past the highest bin counted so far
+  uint32_t GetNBins (void) const
+  {
+    return m_counts.size ();
+  }
+
+  uint32_t GetBinCount (uint32_t index) const
+  {
+    return m_counts[index];
+  }
+
+  double GetBinStart (uint32_t index) const
+  {
+    return LogLinearBinStart (index, m_bits) * m_unit;
+  }
+
+  double GetBinWidth (uint32_t index) const
+  {
+    return LogLinearBinWidth (index, m_bits) * m_unit;
+  }
+
+  uint64_t GetCount (void) const
+  {
+    return m_total;
+  }
+
+  /// \return the center of the bin the quantile falls into
+  double GetQuantile (double quantile) const
+  {
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < m_counts.size (); ++i)
+      {
+        seen += m_counts[i];
+        if (seen > 0 && seen >= quantile * m_total)
+          {
+            return GetBinStart (i) + GetBinWidth (i) / 2;
+          }
+      }
+    return 0;
+  }
+
+  /**
+   * Writes the non-empty bins in the layout of ns3::Histogram, so existing
+   * readers of start, width and count keep working, plus the unit and bits
+   * needed to recompute the bins:
+   *   <name nBins="N" unit="U" subBucketBits="B"><bin index= start= width= count=/>...</name>
+   */
+  void SerializeToXmlStream (std::ostream &os, uint16_t indent, std::string name) const
+  {
+    os << std::string (indent, ' ') << "<" << name << " nBins=\"" << m_counts.size () << "\" unit=\"" << m_unit
+       << "\" subBucketBits=\"" << m_bits << "\">\n";
+    for (uint32_t i = 0; i < m_counts.size (); ++i)
+      {
+        if (m_counts[i] > 0)
+          {
+            os << std::string (indent + 2, ' ') << "<bin index=\"" << i << "\" start=\"" << GetBinStart (i)
+               << "\" width=\"" << GetBinWidth (i) << "\" count=\"" << m_counts[i] << "\" />\n";
+          }
+      }
+    os << std::string (indent, ' ') << "</" << name << ">\n";
+  }
+
+private:
+  double m_unit;
+  uint32_t m_bits;
+  std::vector<uint32_t> m_counts;
+  uint64_t m_total;
+};
+
+#endif // HDR_HISTOGRAM_H
@@ -0,0 +1,211 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef INSTRUMENTED_SIMULATOR_IMPL_H
+#define INSTRUMENTED_SIMULATOR_IMPL_H
+
+#include <iostream>
+
+#include "ns3/core-module.h"
+#include "ns3/default-simulator-impl.h"
+
+#include "event-profiler.h"
+
+namespace ns3 {
+
+/**
+ * The default simulator, counting the events it schedules and executes and
+ * those still pending, which the public Simulator API does not tell.
+ *
+ * Every scheduled event is wrapped in a CountedEvent; cancelling it cancels
+ * the wrapper, so only events that really run are counted as executed. A
+ * cancelled or removed event is no longer pending once its wrapper is freed,
+ * when the scheduler has dropped it and no EventId refers to it any more.
+ * The counters are not atomic, events scheduled from other threads may be
+ * miscounted. With SetProfiler () every event is also timed and charged to
+ * its type by an EventProfiler; the allocations it counts include the
+ * wrapper of every event scheduled.
+ *
+ * With the PrintSummary attribute every Simulator::Run () ends with a line
+ *   Simulator: events=<n> runSeconds=<s> eventsPerSecond=<x>
+ * for the events executed and the wall-clock time of that run.
+ *
+ * Select it with Enable () before the first use of the Simulator, or with
+ * --SimulatorImplementationType=ns3::InstrumentedSimulatorImpl; scripts
+ * without a CommandLine take NS_GLOBAL_VALUE and NS_ATTRIBUTE_DEFAULT:
+ *   NS_GLOBAL_VALUE="SimulatorImplementationType=ns3::InstrumentedSimulatorImpl"
+ *   NS_ATTRIBUTE_DEFAULT="ns3::InstrumentedSimulatorImpl::PrintSummary=true"
+ */
+class InstrumentedSimulatorImpl : public DefaultSimulatorImpl
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::InstrumentedSimulatorImpl")
+      .SetParent<DefaultSimulatorImpl> ()
+      .AddConstructor<InstrumentedSimulatorImpl> ()
+      .AddAttribute ("PrintSummary",
+                     "Print the events and wall-clock time of every Simulator::Run ()",
+                     BooleanValue (false),
+                     MakeBooleanAccessor (&InstrumentedSimulatorImpl::m_printSummary),
+                     MakeBooleanChecker ())
+    ;
+    return tid;
+  }
+
+  InstrumentedSimulatorImpl ()
+    : m_scheduled (0),
+      m_executed (0),
+      m_discarded (0),
+      m_profiler (0),
+      m_printSummary (false)
+  {
+  }
+
+  /// Makes the Simulator use this implementation
+  static void Enable (void)
+  {
+    GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::InstrumentedSimulatorImpl"));
+  }
+
+  /// \return the implementation the Simulator uses, 0 if it is not this one
+  static Ptr<InstrumentedSimulatorImpl> Get (void)
+  {
+    return DynamicCast<InstrumentedSimulatorImpl> (Simulator::GetImplementation ());
+  }
+
+  /// Runs the events through profiler, which has to outlive the runs; 0 stops profiling
+  void SetProfiler (EventProfiler *profiler)
+  {
+    m_profiler = profiler;
+  }
+
+  virtual void Run (void)
+  {
+    if (m_profiler != 0)
+      {
+        m_profiler->RunStarted ();
+      }
+    uint64_t executed = m_executed;
+    SystemWallClockMs wall;
+    wall.Start ();
+    DefaultSimulatorImpl::Run ();
+    int64_t wallMs = wall.End ();
+    if (m_profiler != 0)
+      {
+        m_profiler->RunFinished ();
+      }
+    if (m_printSummary)
+      {
+        std::cout << "Simulator: events=" << m_executed - executed << " runSeconds=" << wallMs / 1000.0
+                  << " eventsPerSecond=" << (wallMs > 0 ? (m_executed - executed) * 1000.0 / wallMs : 0) << std::endl;
+      }
+  }
+
+  virtual EventId Schedule (Time const &delay, EventImpl *event)
+  {
+    ++m_scheduled;
+    return DefaultSimulatorImpl::Schedule (delay, Wrap (event));
+  }
+
+  virtual void ScheduleWithContext (uint32_t context, Time const &delay, EventImpl *event)
+  {
+    ++m_scheduled;
+    DefaultSimulatorImpl::ScheduleWithContext (context, delay, Wrap (event));
+  }
+
+  virtual EventId ScheduleNow (EventImpl *event)
+  {
+    ++m_scheduled;
+    return DefaultSimulatorImpl::ScheduleNow (Wrap (event));
+  }
+
+  uint64_t GetScheduledEvents (void) const
+  {
+    return m_scheduled;
+  }
+
+  uint64_t GetExecutedEvents (void) const
+  {
+    return m_executed;
+  }
+
+  /// \return the events scheduled that have neither run nor been freed without running
+  uint64_t GetPendingEvents (void) const
+  {
+    return m_scheduled - m_executed - m_discarded;
+  }
+
+private:
+  /// Runs the event it wraps and counts it, or counts it as discarded when freed unrun
+  class CountedEvent : public EventImpl
+  {
+  public:
+    CountedEvent (EventImpl *event, InstrumentedSimulatorImpl *simulator)
+      : m_event (event, false),
+        m_simulator (simulator),
+        m_ran (false)
+    {
+    }
+
+    virtual ~CountedEvent ()
+    {
+      if (!m_ran)
+        {
+          ++m_simulator->m_discarded;
+        }
+    }
+
+  protected:
+    virtual void Notify (void)
+    {
+      m_ran = true;
+      ++m_simulator->m_executed;
+      if (m_simulator->m_profiler != 0)
+        {
+          m_simulator->m_profiler->Invoke (PeekPointer (m_event));
+        }
+      else
+        {
+          m_event->Invoke ();
+        }
+    }
+
+  private:
+    Ptr<EventImpl> m_event;
+    // an EventId may outlive Simulator::Destroy (), and with it the wrapper
+    Ptr<InstrumentedSimulatorImpl> m_simulator;
+    bool m_ran;
+  };
+
+  /// Takes over the reference of event the caller passed in
+  EventImpl *Wrap (EventImpl *event)
+  {
+    return new CountedEvent (event, this);
+  }
+
+  uint64_t m_scheduled;
+  uint64_t m_executed;
+  uint64_t m_discarded;         ///< events freed without having run
+  EventProfiler *m_profiler;
+  bool m_printSummary;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (InstrumentedSimulatorImpl);
+
+} // namespace ns3
+
+#endif // INSTRUMENTED_SIMULATOR_IMPL_H
@@ -0,0 +1,292 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LIVE_METRICS_H
+#define LIVE_METRICS_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <sstream>
+#include <cmath>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include "hdr-histogram.h"
+#include "instrumented-simulator-impl.h"
+#include "metrics-server.h"
+
+namespace ns3 {
+
+/**
+ * Exposes the progress of a running simulation as Prometheus metrics, so a
+ * long run can be watched, or scraped, while it goes on:
+ *
+ *   ns3_simulated_seconds                        simulated time
+ *   ns3_events_executed_total                    with InstrumentedSimulatorImpl only
+ *   ns3_events_per_second                        since the last update
+ *   ns3_events_pending
+ *   lte_packets_sent_total{class="dl"}           UDP packets of a flow class
+ *   lte_packets_received_total{class="dl"}
+ *   lte_sink_delay_seconds{quantile="0.99"}      one-way delay at the sinks
+ *
+ * As in the summaries of the Prometheus client libraries, the delay
+ * quantiles are those of the packets received since the metrics were last
+ * handed to the server, NaN if there were none, while _sum and _count go
+ * back to the start of the run.
+ *
+ * The metrics are updated by an event every interval of simulated time,
+ * but formatted and handed to the MetricsServer at most once per second of
+ * wall-clock time; the server thread answers the requests, so a scrape never
+ * stops the simulation.
+ */
+class LiveMetrics
+{
+public:
+  LiveMetrics (std::string address, Time interval)
+    : m_address (address),
+      m_interval (interval),
+      m_lastWallMs (0),
+      m_lastExecuted (0),
+      m_delays (1e-6, LogLinearHistogram::BitsForPrecision (0.01)),
+      m_delaySum (0),
+      m_delayCount (0),
+      m_started (false)
+  {
+    m_registry.Declare ("ns3_simulated_seconds", "gauge", "Simulated time");
+    m_registry.Declare ("ns3_events_executed_total", "counter", "Events executed by the simulator");
+    m_registry.Declare ("ns3_events_per_second", "gauge", "Events executed per wall-clock second since the last update");
+    m_registry.Declare ("ns3_events_pending", "gauge", "Events scheduled but not executed yet");
+    m_registry.Declare ("lte_packets_sent_total", "counter", "UDP packets sent, by flow class");
+    m_registry.Declare ("lte_packets_received_total", "counter", "UDP packets received, by flow class");
+    m_registry.Declare ("lte_sink_delay_seconds", "summary", "One-way delay of the packets received by the sinks");
+  }
+
+  ~LiveMetrics ()
+  {
+    for (uint32_t i = 0; i < m_hooks.size (); ++i)
+      {
+        delete m_hooks[i];
+      }
+  }
+
+  /**
+   * Counts the UDP packets the senders send to the receivers, and those the
+   * receivers get from the senders, as class name. Call once the addresses
+   * are assigned.
+   */
+  void AddFlowClass (std::string name, NodeContainer senders, NodeContainer receivers)
+  {
+    FlowClass flowClass;
+    flowClass.labels = "class=\"" + name + "\"";
+    flowClass.sent = 0;
+    flowClass.received = 0;
+    m_classes.push_back (flowClass);
+    Hook *sent = new Hook;
+    sent->metrics = this;
+    sent->flowClass = m_classes.size () - 1;
+    sent->peers = GetAddresses (receivers);
+    Hook *received = new Hook;
+    received->metrics = this;
+    received->flowClass = m_classes.size () - 1;
+    received->peers = GetAddresses (senders);
+    m_hooks.push_back (sent);
+    m_hooks.push_back (received);
+    for (NodeContainer::Iterator it = senders.Begin (); it != senders.End (); ++it)
+      {
+        Ptr<Ipv4L3Protocol> ipv4 = (*it)->GetObject<Ipv4L3Protocol> ();
+        if (ipv4 != 0)
+          {
+            ipv4->TraceConnectWithoutContext ("SendOutgoing", MakeBoundCallback (&LiveMetrics::Sent, sent));
+          }
+      }
+    for (NodeContainer::Iterator it = receivers.Begin (); it != receivers.End (); ++it)
+      {
+        Ptr<Ipv4L3Protocol> ipv4 = (*it)->GetObject<Ipv4L3Protocol> ();
+        if (ipv4 != 0)
+          {
+            ipv4->TraceConnectWithoutContext ("LocalDeliver", MakeBoundCallback (&LiveMetrics::Received, received));
+          }
+      }
+  }
+
+  /// Connect to the PacketSink Rx trace of sinks receiving SeqTsHeader payloads
+  void SinkRx (Ptr<const Packet> packet, const Address &from)
+  {
+    SeqTsHeader seqTs;
+    if (packet->GetSize () < seqTs.GetSerializedSize ())
+      {
+        return;
+      }
+    packet->PeekHeader (seqTs);
+    double delay = (Simulator::Now () - seqTs.GetTs ()).GetSeconds ();
+    m_delays.AddValue (delay);
+    m_delaySum += delay;
+    ++m_delayCount;
+  }
+
+  /// Starts the server and the updates; call right before Simulator::Run ()
+  void Start (void)
+  {
+    std::string error;
+    if (!m_server.Start (m_address, error))
+      {
+        NS_FATAL_ERROR ("Cannot serve metrics: " << error);
+      }
+    m_started = true;
+    m_wall.Start ();
+    Publish ();
+    m_event = Simulator::Schedule (m_interval, &LiveMetrics::Update, this);
+  }
+
+  /// Publishes the final values and stops the server; call after Simulator::Run ()
+  void Finish (void)
+  {
+    if (!m_started)
+      {
+        return;
+      }
+    m_started = false;
+    m_event.Cancel ();
+    Publish ();
+    m_server.Stop ();
+  }
+
+private:
+  struct FlowClass
+  {
+    std::string labels;
+    uint64_t sent;
+    uint64_t received;
+  };
+
+  /// Flow class a bound Ipv4L3Protocol trace counts for, and the addresses at the other end
+  struct Hook
+  {
+    LiveMetrics *metrics;
+    uint32_t flowClass;
+    std::set<Ipv4Address> peers;
+  };
+
+  static std::set<Ipv4Address> GetAddresses (NodeContainer nodes)
+  {
+    std::set<Ipv4Address> addresses;
+    for (NodeContainer::Iterator it = nodes.Begin (); it != nodes.End (); ++it)
+      {
+        Ptr<Ipv4> ipv4 = (*it)->GetObject<Ipv4> ();
+        if (ipv4 == 0)
+          {
+            continue;
+          }
+        for (uint32_t i = 0; i < ipv4->GetNInterfaces (); ++i)
+          {
+            for (uint32_t j = 0; j < ipv4->GetNAddresses (i); ++j)
+              {
+                Ipv4Address address = ipv4->GetAddress (i, j).GetLocal ();
+                if (!address.IsLocalhost ())
+                  {
+                    addresses.insert (address);
+                  }
+              }
+          }
+      }
+    return addresses;
+  }
+
+  static void Sent (Hook *hook, const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    if (header.GetProtocol () == UdpL4Protocol::PROT_NUMBER && hook->peers.count (header.GetDestination ()) > 0)
+      {
+        ++hook->metrics->m_classes[hook->flowClass].sent;
+      }
+  }
+
+  static void Received (Hook *hook, const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    if (header.GetProtocol () == UdpL4Protocol::PROT_NUMBER && hook->peers.count (header.GetSource ()) > 0)
+      {
+        ++hook->metrics->m_classes[hook->flowClass].received;
+      }
+  }
+
+  void Update (void)
+  {
+    if (m_wall.End () - m_lastWallMs >= 1000)
+      {
+        Publish ();
+      }
+    m_event = Simulator::Schedule (m_interval, &LiveMetrics::Update, this);
+  }
+
+  void Publish (void)
+  {
+    int64_t wallMs = m_wall.End ();
+    m_registry.Set ("ns3_simulated_seconds", "", Simulator::Now ().GetSeconds ());
+    Ptr<InstrumentedSimulatorImpl> simulator = InstrumentedSimulatorImpl::Get ();
+    if (simulator != 0)
+      {
+        uint64_t executed = simulator->GetExecutedEvents ();
+        m_registry.Set ("ns3_events_executed_total", "", executed);
+        if (wallMs > m_lastWallMs)
+          {
+            m_registry.Set ("ns3_events_per_second", "", (executed - m_lastExecuted) * 1000.0 / (wallMs - m_lastWallMs));
+          }
+        m_registry.Set ("ns3_events_pending", "", simulator->GetPendingEvents ());
+        m_lastExecuted = executed;
+      }
+    for (uint32_t i = 0; i < m_classes.size (); ++i)
+      {
+        m_registry.Set ("lte_packets_sent_total", m_classes[i].labels, m_classes[i].sent);
+        m_registry.Set ("lte_packets_received_total", m_classes[i].labels, m_classes[i].received);
+      }
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    for (uint32_t i = 0; i < sizeof (quantiles) / sizeof (quantiles[0]); ++i)
+      {
+        std::ostringstream labels;
+        labels << "quantile=\"" << quantiles[i] << "\"";
+        m_registry.Set ("lte_sink_delay_seconds", labels.str (),
+                        m_delays.GetCount () > 0 ? m_delays.GetQuantile (quantiles[i]) : NAN);
+      }
+    m_registry.Set ("lte_sink_delay_seconds", "_sum", m_delaySum);
+    m_registry.Set ("lte_sink_delay_seconds", "_count", m_delayCount);
+    // the next quantiles are those of the packets received until then
+    m_delays = LogLinearHistogram (m_delays.GetUnit (), m_delays.GetBits ());
+    m_server.Publish (m_registry.Format ());
+    m_lastWallMs = wallMs;
+  }
+
+  std::string m_address;
+  Time m_interval;
+  MetricsRegistry m_registry;
+  MetricsServer m_server;
+  SystemWallClockMs m_wall;
+  int64_t m_lastWallMs;         ///< of the last Publish ()
+  uint64_t m_lastExecuted;      ///< events executed at the last Publish ()
+  std::vector<FlowClass> m_classes;
+  std::vector<Hook *> m_hooks;
+  LogLinearHistogram m_delays;   ///< since the last Publish ()
+  double m_delaySum;
+  uint64_t m_delayCount;
+  bool m_started;
+  EventId m_event;
+};
+
+} // namespace ns3
+
+#endif // LIVE_METRICS_H
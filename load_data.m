@@ -1,3 +1,7 @@
+% Plots the delays of one small run. For large runs use delay-log-analyzer,
+% which streams text or binary (--delayLog) delay logs and writes the
+% histogram and CDF as CSV:
+%   ./delay-log-analyzer --output=delays output-delays.txt
 
 clear all
 
@@ -0,0 +1,259 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LTE_BINARY_TRACES_H
+#define LTE_BINARY_TRACES_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <sstream>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/lte-module.h"
+
+#include "lte-stats-format.h"
+#include "async-stats-writer.h"
+
+namespace ns3 {
+
+/**
+ * Records the MAC, RLC and PDCP stats of LteHelper::EnableTraces () as
+ * binary records written by an AsyncStatsWriter, one
+ * <prefix><DlMacStats|UlMacStats|...>.bin per stat; lte-stats-convert turns
+ * them into the text files afterwards.
+ *
+ * The stat calculators of EnableTraces () format a text line per MAC
+ * scheduling decision and look the IMSI up by trace path, all on the
+ * simulation thread. Here every trace is connected to its device without
+ * context, the IMSI comes from the eNB RRC, and the record is only copied
+ * into a buffer; formatting and file I/O happen in the converter and on
+ * the writer's I/O thread. RLC and PDCP traces are connected per UE once
+ * its RRC connection is reconfigured, as RadioBearerStatsConnector does.
+ *
+ * Call Enable () after the eNB and UE devices are installed.
+ */
+class LteBinaryTraces
+{
+public:
+  LteBinaryTraces (std::string prefix)
+    : m_prefix (prefix)
+  {
+    for (uint32_t kind = 0; kind < LTE_STATS_KINDS; ++kind)
+      {
+        m_files[kind] = -1;
+      }
+  }
+
+  ~LteBinaryTraces ()
+  {
+    for (uint32_t i = 0; i < m_contexts.size (); ++i)
+      {
+        delete m_contexts[i];
+      }
+  }
+
+  void Enable (void)
+  {
+    for (uint32_t kind = 0; kind < LTE_STATS_KINDS; ++kind)
+      {
+        std::string error;
+        m_files[kind] = m_writer.Open (m_prefix + LteStatsName (kind) + ".bin", LteStatsKind (kind), error);
+        if (m_files[kind] < 0)
+          {
+            NS_FATAL_ERROR ("Cannot write LTE stats: " << error);
+          }
+      }
+    for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); ++node)
+      {
+        for (uint32_t i = 0; i < (*node)->GetNDevices (); ++i)
+          {
+            Ptr<NetDevice> device = (*node)->GetDevice (i);
+            std::ostringstream path;
+            path << "/NodeList/" << (*node)->GetId () << "/DeviceList/" << i;
+            Ptr<LteEnbNetDevice> enb = DynamicCast<LteEnbNetDevice> (device);
+            if (enb != 0)
+              {
+                Context *context = NewContext (path.str ());
+                context->enb = enb;
+                enb->GetMac ()->TraceConnectWithoutContext ("DlScheduling", MakeBoundCallback (&DlScheduling, context));
+                enb->GetMac ()->TraceConnectWithoutContext ("UlScheduling", MakeBoundCallback (&UlScheduling, context));
+                enb->GetRrc ()->TraceConnectWithoutContext ("ConnectionReconfiguration",
+                                                            MakeBoundCallback (&EnbReconfigured, context));
+                enb->GetRrc ()->TraceConnectWithoutContext ("HandoverEndOk", MakeBoundCallback (&EnbReconfigured, context));
+              }
+            Ptr<LteUeNetDevice> ue = DynamicCast<LteUeNetDevice> (device);
+            if (ue != 0)
+              {
+                Context *context = NewContext (path.str ());
+                ue->GetRrc ()->TraceConnectWithoutContext ("ConnectionReconfiguration",
+                                                           MakeBoundCallback (&UeReconfigured, context));
+                ue->GetRrc ()->TraceConnectWithoutContext ("HandoverEndOk", MakeBoundCallback (&UeReconfigured, context));
+              }
+          }
+      }
+  }
+
+  /// Writes the buffered records and closes the files
+  void Close (void)
+  {
+    std::string error;
+    if (!m_writer.Close (error))
+      {
+        NS_FATAL_ERROR ("Cannot write LTE stats: " << error);
+      }
+  }
+
+private:
+  /// What a bound trace callback needs to fill a record
+  struct Context
+  {
+    LteBinaryTraces *traces;
+    std::string path;           ///< /NodeList/<n>/DeviceList/<d> of the device
+    Ptr<LteEnbNetDevice> enb;
+    uint64_t imsi;
+    uint16_t cellId;
+    uint32_t file;              ///< LteStatsKind of a bearer trace
+  };
+
+  Context *NewContext (std::string path)
+  {
+    Context *context = new Context;
+    context->traces = this;
+    context->path = path;
+    context->imsi = 0;
+    context->cellId = 0;
+    context->file = 0;
+    m_contexts.push_back (context);
+    return context;
+  }
+
+  static LteStatsRecord NewRecord (uint16_t cellId, uint64_t imsi, uint16_t rnti)
+  {
+    LteStatsRecord record;
+    memset (&record, 0, sizeof (record));
+    record.timeNs = Simulator::Now ().GetNanoSeconds ();
+    record.cellId = cellId;
+    record.imsi = imsi;
+    record.rnti = rnti;
+    return record;
+  }
+
+  static uint64_t FindImsi (Ptr<LteEnbNetDevice> enb, uint16_t rnti)
+  {
+    Ptr<LteEnbRrc> rrc = enb->GetRrc ();
+    return rrc->HasUeManager (rnti) ? rrc->GetUeManager (rnti)->GetImsi () : 0;
+  }
+
+  static void DlScheduling (Context *context, uint32_t frame, uint32_t subframe, uint16_t rnti,
+                            uint8_t mcs1, uint16_t size1, uint8_t mcs2, uint16_t size2)
+  {
+    LteStatsRecord record = NewRecord (context->enb->GetCellId (), FindImsi (context->enb, rnti), rnti);
+    record.frame = frame;
+    record.subframe = subframe;
+    record.mcs = mcs1;
+    record.size = size1;
+    record.mcs2 = mcs2;
+    record.size2 = size2;
+    context->traces->m_writer.Add (context->traces->m_files[LTE_STATS_DL_MAC], record);
+  }
+
+  static void UlScheduling (Context *context, uint32_t frame, uint32_t subframe, uint16_t rnti,
+                            uint8_t mcs, uint16_t size)
+  {
+    LteStatsRecord record = NewRecord (context->enb->GetCellId (), FindImsi (context->enb, rnti), rnti);
+    record.frame = frame;
+    record.subframe = subframe;
+    record.mcs = mcs;
+    record.size = size;
+    context->traces->m_writer.Add (context->traces->m_files[LTE_STATS_UL_MAC], record);
+  }
+
+  static void EnbReconfigured (Context *context, uint64_t imsi, uint16_t cellId, uint16_t rnti)
+  {
+    std::ostringstream path;
+    path << context->path << "/LteEnbRrc/UeMap/" << rnti << "/DataRadioBearerMap/*/";
+    context->traces->ConnectBearers (path.str (), imsi, cellId, LTE_STATS_TX);
+  }
+
+  static void UeReconfigured (Context *context, uint64_t imsi, uint16_t cellId, uint16_t rnti)
+  {
+    std::string path = context->path + "/LteUeRrc/DataRadioBearerMap/*/";
+    context->traces->ConnectBearers (path, imsi, cellId, LTE_STATS_RX);
+  }
+
+  /**
+   * Connects the RLC and PDCP traces under path once per path and cell; dl
+   * is the side of the downlink there, TX at the eNB and RX at the UE
+   */
+  void ConnectBearers (std::string path, uint64_t imsi, uint16_t cellId, LteStatsEvent dl)
+  {
+    std::ostringstream key;
+    key << path << " " << cellId;
+    if (!m_connected.insert (key.str ()).second)
+      {
+        return;
+      }
+    const char *layers[2] = { "LteRlc", "LtePdcp" };
+    LteStatsKind dlKinds[2] = { LTE_STATS_DL_RLC, LTE_STATS_DL_PDCP };
+    LteStatsKind ulKinds[2] = { LTE_STATS_UL_RLC, LTE_STATS_UL_PDCP };
+    for (uint32_t layer = 0; layer < 2; ++layer)
+      {
+        Context *dlContext = NewContext (path);
+        dlContext->imsi = imsi;
+        dlContext->cellId = cellId;
+        dlContext->file = dlKinds[layer];
+        Context *ulContext = NewContext (path);
+        ulContext->imsi = imsi;
+        ulContext->cellId = cellId;
+        ulContext->file = ulKinds[layer];
+        Context *tx = dl == LTE_STATS_TX ? dlContext : ulContext;
+        Context *rx = dl == LTE_STATS_RX ? dlContext : ulContext;
+        Config::ConnectWithoutContext (path + layers[layer] + "/TxPDU", MakeBoundCallback (&TxPdu, tx));
+        Config::ConnectWithoutContext (path + layers[layer] + "/RxPDU", MakeBoundCallback (&RxPdu, rx));
+      }
+  }
+
+  static void TxPdu (Context *context, uint16_t rnti, uint8_t lcid, uint32_t size)
+  {
+    LteStatsRecord record = NewRecord (context->cellId, context->imsi, rnti);
+    record.event = LTE_STATS_TX;
+    record.lcid = lcid;
+    record.size = size;
+    context->traces->m_writer.Add (context->traces->m_files[context->file], record);
+  }
+
+  static void RxPdu (Context *context, uint16_t rnti, uint8_t lcid, uint32_t size, uint64_t delay)
+  {
+    LteStatsRecord record = NewRecord (context->cellId, context->imsi, rnti);
+    record.event = LTE_STATS_RX;
+    record.lcid = lcid;
+    record.size = size;
+    record.delayNs = delay;
+    context->traces->m_writer.Add (context->traces->m_files[context->file], record);
+  }
+
+  std::string m_prefix;
+  AsyncStatsWriter m_writer;
+  int m_files[LTE_STATS_KINDS];
+  std::vector<Context *> m_contexts;
+  std::set<std::string> m_connected;
+};
+
+} // namespace ns3
+
+#endif // LTE_BINARY_TRACES_H
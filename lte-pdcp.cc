@@ -63,6 +63,18 @@ LtePdcpSpecificLteRlcSapUser::ReceivePdcpPdu (Ptr<Packet> p)
 
 NS_OBJECT_ENSURE_REGISTERED (LtePdcp);
 
+/****/
+Callback<void> LtePdcp::m_receiveBegin;
+Callback<void> LtePdcp::m_receiveEnd;
+
+void
+LtePdcp::SetReceiveHooks (Callback<void> begin, Callback<void> end)
+{
+  m_receiveBegin = begin;
+  m_receiveEnd = end;
+}
+/****/
+
 LtePdcp::LtePdcp ()
   : /****/pdcp_delay(0),/****/
     m_pdcpSapUser (0),
@@ -215,6 +227,12 @@ void
 LtePdcp::DoReceivePdu (Ptr<Packet> p)
 {
   NS_LOG_FUNCTION (this << m_rnti << (uint32_t) m_lcid << p->GetSize ());
+  /****/
+  if (!m_receiveBegin.IsNull ())
+    {
+      m_receiveBegin ();
+    }
+  /****/
 
   // Receiver timestamp
   PdcpTag pdcpTag;
@@ -241,6 +259,12 @@ LtePdcp::DoReceivePdu (Ptr<Packet> p)
   params.pdcpSdu = p;
   params.rnti = m_rnti;
   params.lcid = m_lcid;
+  /****/
+  if (!m_receiveEnd.IsNull ())
+    {
+      m_receiveEnd ();
+    }
+  /****/
   m_pdcpSapUser->ReceivePdcpSdu (params);
 }
 
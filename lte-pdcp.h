@@ -47,6 +47,15 @@ public:
   static TypeId GetTypeId (void);
   virtual void DoDispose ();
 
+  /****/
+  /**
+   * Calls begin at the start of every DoReceivePdu () of any LtePdcp and
+   * end before the SDU is passed up, e.g. to count the PDCP receive path
+   * alone. Null callbacks remove the hooks.
+   */
+  static void SetReceiveHooks (Callback<void> begin, Callback<void> end);
+  /****/
+
   /**
    *
    *
@@ -178,6 +187,11 @@ private:
    */
   static const uint16_t m_maxPdcpSn = 4095;
 
+  /****/
+  static Callback<void> m_receiveBegin;
+  static Callback<void> m_receiveEnd;
+  /****/
+
 };
 
 
@@ -0,0 +1,278 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "lte-stats-format.h"
+
+/**
+ * Converts the binary LTE stat traces of --lteStats (lte-binary-traces.h)
+ * into the text files LteHelper::EnableTraces () writes, with the same
+ * columns: MAC stats one line per scheduling decision, RLC and PDCP stats
+ * one line per bearer and epoch of --epoch seconds (0.25, the default
+ * EpochDuration of RadioBearerStatsCalculator), with delays in seconds.
+ *
+ * Without --output, file.bin is written to file.txt.
+ *
+ * Needs no ns-3, build it on its own with
+ *   g++ -O2 -o lte-stats-convert lte-stats-convert.cc
+ *
+ * Usage: lte-stats-convert [--epoch=S] [--output=FILE] file.bin
+ */
+
+namespace {
+
+/// Bearer of an RLC or PDCP record
+struct BearerKey
+{
+  uint16_t cellId;
+  uint64_t imsi;
+  uint16_t rnti;
+  uint8_t lcid;
+
+  bool operator< (const BearerKey &other) const
+  {
+    if (imsi != other.imsi)
+      {
+        return imsi < other.imsi;
+      }
+    if (lcid != other.lcid)
+      {
+        return lcid < other.lcid;
+      }
+    if (cellId != other.cellId)
+      {
+        return cellId < other.cellId;
+      }
+    return rnti < other.rnti;
+  }
+};
+
+/// Count, sum, sum of squares, min and max of a series
+struct Moments
+{
+  Moments ()
+    : n (0),
+      sum (0),
+      squares (0),
+      min (0),
+      max (0)
+  {
+  }
+
+  void Add (double x)
+  {
+    min = n == 0 ? x : std::min (min, x);
+    max = n == 0 ? x : std::max (max, x);
+    ++n;
+    sum += x;
+    squares += x * x;
+  }
+
+  double Mean (void) const
+  {
+    return n > 0 ? sum / n : 0;
+  }
+
+  double StdDev (void) const
+  {
+    if (n < 2)
+      {
+        return 0;
+      }
+    double variance = (squares - sum * sum / n) / (n - 1);
+    return variance > 0 ? std::sqrt (variance) : 0;
+  }
+
+  uint64_t n;
+  double sum;
+  double squares;
+  double min;
+  double max;
+};
+
+struct BearerStats
+{
+  BearerStats ()
+    : txPdus (0),
+      txBytes (0),
+      rxBytes (0)
+  {
+  }
+  uint64_t txPdus;
+  uint64_t txBytes;
+  uint64_t rxBytes;
+  Moments delay;                ///< of the received PDUs, in seconds
+  Moments size;                 ///< of the received PDUs
+};
+
+typedef std::map<BearerKey, BearerStats> Epoch;
+
+void
+WriteMac (FILE *out, const LteStatsRecord &r, bool downlink)
+{
+  fprintf (out, "%.9g\t%u\t%llu\t%u\t%u\t%u\t%u\t%u", r.timeNs * 1e-9, r.cellId, (unsigned long long) r.imsi,
+           r.frame, r.subframe, r.rnti, r.mcs, r.size);
+  if (downlink)
+    {
+      fprintf (out, "\t%u\t%u", r.mcs2, r.size2);
+    }
+  fprintf (out, "\n");
+}
+
+void
+WriteEpoch (FILE *out, const Epoch &epoch, double start, double end)
+{
+  for (Epoch::const_iterator it = epoch.begin (); it != epoch.end (); ++it)
+    {
+      const BearerKey &key = it->first;
+      const BearerStats &s = it->second;
+      fprintf (out, "%g\t%g\t%u\t%llu\t%u\t%u\t%llu\t%llu\t%llu\t%llu\t%g\t%g\t%g\t%g\t%g\t%g\t%g\t%g\n",
+               start, end, key.cellId, (unsigned long long) key.imsi, key.rnti, key.lcid,
+               (unsigned long long) s.txPdus, (unsigned long long) s.txBytes, (unsigned long long) s.delay.n,
+               (unsigned long long) s.rxBytes, s.delay.Mean (), s.delay.StdDev (), s.delay.min, s.delay.max,
+               s.size.Mean (), s.size.StdDev (), s.size.min, s.size.max);
+    }
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  double epochSeconds = 0.25;
+  std::string filename;
+  std::string output;
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg.compare (0, 8, "--epoch=") == 0)
+        {
+          epochSeconds = atof (arg.c_str () + 8);
+        }
+      else if (arg.compare (0, 9, "--output=") == 0)
+        {
+          output = arg.substr (9);
+        }
+      else if (arg.compare (0, 2, "--") != 0 && filename.empty ())
+        {
+          filename = arg;
+        }
+      else
+        {
+          filename.clear ();
+          break;
+        }
+    }
+  if (filename.empty () || epochSeconds <= 0)
+    {
+      std::cerr << "Usage: lte-stats-convert [--epoch=S] [--output=FILE] file.bin\n";
+      return 2;
+    }
+  if (output.empty ())
+    {
+      std::string::size_type dot = filename.rfind (".bin");
+      output = (dot != std::string::npos && dot + 4 == filename.size () ? filename.substr (0, dot) : filename) + ".txt";
+    }
+
+  LteStatsReader reader;
+  std::string error;
+  if (!reader.Open (filename, error))
+    {
+      std::cerr << "lte-stats-convert: " << error << "\n";
+      return 1;
+    }
+  FILE *out = fopen (output.c_str (), "w");
+  if (out == 0)
+    {
+      std::cerr << "lte-stats-convert: cannot write " << output << "\n";
+      return 1;
+    }
+  uint32_t kind = reader.GetKind ();
+  bool mac = kind == LTE_STATS_DL_MAC || kind == LTE_STATS_UL_MAC;
+  if (kind == LTE_STATS_DL_MAC)
+    {
+      fprintf (out, "%% time\tcellId\tIMSI\tframe\tsframe\tRNTI\tmcsTb1\tsizeTb1\tmcsTb2\tsizeTb2\n");
+    }
+  else if (kind == LTE_STATS_UL_MAC)
+    {
+      fprintf (out, "%% time\tcellId\tIMSI\tframe\tsframe\tRNTI\tmcs\tsize\n");
+    }
+  else
+    {
+      fprintf (out, "%% start\tend\tCellId\tIMSI\tRNTI\tLCID\tnTxPDUs\tTxBytes\tnRxPDUs\tRxBytes\t"
+               "delay\tstdDev\tmin\tmax\tPduSize\tstdDev\tmin\tmax\n");
+    }
+
+  std::vector<LteStatsRecord> records (4096);
+  Epoch epoch;
+  int64_t epochNs = static_cast<int64_t> (epochSeconds * 1e9);
+  int64_t epochIndex = 0;
+  uint64_t total = 0;
+  uint32_t n;
+  while ((n = reader.Read (&records[0], records.size ())) > 0)
+    {
+      for (uint32_t i = 0; i < n; ++i)
+        {
+          const LteStatsRecord &r = records[i];
+          if (mac)
+            {
+              WriteMac (out, r, kind == LTE_STATS_DL_MAC);
+              continue;
+            }
+          int64_t index = r.timeNs / epochNs;
+          if (index != epochIndex)
+            {
+              WriteEpoch (out, epoch, epochIndex * epochSeconds, (epochIndex + 1) * epochSeconds);
+              epoch.clear ();
+              epochIndex = index;
+            }
+          BearerKey key;
+          key.cellId = r.cellId;
+          key.imsi = r.imsi;
+          key.rnti = r.rnti;
+          key.lcid = r.lcid;
+          BearerStats &stats = epoch[key];
+          if (r.event == LTE_STATS_TX)
+            {
+              ++stats.txPdus;
+              stats.txBytes += r.size;
+            }
+          else
+            {
+              stats.rxBytes += r.size;
+              stats.delay.Add (r.delayNs * 1e-9);
+              stats.size.Add (r.size);
+            }
+        }
+      total += n;
+    }
+  WriteEpoch (out, epoch, epochIndex * epochSeconds, (epochIndex + 1) * epochSeconds);
+  if (fclose (out) != 0)
+    {
+      std::cerr << "lte-stats-convert: cannot write " << output << "\n";
+      return 1;
+    }
+  std::cerr << "lte-stats-convert: " << total << " " << LteStatsName (kind) << " records to " << output << "\n";
+  return 0;
+}
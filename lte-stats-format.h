@@ -0,0 +1,158 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LTE_STATS_FORMAT_H
+#define LTE_STATS_FORMAT_H
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+/*
+ * Binary LTE stat traces, version 1: the raw events behind the DlMacStats,
+ * UlMacStats, DlRlcStats, UlRlcStats, DlPdcpStats and UlPdcpStats files of
+ * LteHelper::EnableTraces (), one file per stat. Does not depend on ns-3,
+ * so lte-stats-convert turns them into text without linking the simulator.
+ *
+ * Native endian, an LteStatsHeader followed by LteStatsRecords in the order
+ * the events happened.
+ */
+
+/// Which stat file a trace is
+enum LteStatsKind
+{
+  LTE_STATS_DL_MAC = 0,
+  LTE_STATS_UL_MAC = 1,
+  LTE_STATS_DL_RLC = 2,
+  LTE_STATS_UL_RLC = 3,
+  LTE_STATS_DL_PDCP = 4,
+  LTE_STATS_UL_PDCP = 5,
+  LTE_STATS_KINDS = 6
+};
+
+/// Which side of a bearer an RLC or PDCP record was taken at
+enum LteStatsEvent
+{
+  LTE_STATS_TX = 0,           ///< TxPDU at the sender
+  LTE_STATS_RX = 1            ///< RxPDU at the receiver
+};
+
+struct LteStatsHeader
+{
+  char magic[8];              ///< "LTESTAT" and a NUL
+  uint32_t version;           ///< LTE_STATS_VERSION
+  uint32_t recordSize;        ///< sizeof (LteStatsRecord) of the writer
+  uint32_t kind;              ///< LteStatsKind
+  uint32_t reserved;
+};
+
+/**
+ * One scheduling decision (MAC) or one PDU (RLC, PDCP). MAC records use
+ * frame, subframe, mcs and size, mcs2 and size2 for the second transport
+ * block of DL; RLC and PDCP records use event, lcid, size and delayNs.
+ */
+struct LteStatsRecord
+{
+  int64_t timeNs;
+  uint64_t imsi;              ///< 0 if the RNTI was not known to the RRC
+  uint64_t delayNs;           ///< RxPDU delay
+  uint32_t size;
+  uint32_t size2;
+  uint32_t frame;
+  uint16_t cellId;
+  uint16_t rnti;
+  uint8_t subframe;
+  uint8_t lcid;
+  uint8_t mcs;
+  uint8_t mcs2;
+  uint8_t event;              ///< LteStatsEvent
+  uint8_t reserved[3];
+};
+
+static const uint32_t LTE_STATS_VERSION = 1;
+
+/// \return the file name EnableTraces () uses for kind, without extension
+inline const char *
+LteStatsName (uint32_t kind)
+{
+  static const char *names[LTE_STATS_KINDS] = {
+    "DlMacStats", "UlMacStats", "DlRlcStats", "UlRlcStats", "DlPdcpStats", "UlPdcpStats"
+  };
+  return kind < LTE_STATS_KINDS ? names[kind] : "unknown";
+}
+
+/// Reads the records of an LTE stat trace block by block
+class LteStatsReader
+{
+public:
+  LteStatsReader ()
+    : m_file (0),
+      m_kind (0)
+  {
+  }
+
+  ~LteStatsReader ()
+  {
+    if (m_file != 0)
+      {
+        fclose (m_file);
+      }
+  }
+
+  /// \return false with the reason in error if the file is not an LTE stat trace
+  bool Open (std::string filename, std::string &error)
+  {
+    m_file = fopen (filename.c_str (), "rb");
+    if (m_file == 0)
+      {
+        error = "cannot read " + filename;
+        return false;
+      }
+    LteStatsHeader header;
+    if (fread (&header, sizeof (header), 1, m_file) != 1 || memcmp (header.magic, "LTESTAT", 7) != 0)
+      {
+        error = filename + " is not an LTE stat trace";
+        return false;
+      }
+    if (header.version != LTE_STATS_VERSION || header.recordSize != sizeof (LteStatsRecord)
+        || header.kind >= LTE_STATS_KINDS)
+      {
+        error = filename + " is an LTE stat trace of another version";
+        return false;
+      }
+    m_kind = header.kind;
+    return true;
+  }
+
+  /// \return LteStatsKind of the trace
+  uint32_t GetKind (void) const
+  {
+    return m_kind;
+  }
+
+  /// \return the number of records read into records, 0 at the end of the file
+  uint32_t Read (LteStatsRecord *records, uint32_t maxRecords)
+  {
+    return fread (records, sizeof (LteStatsRecord), maxRecords, m_file);
+  }
+
+private:
+  FILE *m_file;
+  uint32_t m_kind;
+};
+
+#endif // LTE_STATS_FORMAT_H
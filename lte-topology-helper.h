@@ -0,0 +1,171 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LTE_TOPOLOGY_HELPER_H
+#define LTE_TOPOLOGY_HELPER_H
+
+#include <iostream>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/lte-module.h"
+
+namespace ns3 {
+
+/**
+ * Points the default route of every UE at the EPC gateway.
+ *
+ * The routing helper and the gateway address are looked up once for the
+ * whole container instead of once per UE.
+ */
+inline void
+SetUeDefaultRoutes (NodeContainer ueNodes, Ipv4Address gateway)
+{
+  Ipv4StaticRoutingHelper ipv4RoutingHelper;
+  for (NodeContainer::Iterator it = ueNodes.Begin (); it != ueNodes.End (); ++it)
+    {
+      Ptr<Ipv4StaticRouting> ueStaticRouting = ipv4RoutingHelper.GetStaticRouting ((*it)->GetObject<Ipv4> ());
+      ueStaticRouting->SetDefaultRoute (gateway, 1);
+    }
+}
+
+/**
+ * Creates the UdpClient/PacketSink pairs of the scenarios.
+ *
+ * The helpers in the scripts are built once per UE, which resolves the
+ * TypeId and every attribute name again for identical applications. This
+ * factory resolves them once; only the remote address and port change per
+ * flow. Flows can also be installed lazily: ScheduleFlow () creates the
+ * sink and the client only at the time the flow starts, so the applications
+ * of UEs that have not started yet cost nothing during setup.
+ */
+class UdpFlowFactory
+{
+public:
+  /**
+   * \param packetSize UdpClient PacketSize
+   * \param interval UdpClient Interval
+   * \param maxPackets UdpClient MaxPackets
+   */
+  UdpFlowFactory (uint32_t packetSize, Time interval, uint32_t maxPackets)
+  {
+    m_client.SetTypeId (UdpClient::GetTypeId ());
+    m_client.Set ("PacketSize", UintegerValue (packetSize));
+    m_client.Set ("Interval", TimeValue (interval));
+    m_client.Set ("MaxPackets", UintegerValue (maxPackets));
+    m_sink.SetTypeId (PacketSink::GetTypeId ());
+    m_sink.Set ("Protocol", TypeIdValue (UdpSocketFactory::GetTypeId ()));
+  }
+
+  /// \param rx connected to the Rx trace of every sink this factory creates
+  void AddSinkRxCallback (Callback<void, Ptr<const Packet>, const Address &> rx)
+  {
+    m_sinkRx.push_back (rx);
+  }
+
+  Ptr<Application> InstallSink (Ptr<Node> node, uint16_t port)
+  {
+    m_sink.Set ("Local", AddressValue (InetSocketAddress (Ipv4Address::GetAny (), port)));
+    Ptr<Application> sink = m_sink.Create<Application> ();
+    for (uint32_t i = 0; i < m_sinkRx.size (); ++i)
+      {
+        sink->TraceConnectWithoutContext ("Rx", m_sinkRx[i]);
+      }
+    node->AddApplication (sink);
+    return sink;
+  }
+
+  Ptr<Application> InstallClient (Ptr<Node> node, Ipv4Address remote, uint16_t port)
+  {
+    m_client.Set ("RemoteAddress", AddressValue (Address (remote)));
+    m_client.Set ("RemotePort", UintegerValue (port));
+    Ptr<Application> client = m_client.Create<Application> ();
+    node->AddApplication (client);
+    return client;
+  }
+
+  /**
+   * Installs a sink on receiver and a client on sender sending to it, both
+   * created only at start. Applications added to a running simulation start
+   * as soon as they are initialized.
+   */
+  void ScheduleFlow (Ptr<Node> sender, Ptr<Node> receiver, Ipv4Address receiverAddress, uint16_t port, Time start)
+  {
+    Simulator::Schedule (start, &UdpFlowFactory::DoInstallFlow, this, sender, receiver, receiverAddress, port);
+  }
+
+private:
+  void DoInstallFlow (Ptr<Node> sender, Ptr<Node> receiver, Ipv4Address receiverAddress, uint16_t port)
+  {
+    InstallSink (receiver, port);
+    InstallClient (sender, receiverAddress, port);
+  }
+
+  ObjectFactory m_client;
+  ObjectFactory m_sink;
+  std::vector<Callback<void, Ptr<const Packet>, const Address &> > m_sinkRx;
+};
+
+/**
+ * Measures how long a scenario takes to build and to deliver its first
+ * packet, in wall-clock time from the construction of the timer.
+ *
+ * Prints one machine-readable line when the first packet arrives:
+ *   Startup: nodes=<n> setupMs=<ms> firstPacketMs=<ms>
+ */
+class StartupTimer
+{
+public:
+  StartupTimer ()
+    : m_nodes (0),
+      m_setupMs (-1),
+      m_done (false)
+  {
+    m_clock.Start ();
+  }
+
+  /// Call right before Simulator::Run ()
+  void SetupDone (uint32_t nodes)
+  {
+    m_nodes = nodes;
+    m_setupMs = m_clock.End ();
+  }
+
+  /// Connect to the PacketSink Rx trace
+  void NotifyRx (Ptr<const Packet> packet, const Address &from)
+  {
+    if (m_done)
+      {
+        return;
+      }
+    m_done = true;
+    std::cout << "Startup: nodes=" << m_nodes << " setupMs=" << m_setupMs
+              << " firstPacketMs=" << m_clock.End () << std::endl;
+  }
+
+private:
+  SystemWallClockMs m_clock;
+  uint32_t m_nodes;
+  int64_t m_setupMs;
+  bool m_done;
+};
+
+} // namespace ns3
+
+#endif // LTE_TOPOLOGY_HELPER_H
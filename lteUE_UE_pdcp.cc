@@ -31,6 +31,10 @@
 #include "ns3/flow-monitor-module.h"
 #include <ns3/flow-monitor-helper.h>
 #include "ns3/config-store.h"
+#include "run-profile.h"
+#include "flow-stats-writer.h"
+#include "time-bin-aggregator.h"
+#include "instrumented-simulator-impl.h"
 #include "ns3/stats-module.h"
 
 //#include "ns3/gtk-config-store.h"
@@ -50,11 +54,7 @@ int main (int argc, char *argv[])
 
   
   //The result show the UdpClient and PacketSink information
-  Packet::EnablePrinting ();
   Time::SetResolution (Time::NS);
-  LogComponentEnable("UdpClient",LOG_LEVEL_ALL);
-  LogComponentEnable("PacketSink", LOG_LEVEL_ALL);
-  LogComponentEnable("UdpServer",LOG_LEVEL_ALL);
   Config::SetDefault ("ns3::LtePdcp::PDCPDelay", UintegerValue(80));
   
   //Set value
@@ -62,6 +62,9 @@ int main (int argc, char *argv[])
   double simTime = 0.6;
   double distance = 10000;
   double interPacketInterval = 100;
+  std::string profileName = "full";
+  std::string flowStatsFile = "";
+  double byteCountWindow = 0.01;
 
   // Command line arguments
   CommandLine cmd;
@@ -69,9 +72,26 @@ int main (int argc, char *argv[])
   cmd.AddValue("simTime", "Total duration of the simulation [s])", simTime);
   cmd.AddValue("distance", "Distance between eNBs [m]", distance);
   cmd.AddValue("interPacketInterval", "Inter packet interval [ms])", interPacketInterval);
+  cmd.AddValue("profile", RunProfile::GetHelp (), profileName);
+  cmd.AddValue("flowStats", "Also write the FlowMonitor stats to this binary columnar file", flowStatsFile);
+  cmd.AddValue("byteCountWindow", "Window [s] the packet byte counts are added up per node over (0 = a line per packet)", byteCountWindow);
  
   cmd.Parse(argc, argv);
 
+  //Select which traces, pcaps and packet metadata this run pays for
+  RunProfile profile;
+  if (!profile.Parse (profileName))
+    {
+      NS_FATAL_ERROR ("Unknown run profile " << profileName);
+    }
+  profile.ApplyPacketSettings ();
+  if (profile.IsEnabled (RunProfile::LOGGING))
+    {
+      LogComponentEnable("UdpClient",LOG_LEVEL_ALL);
+      LogComponentEnable("PacketSink", LOG_LEVEL_ALL);
+      LogComponentEnable("UdpServer",LOG_LEVEL_ALL);
+    }
+
   //Active EPC model
   Ptr<LteHelper> lteHelper = CreateObject<LteHelper> ();
  // Ptr<EpcHelper>  epcHelper = CreateObject<EpcHelper> ();
@@ -226,9 +246,15 @@ int main (int argc, char *argv[])
     }
   serverApps.Start (Seconds (0.01));
   clientApps.Start (Seconds (0.01));
-  lteHelper->EnableTraces ();
-  // Uncomment to enable PCAP tracing
-  p2ph.EnablePcapAll("lena-epc-first");
+  if (profile.IsEnabled (RunProfile::LTE_TRACES))
+    {
+      lteHelper->EnableTraces ();
+    }
+  // PCAP tracing of the SGi link
+  if (profile.IsEnabled (RunProfile::PCAP))
+    {
+      p2ph.EnablePcapAll("lena-epc-first");
+    }
 
 FlowMonitorHelper flowmon;
 Ptr<FlowMonitor> monitor;
@@ -245,30 +271,43 @@ monitor->SetAttribute("JitterBinWidth", DoubleValue (0.001));
 
 
 //Add some construction
-// Use FileHelper to write out the packet byte count over time
+// Write out the packet byte count of every node per window, or with FileHelper per packet
+  TimeBinAggregator *byteCounts = 0;
   FileHelper fileHelper;
-
-  // Configure the file to be written, and the formatting of output data.
-  fileHelper.ConfigureFile ("UE-packet-byte-count",
-                            FileAggregator::FORMATTED);
-
-  // Set the labels for this formatted output file.
-  fileHelper.Set2dFormat ("Time (Seconds) = %.3e\tPacket Byte Count = %.0f");
-
-  // Specify the probe type, probe path (in configuration namespace), and
-  // probe output trace source ("OutputBytes") to write.
-  fileHelper.WriteProbe (probeName,
-                         probeTrace,
-                         "OutputBytes");
+  if (byteCountWindow > 0)
+    {
+      byteCounts = new TimeBinAggregator ("UE-packet-byte-count", Seconds (byteCountWindow));
+      byteCounts->WriteProbe (probeName, probeTrace, "OutputBytes");
+    }
+  else
+    {
+      // Configure the file to be written, and the formatting of output data.
+      fileHelper.ConfigureFile ("UE-packet-byte-count",
+                                FileAggregator::FORMATTED);
+
+      // Set the labels for this formatted output file.
+      fileHelper.Set2dFormat ("Time (Seconds) = %.3e\tPacket Byte Count = %.0f");
+
+      // Specify the probe type, probe path (in configuration namespace), and
+      // probe output trace source ("OutputBytes") to write.
+      fileHelper.WriteProbe (probeName,
+                             probeTrace,
+                             "OutputBytes");
+    }
 
 
 Simulator::Stop(Seconds(simTime));
 Simulator::Run();
+delete byteCounts;
 
 
 monitor->CheckForLostPackets ();
-monitor->SerializeToXmlFile ("results1.xml" , true, true );
+monitor->SerializeToXmlFile ("results1.xml" , profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS), profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS));
   Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
+if (!flowStatsFile.empty ())
+{
+FlowStatsWriter::Write (flowStatsFile, monitor, classifier);
+}
   std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
 for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
     {
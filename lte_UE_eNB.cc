@@ -30,6 +30,19 @@
 #include "ns3/flow-monitor-module.h"
 #include <ns3/flow-monitor-helper.h>
 #include "ns3/config-store.h"
+#include "run-profile.h"
+#include "flow-stats-writer.h"
+#include "flow-table.h"
+#include "lte-topology-helper.h"
+#include "memory-audit.h"
+#include "flow-snapshot.h"
+#include "flow-loss-tracker.h"
+#include "flow-log-histograms.h"
+#include "pcap-ring-buffer.h"
+#include "lte-binary-traces.h"
+#include "live-metrics.h"
+#include "progress-meter.h"
+#include "event-profiler-allocations.h"
 //#include "ns3/gtk-config-store.h"
 using namespace ns3;
 /**
@@ -40,25 +53,102 @@ using namespace ns3;
 NS_LOG_COMPONENT_DEFINE ("EpcFirstExample");
 int main (int argc, char *argv[])
 {
+// Wall clock of the setup, reported with the arrival of the first packet
+StartupTimer startup;
 //The result show the UdpClient and PacketSink information
 Time::SetResolution (Time::NS);
-LogComponentEnable("UdpClient",LOG_LEVEL_ALL);
-LogComponentEnable("UdpServer", LOG_LEVEL_ALL);
-LogComponentEnable("PacketSink", LOG_LEVEL_ALL);
-LogComponentEnable("EpcHelper", LOG_LEVEL_ALL);
-LogComponentEnable("LteHelper", LOG_LEVEL_ALL);
 //Set value
 uint16_t numberOfNodes = 10;
 double simTime = 0.5;
 double distance = 10.0;
 double interPacketInterval = 10;
+std::string profileName = "full-metadata";
+std::string flowStatsFile = "";
+bool lazyApps = false;
+bool ipv4OnlyUe = false;
+bool memoryAudit = false;
+std::string snapshotFile = "";
+double snapshotInterval = 0.1;
+double abortLoss = 0;
+double abortDelay = 0;
+std::string lossSeries = "";
+double lossBinWidth = 0.1;
+std::string logHistograms = "";
+double histogramPrecision = 0.01;
+uint32_t sampling = 1;
+std::string segmentDelays = "";
+uint32_t pcapRingSize = 0;
+double pcapWindow = 0.5;
+double pcapTriggerDelay = 100;
+std::string lteStats = "";
+std::string metricsAddress = "";
+double metricsInterval = 0.01;
+std::string profileEvents = "";
+double progressPeriod = 0;
+double progressFloor = 0;
 // Command line arguments
 CommandLine cmd;
 cmd.AddValue("numberOfNodes", "Number of eNodeBs + UE pairs", numberOfNodes);
 cmd.AddValue("simTime", "Total duration of the simulation [s])", simTime);
 cmd.AddValue("distance", "Distance between eNBs [m]", distance);
 cmd.AddValue("interPacketInterval", "Inter packet interval [ms])", interPacketInterval);
+cmd.AddValue("profile", RunProfile::GetHelp (), profileName);
+cmd.AddValue("flowStats", "Also write the FlowMonitor stats to this binary columnar file", flowStatsFile);
+cmd.AddValue("lazyApps", "Create the applications of each UE only when its flows start", lazyApps);
+cmd.AddValue("ipv4OnlyUe", "Install the internet stack on the UEs without IPv6 (changes nothing else)", ipv4OnlyUe);
+cmd.AddValue("memoryAudit", "Print the memory used per UE by setup phase and object type", memoryAudit);
+cmd.AddValue("snapshotFile", "Append the flows changed since the last snapshot to this file while the run goes on", snapshotFile);
+cmd.AddValue("snapshotInterval", "Simulated time between snapshots [s]", snapshotInterval);
+cmd.AddValue("abortLoss", "Stop the run at a snapshot whose loss ratio exceeds this (0 = never)", abortLoss);
+cmd.AddValue("abortDelay", "Stop the run at a snapshot whose mean delay exceeds this [ms] (0 = never)", abortDelay);
+cmd.AddValue("lossSeries", "Track lost packets incrementally and write their time series to this CSV file", lossSeries);
+cmd.AddValue("lossBinWidth", "Time bin of the loss time series [s]", lossBinWidth);
+cmd.AddValue("logHistograms", "Write per-flow log-linear delay and jitter histograms to <prefix>.xml and <prefix>.flowstats", logHistograms);
+cmd.AddValue("histogramPrecision", "Relative precision of the log-linear histogram bins", histogramPrecision);
+cmd.AddValue("sampling", "Follow one packet in this many for loss and the log-linear histograms instead of installing the FlowMonitor; packet counts stay exact", sampling);
+cmd.AddValue("segmentDelays", "Split the delay per flow into radio, S1-U and SGi segments and write them to this CSV file", segmentDelays);
+cmd.AddValue("pcapRing", "Instead of full pcaps keep this many packets per point-to-point device and dump them around anomalies (0 = off)", pcapRingSize);
+cmd.AddValue("pcapWindow", "Time captured before and after a pcap ring trigger [s]", pcapWindow);
+cmd.AddValue("pcapTriggerDelay", "Delay at a sink that triggers a pcap ring dump [ms]", pcapTriggerDelay);
+cmd.AddValue("lteStats", "Instead of the text LTE traces write binary MAC/RLC/PDCP stats to <prefix>DlMacStats.bin etc. (see lte-stats-convert)", lteStats);
+cmd.AddValue("metrics", "Serve live Prometheus metrics on this 127.0.0.1 port or Unix socket path while the run goes on", metricsAddress);
+cmd.AddValue("metricsInterval", "Simulated time between live metrics updates [s]", metricsInterval);
+cmd.AddValue("progress", "Print a Progress line with the simulated/wall time ratio and ETA every this many wall-clock seconds (0 = never)", progressPeriod);
+cmd.AddValue("progressFloor", "Stop the run after 3 Progress lines in a row below this simulated/wall time ratio (0 = never)", progressFloor);
+cmd.AddValue("profileEvents", "Write the wall time, count and allocations per event type to <prefix>.txt and <prefix>.folded", profileEvents);
 cmd.Parse(argc, argv);
+// The event counters need the simulator to be chosen before anything schedules an event
+if (!metricsAddress.empty () || !profileEvents.empty () || progressPeriod > 0)
+{
+InstrumentedSimulatorImpl::Enable ();
+}
+
+//Select which traces, pcaps and packet metadata this run pays for
+RunProfile profile;
+if (!profile.Parse (profileName))
+{
+NS_FATAL_ERROR ("Unknown run profile " << profileName);
+}
+// With sampling the tracker stands in for the FlowMonitor, which is not installed
+if (sampling > 1 && (!snapshotFile.empty () || !flowStatsFile.empty ()))
+{
+NS_FATAL_ERROR ("--snapshotFile and --flowStats read the FlowMonitor, which --sampling replaces");
+}
+profile.ApplyPacketSettings ();
+if (profile.IsEnabled (RunProfile::LOGGING))
+{
+LogComponentEnable("UdpClient",LOG_LEVEL_ALL);
+LogComponentEnable("UdpServer", LOG_LEVEL_ALL);
+LogComponentEnable("PacketSink", LOG_LEVEL_ALL);
+LogComponentEnable("EpcHelper", LOG_LEVEL_ALL);
+LogComponentEnable("LteHelper", LOG_LEVEL_ALL);
+}
+// Charges the memory of each setup phase below to that phase
+MemoryAudit *audit = 0;
+if (memoryAudit)
+{
+audit = new MemoryAudit;
+}
 //Active EPC model
 Ptr<LteHelper> lteHelper = CreateObject<LteHelper> ();
 Ptr<PointToPointEpcHelper> epcHelper = CreateObject<PointToPointEpcHelper> ();
@@ -111,20 +201,28 @@ mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
 mobility.SetPositionAllocator(positionAlloc);
 mobility.Install(enbNodes);
 mobility.Install(ueNodes);
+if (audit != 0)
+{
+audit->Mark ("nodes+mobility");
+}
 // Install LTE Devices to the nodes
 NetDeviceContainer enbLteDevs = lteHelper->InstallEnbDevice (enbNodes);
 NetDeviceContainer ueLteDevs = lteHelper->InstallUeDevice (ueNodes);
-// Install the IP stack on the UEs
-internet.Install (ueNodes);
+if (audit != 0)
+{
+audit->Mark ("lte-devices");
+}
+// Install the IP stack on the UEs, without IPv6 if asked to
+InternetStackHelper ueInternet;
+ueInternet.SetIpv6StackInstall (!ipv4OnlyUe);
+ueInternet.Install (ueNodes);
 Ipv4InterfaceContainer ueIpIface;
 ueIpIface = epcHelper->AssignUeIpv4Address (NetDeviceContainer (ueLteDevs));
-// Assign IP address to UEs, and install applications
-for (uint32_t u = 0; u < ueNodes.GetN (); ++u)
+// Set the default gateway for the UEs
+SetUeDefaultRoutes (ueNodes, epcHelper->GetUeDefaultGatewayAddress ());
+if (audit != 0)
 {
-Ptr<Node> ueNode = ueNodes.Get (u);
-// Set the default gateway for the UE
-Ptr<Ipv4StaticRouting> ueStaticRouting = ipv4RoutingHelper.GetStaticRouting (ueNode->GetObject<Ipv4> ());
-ueStaticRouting->SetDefaultRoute (epcHelper->GetUeDefaultGatewayAddress (), 1);
+audit->Mark ("internet-stack");
 }
 // Attach one UE per eNodeB
 for (uint16_t i = 0; i < numberOfNodes; i++)
@@ -136,36 +234,49 @@ lteHelper->Attach (ueLteDevs.Get(i), enbLteDevs.Get(i));
 // }
 // side effect: the default EPS bearer will be activated
 }
+if (audit != 0)
+{
+audit->Mark ("attach");
+}
 // Install and start applications on UEs and remote host
 uint16_t dlPort = 1234;
 uint16_t ulPort = 2000;
 uint16_t otherPort = 3000;
 ApplicationContainer clientApps;
 ApplicationContainer serverApps;
+// Application TypeIds and attributes are resolved once for all UEs
+UdpFlowFactory flows (100, MilliSeconds (interPacketInterval), 10000);
+flows.AddSinkRxCallback (MakeCallback (&StartupTimer::NotifyRx, &startup));
+// Ring capture of the point-to-point links, dumped only around delay spikes and drops
+PcapRingBuffer pcapRing ("lena-epc-ring", pcapRingSize, Seconds (pcapWindow), 10);
+if (pcapRingSize > 0)
+{
+pcapRing.SetDelayThreshold (MilliSeconds (pcapTriggerDelay));
+flows.AddSinkRxCallback (MakeCallback (&PcapRingBuffer::SinkRx, &pcapRing));
+}
+LiveMetrics metrics (metricsAddress, Seconds (metricsInterval));
+if (!metricsAddress.empty ())
+{
+metrics.AddFlowClass ("dl", remoteHostContainer, ueNodes);
+metrics.AddFlowClass ("ul", ueNodes, remoteHostContainer);
+flows.AddSinkRxCallback (MakeCallback (&LiveMetrics::SinkRx, &metrics));
+}
 for (uint32_t u = 0; u < ueNodes.GetN (); ++u)
 {
 ++ulPort;
 ++otherPort;
-PacketSinkHelper dlPacketSinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), dlPort));
-PacketSinkHelper ulPacketSinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), ulPort));
-// PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), otherPort));
-serverApps.Add (dlPacketSinkHelper.Install (ueNodes.Get(u)));
-serverApps.Add (ulPacketSinkHelper.Install (remoteHost));
-// serverApps.Add (packetSinkHelper.Install (ueNodes.Get(u)));
-UdpClientHelper dlClient (ueIpIface.GetAddress (u), dlPort);
-dlClient.SetAttribute("PacketSize", UintegerValue(100));
-dlClient.SetAttribute ("Interval", TimeValue (MilliSeconds(interPacketInterval)));
-dlClient.SetAttribute ("MaxPackets", UintegerValue(10000));
-UdpClientHelper ulClient (remoteHostAddr, ulPort);
-ulClient.SetAttribute("PacketSize",UintegerValue(100));
-ulClient.SetAttribute ("Interval", TimeValue (MilliSeconds(interPacketInterval)));
-ulClient.SetAttribute ("MaxPackets", UintegerValue(10000));
-// UdpClientHelper client (ueIpIface.GetAddress (u), otherPort);
-// client.SetAttribute("PacketSize",UintegerValue(100));
-// client.SetAttribute ("Interval", TimeValue (MilliSeconds(interPacketInterval)));
-// client.SetAttribute ("MaxPackets", UintegerValue(100));
-clientApps.Add (dlClient.Install (remoteHost));
-clientApps.Add (ulClient.Install (ueNodes.Get(u)));
+if (lazyApps)
+{
+flows.ScheduleFlow (remoteHost, ueNodes.Get (u), ueIpIface.GetAddress (u), dlPort, Seconds (0.01));
+flows.ScheduleFlow (ueNodes.Get (u), remoteHost, remoteHostAddr, ulPort, Seconds (0.01));
+continue;
+}
+serverApps.Add (flows.InstallSink (ueNodes.Get (u), dlPort));
+serverApps.Add (flows.InstallSink (remoteHost, ulPort));
+// serverApps.Add (flows.InstallSink (ueNodes.Get (u), otherPort));
+// flows.InstallClient (ueNodes.Get (u), ueIpIface.GetAddress (u), otherPort) sends with MaxPackets 100
+clientApps.Add (flows.InstallClient (remoteHost, ueIpIface.GetAddress (u), dlPort));
+clientApps.Add (flows.InstallClient (ueNodes.Get (u), remoteHostAddr, ulPort));
 // if (u+1 < ueNodes.GetN ())
 // {
 // clientApps.Add (client.Install (ueNodes.Get(u+1)));
@@ -177,37 +288,149 @@ clientApps.Add (ulClient.Install (ueNodes.Get(u)));
 }
 serverApps.Start (Seconds (0.01));
 clientApps.Start (Seconds (0.01));
+if (audit != 0)
+{
+audit->Mark ("applications");
+}
+LteBinaryTraces binaryTraces (lteStats);
+if (!lteStats.empty ())
+{
+binaryTraces.Enable ();
+}
+else if (profile.IsEnabled (RunProfile::LTE_TRACES))
+{
 lteHelper->EnableTraces ();
-// Uncomment to enable PCAP tracing
+}
+// PCAP tracing of the SGi link
+if (pcapRingSize > 0)
+{
+pcapRing.InstallAll ();
+pcapRing.TriggerOnDrops (NodeContainer (pgw, remoteHost));
+}
+else if (profile.IsEnabled (RunProfile::PCAP))
+{
 p2ph.EnablePcapAll("lena-epc-first");
+}
 FlowMonitorHelper flowmon;
 Ptr<FlowMonitor> monitor;
+if (sampling == 1)
+{
 monitor = flowmon.Install(ueNodes);
 // monitor = flowmon.Install(enbNodes);
 monitor = flowmon.Install(remoteHost);
+}
 monitor = flowmon.GetMonitor ();
 monitor->SetAttribute("DelayBinWidth", DoubleValue (0.001));
 monitor->SetAttribute("JitterBinWidth", DoubleValue (0.001));
 monitor->SetAttribute("PacketSizeBinWidth", DoubleValue (2000));
+if (audit != 0)
+{
+audit->Mark ("flowmon");
+}
+TimeValue maxPerHopDelay;
+monitor->GetAttribute ("MaxPerHopDelay", maxPerHopDelay);
+FlowLossTracker lossTracker (maxPerHopDelay.Get (), Seconds (lossBinWidth));
+FlowLogHistograms histograms (histogramPrecision);
+if (sampling > 1 || !lossSeries.empty () || !logHistograms.empty () || !segmentDelays.empty ())
+{
+lossTracker.SetSampling (sampling);
+lossTracker.Install (ueNodes);
+lossTracker.Install (remoteHostContainer);
+histograms.Install (lossTracker);
+}
+// FlowMonitor probes on the eNBs would only see the GTP-U tunnel, the tracker follows the packets through it
+if (!segmentDelays.empty ())
+{
+lossTracker.InstallCheckpoint (enbNodes, FlowLossTracker::ENB_CHECKPOINT);
+lossTracker.InstallCheckpoint (NodeContainer (pgw), FlowLossTracker::PGW_CHECKPOINT);
+}
+FlowSnapshotWriter snapshots;
+if (!snapshotFile.empty ())
+{
+if (!lossSeries.empty ())
+{
+snapshots.SetLossTracker (&lossTracker);
+}
+snapshots.SetAbortThresholds (abortLoss, MilliSeconds (abortDelay), 100);
+snapshots.Start (monitor, snapshotFile, Seconds (snapshotInterval));
+}
 Simulator::Stop(Seconds(simTime));
+startup.SetupDone (ueNodes.GetN ());
+if (!metricsAddress.empty ())
+{
+metrics.Start ();
+}
+EventProfiler eventProfiler (profileEvents);
+if (!profileEvents.empty ())
+{
+InstrumentedSimulatorImpl::Get ()->SetProfiler (&eventProfiler);
+}
+ProgressMeter progress (MilliSeconds (1), progressPeriod);
+if (progressPeriod > 0)
+{
+progress.SetFloor (progressFloor, 3);
+progress.Start (Seconds (simTime));
+}
 Simulator::Run();
+progress.Finish ();
+metrics.Finish ();
+if (audit != 0)
+{
+audit->Mark ("simulation");
+audit->CountObjects (ueNodes);
+audit->Report (std::cout, ueNodes.GetN ());
+delete audit;
+}
+if (!lteStats.empty ())
+{
+binaryTraces.Close ();
+}
+snapshots.Finish ();
+if (pcapRingSize > 0)
+{
+pcapRing.Finish ();
+}
+if (!lossSeries.empty ())
+{
+lossTracker.WriteTimeSeries (lossSeries);
+}
+if (!segmentDelays.empty ())
+{
+lossTracker.WriteSegmentDelays (segmentDelays);
+}
+if (!logHistograms.empty ())
+{
+histograms.SerializeToXmlFile (logHistograms + ".xml");
+histograms.WriteFlowStats (logHistograms + ".flowstats");
+}
+if (sampling > 1)
+{
+lossTracker.Report (std::cout);
+}
+else
+{
 monitor->CheckForLostPackets ();
-monitor->SerializeToXmlFile ("results.xml" , true, true );
+monitor->SerializeToXmlFile ("results.xml" , profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS), profile.IsEnabled (RunProfile::FLOWMON_HISTOGRAMS));
 Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
-std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
-for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
+if (!flowStatsFile.empty ())
 {
-// first 2 FlowIds are for ECHO apps, we don't want to display them
-if (i->first > 0)
+FlowStatsWriter::Write (flowStatsFile, monitor, classifier);
+}
+FlowTable flowTable (monitor, classifier);
+for (FlowId flowId = 1; flowId < flowTable.GetSize (); ++flowId)
 {
-Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-std::cout << "Flow " << i->first << " (" << t.sourceAddress << " -> " << t.destinationAddress << ")\n";
-std::cout << " Tx Packets: " << i->second.txPackets << "\n";
-std::cout << " Tx Bytes: " << i->second.txBytes << "\n";
-std::cout << " TxOffered: " << i->second.txBytes * 8.0 / simTime / 1024 / 1024 << " Mbps\n";
-std::cout << " Rx Packets: " << i->second.rxPackets << "\n";
-std::cout << " Rx Bytes: " << i->second.rxBytes << "\n";
-std::cout << " Throughput: " << i->second.rxBytes * 8.0 / simTime / 1024 / 1024 << " Mbps\n";
+if (flowTable.Get (flowId).stats != 0)
+{
+const FlowMonitor::FlowStats &stats = *flowTable.Get (flowId).stats;
+const Ipv4FlowClassifier::FiveTuple &t = flowTable.Get (flowId).tuple;
+std::cout << "Flow " << flowId << " (" << t.sourceAddress << " -> " << t.destinationAddress << ")\n";
+std::cout << " Tx Packets: " << stats.txPackets << "\n";
+std::cout << " Tx Bytes: " << stats.txBytes << "\n";
+std::cout << " TxOffered: " << stats.txBytes * 8.0 / simTime / 1024 / 1024 << " Mbps\n";
+std::cout << " Rx Packets: " << stats.rxPackets << "\n";
+std::cout << " Rx Bytes: " << stats.rxBytes << "\n";
+std::cout << " Throughput: " << stats.rxBytes * 8.0 / simTime / 1024 / 1024 << " Mbps\n";
+}
 }
 }
 //for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator iter = stats.begin (); iter != stats.end (); ++iter)
@@ -223,5 +446,6 @@ std::cout << " Throughput: " << i->second.rxBytes * 8.0 / simTime / 1024 / 1024
 // GtkConfigStore config;
 // config.ConfigureAttributes();
 Simulator::Destroy();
-return 0;
+// A run stopped early by the progress floor or a snapshot limit is not a result
+return (progress.IsAborted () || snapshots.IsAborted ()) ? 1 : 0;
 
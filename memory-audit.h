@@ -0,0 +1,198 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MEMORY_AUDIT_H
+#define MEMORY_AUDIT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include <malloc.h>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+namespace ns3 {
+
+/**
+ * Accounts the memory of a scenario by setup phase and by object type.
+ *
+ * Mark () is called after every setup phase (LTE devices, internet stack,
+ * applications, ...) and records how much the heap and the resident set grew
+ * since the previous mark, so every subsystem is charged what building it
+ * cost. CountObjects () walks every object reachable from a set of nodes
+ * through aggregation, devices, applications and object attributes, and
+ * counts them by TypeId. Report () prints both, divided by the number of UEs,
+ * as one machine-readable line each:
+ *   Memory: phase=<name> heapBytes=<n> rssBytes=<n> heapPerUe=<n>
+ *   Objects: type=<name> count=<n> perUe=<x>
+ */
+class MemoryAudit
+{
+public:
+  MemoryAudit ()
+    : m_lastHeap (ReadHeapBytes ()),
+      m_lastRss (ReadRssBytes ())
+  {
+  }
+
+  /// Charges the memory allocated since the previous mark to phase
+  void Mark (std::string phase)
+  {
+    Phase p;
+    p.name = phase;
+    uint64_t heap = ReadHeapBytes ();
+    uint64_t rss = ReadRssBytes ();
+    p.heapBytes = static_cast<int64_t> (heap) - static_cast<int64_t> (m_lastHeap);
+    p.rssBytes = static_cast<int64_t> (rss) - static_cast<int64_t> (m_lastRss);
+    m_lastHeap = heap;
+    m_lastRss = rss;
+    m_phases.push_back (p);
+  }
+
+  /// Counts the objects reachable from nodes by TypeId name
+  void CountObjects (NodeContainer nodes)
+  {
+    std::set<const Object *> visited;
+    for (NodeContainer::Iterator it = nodes.Begin (); it != nodes.End (); ++it)
+      {
+        Ptr<Node> node = *it;
+        Visit (node, visited);
+        for (uint32_t i = 0; i < node->GetNDevices (); ++i)
+          {
+            Visit (node->GetDevice (i), visited);
+          }
+        for (uint32_t i = 0; i < node->GetNApplications (); ++i)
+          {
+            Visit (node->GetApplication (i), visited);
+          }
+      }
+  }
+
+  void Report (std::ostream &os, uint32_t ues) const
+  {
+    uint32_t divisor = ues > 0 ? ues : 1;
+    int64_t heapTotal = 0;
+    for (std::vector<Phase>::const_iterator it = m_phases.begin (); it != m_phases.end (); ++it)
+      {
+        os << "Memory: phase=" << it->name << " heapBytes=" << it->heapBytes
+           << " rssBytes=" << it->rssBytes << " heapPerUe=" << it->heapBytes / divisor << "\n";
+        heapTotal += it->heapBytes;
+      }
+    os << "Memory: phase=total heapBytes=" << heapTotal << " rssBytes=" << ReadRssBytes ()
+       << " heapPerUe=" << heapTotal / divisor << "\n";
+    for (std::map<std::string, uint32_t>::const_iterator it = m_objects.begin (); it != m_objects.end (); ++it)
+      {
+        os << "Objects: type=" << it->first << " count=" << it->second
+           << " perUe=" << static_cast<double> (it->second) / divisor << "\n";
+      }
+  }
+
+  /// \return bytes currently allocated by malloc
+  static uint64_t ReadHeapBytes (void)
+  {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2 ();
+    return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    struct mallinfo info = mallinfo ();
+    return static_cast<unsigned int> (info.uordblks) + static_cast<unsigned int> (info.hblkhd);
+#else
+    return 0;
+#endif
+  }
+
+  /// \return resident set size of the process, from /proc/self/statm
+  static uint64_t ReadRssBytes (void)
+  {
+    std::ifstream statm ("/proc/self/statm");
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    statm >> size >> resident;
+    return resident * sysconf (_SC_PAGESIZE);
+  }
+
+private:
+  struct Phase
+  {
+    std::string name;
+    int64_t heapBytes;
+    int64_t rssBytes;
+  };
+
+  /**
+   * Counts object and everything it aggregates or points to through its
+   * Pointer and ObjectMap/ObjectVector attributes, the same graph the
+   * Config paths walk.
+   */
+  void Visit (Ptr<Object> object, std::set<const Object *> &visited)
+  {
+    if (object == 0 || !visited.insert (PeekPointer (object)).second)
+      {
+        return;
+      }
+    Object::AggregateIterator aggregates = object->GetAggregateIterator ();
+    while (aggregates.HasNext ())
+      {
+        Visit (ConstCast<Object> (aggregates.Next ()), visited);
+      }
+    ++m_objects[object->GetInstanceTypeId ().GetName ()];
+
+    for (TypeId tid = object->GetInstanceTypeId (); ; tid = tid.GetParent ())
+      {
+        for (uint32_t i = 0; i < tid.GetAttributeN (); ++i)
+          {
+            struct TypeId::AttributeInformation info = tid.GetAttribute (i);
+            if (!(info.flags & TypeId::ATTR_GET) || !info.accessor->HasGetter ())
+              {
+                continue;
+              }
+            if (DynamicCast<const PointerChecker> (info.checker) != 0)
+              {
+                PointerValue value;
+                object->GetAttribute (info.name, value);
+                Visit (value.GetObject (), visited);
+              }
+            else if (DynamicCast<const ObjectPtrContainerChecker> (info.checker) != 0)
+              {
+                ObjectPtrContainerValue value;
+                object->GetAttribute (info.name, value);
+                for (ObjectPtrContainerValue::Iterator it = value.Begin (); it != value.End (); ++it)
+                  {
+                    Visit (it->second, visited);
+                  }
+              }
+          }
+        if (tid == tid.GetParent ())
+          {
+            break;
+          }
+      }
+  }
+
+  uint64_t m_lastHeap;
+  uint64_t m_lastRss;
+  std::vector<Phase> m_phases;
+  std::map<std::string, uint32_t> m_objects;
+};
+
+} // namespace ns3
+
+#endif // MEMORY_AUDIT_H
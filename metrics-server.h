@@ -0,0 +1,323 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <string>
+#include <map>
+#include <sstream>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/**
+ * Named metrics in the Prometheus text format: every metric has a type
+ * ("counter", "gauge" or "summary"), a help text and one value per label
+ * set, e.g. Set ("lte_packets_sent_total", "class=\"dl\"", 42).
+ *
+ * Not thread-safe; the simulation thread owns it and hands Format () to a
+ * MetricsServer.
+ */
+class MetricsRegistry
+{
+public:
+  void Declare (std::string name, std::string type, std::string help)
+  {
+    Metric &metric = m_metrics[name];
+    metric.type = type;
+    metric.help = help;
+  }
+
+  /// Sets the value of name for labels ("" for none); name must be declared
+  void Set (std::string name, std::string labels, double value)
+  {
+    m_metrics[name].values[labels] = value;
+  }
+
+  /// \return the exposition text of all metrics
+  std::string Format (void) const
+  {
+    std::ostringstream os;
+    os.precision (12);
+    for (std::map<std::string, Metric>::const_iterator it = m_metrics.begin (); it != m_metrics.end (); ++it)
+      {
+        const Metric &metric = it->second;
+        os << "# HELP " << it->first << " " << metric.help << "\n";
+        os << "# TYPE " << it->first << " " << metric.type << "\n";
+        for (std::map<std::string, double>::const_iterator v = metric.values.begin (); v != metric.values.end (); ++v)
+          {
+            // a summary keeps its _sum and _count under the labels "_sum" and "_count"
+            if (v->first == "_sum" || v->first == "_count")
+              {
+                os << it->first << v->first;
+              }
+            else if (v->first.empty ())
+              {
+                os << it->first;
+              }
+            else
+              {
+                os << it->first << "{" << v->first << "}";
+              }
+            if (std::isnan (v->second))
+              {
+                os << " NaN\n";
+              }
+            else
+              {
+                os << " " << v->second << "\n";
+              }
+          }
+      }
+    return os.str ();
+  }
+
+private:
+  struct Metric
+  {
+    std::string type;
+    std::string help;
+    std::map<std::string, double> values;       ///< by label set
+  };
+
+  std::map<std::string, Metric> m_metrics;
+};
+
+/**
+ * Serves the last published metrics over HTTP from a thread of its own, on
+ * 127.0.0.1:<port> or on a Unix socket:
+ *
+ *   curl http://127.0.0.1:9464/metrics
+ *   curl --unix-socket /tmp/sim.sock http://localhost/metrics
+ *
+ * Publish () never waits: if the server thread is copying the previous text
+ * right then, it keeps answering with that until the next Publish ().
+ * Any request gets the metrics; requests are answered one at a time and a
+ * client that does not send its request within a second is dropped.
+ */
+class MetricsServer
+{
+public:
+  MetricsServer ()
+    : m_listen (-1),
+      m_started (false),
+      m_stop (false)
+  {
+    pthread_mutex_init (&m_mutex, 0);
+  }
+
+  ~MetricsServer ()
+  {
+    Stop ();
+    pthread_mutex_destroy (&m_mutex);
+  }
+
+  /**
+   * Listens on address, a TCP port on the loopback interface ("9464") or
+   * the path of a Unix socket ("/tmp/sim.sock"), and starts the server
+   * thread. \return false with the reason in error
+   */
+  bool Start (std::string address, std::string &error)
+  {
+    if (address.find ('/') != std::string::npos)
+      {
+        struct sockaddr_un un;
+        memset (&un, 0, sizeof (un));
+        un.sun_family = AF_UNIX;
+        if (address.size () >= sizeof (un.sun_path))
+          {
+            error = "socket path too long: " + address;
+            return false;
+          }
+        strcpy (un.sun_path, address.c_str ());
+        unlink (address.c_str ());
+        m_listen = socket (AF_UNIX, SOCK_STREAM, 0);
+        if (m_listen < 0 || bind (m_listen, reinterpret_cast<struct sockaddr *> (&un), sizeof (un)) != 0)
+          {
+            error = "cannot listen on " + address + ": " + strerror (errno);
+            return false;
+          }
+        m_path = address;
+      }
+    else
+      {
+        struct sockaddr_in in;
+        memset (&in, 0, sizeof (in));
+        in.sin_family = AF_INET;
+        in.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+        in.sin_port = htons (atoi (address.c_str ()));
+        m_listen = socket (AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (m_listen >= 0)
+          {
+            setsockopt (m_listen, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof (reuse));
+          }
+        if (m_listen < 0 || bind (m_listen, reinterpret_cast<struct sockaddr *> (&in), sizeof (in)) != 0)
+          {
+            error = "cannot listen on 127.0.0.1:" + address + ": " + strerror (errno);
+            return false;
+          }
+      }
+    if (listen (m_listen, 8) != 0)
+      {
+        error = "cannot listen on " + address + ": " + strerror (errno);
+        return false;
+      }
+    // a client hanging up mid-response must not kill the simulation
+    signal (SIGPIPE, SIG_IGN);
+    m_started = pthread_create (&m_thread, 0, &MetricsServer::Run, this) == 0;
+    if (!m_started)
+      {
+        error = "cannot start the metrics server thread";
+      }
+    return m_started;
+  }
+
+  /// Makes text what the server answers from now on
+  void Publish (const std::string &text)
+  {
+    m_pending = text;
+    if (pthread_mutex_trylock (&m_mutex) == 0)
+      {
+        m_text.swap (m_pending);
+        pthread_mutex_unlock (&m_mutex);
+      }
+  }
+
+  void Stop (void)
+  {
+    if (m_started)
+      {
+        pthread_mutex_lock (&m_mutex);
+        m_stop = true;
+        pthread_mutex_unlock (&m_mutex);
+        pthread_join (m_thread, 0);
+        m_started = false;
+      }
+    if (m_listen >= 0)
+      {
+        close (m_listen);
+        m_listen = -1;
+      }
+    if (!m_path.empty ())
+      {
+        unlink (m_path.c_str ());
+        m_path.clear ();
+      }
+  }
+
+private:
+  static void *Run (void *self)
+  {
+    static_cast<MetricsServer *> (self)->Serve ();
+    return 0;
+  }
+
+  /// The server thread: answers requests until Stop ()
+  void Serve (void)
+  {
+    while (true)
+      {
+        pthread_mutex_lock (&m_mutex);
+        bool stop = m_stop;
+        pthread_mutex_unlock (&m_mutex);
+        if (stop)
+          {
+            break;
+          }
+        struct pollfd listening;
+        listening.fd = m_listen;
+        listening.events = POLLIN;
+        // wake up now and then to notice Stop ()
+        if (poll (&listening, 1, 200) <= 0)
+          {
+            continue;
+          }
+        int client = accept (m_listen, 0, 0);
+        if (client < 0)
+          {
+            continue;
+          }
+        if (ReadRequest (client))
+          {
+            pthread_mutex_lock (&m_mutex);
+            std::string body = m_text;
+            pthread_mutex_unlock (&m_mutex);
+            std::ostringstream response;
+            response << "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+                     << body.size () << "\r\nConnection: close\r\n\r\n" << body;
+            std::string bytes = response.str ();
+            for (size_t sent = 0; sent < bytes.size (); )
+              {
+                ssize_t n = send (client, bytes.data () + sent, bytes.size () - sent, 0);
+                if (n <= 0)
+                  {
+                    break;
+                  }
+                sent += n;
+              }
+          }
+        close (client);
+      }
+  }
+
+  /// Reads up to the end of the request headers. \return false if the client is too slow or hangs up
+  static bool ReadRequest (int client)
+  {
+    std::string request;
+    char buffer[1024];
+    while (request.find ("\r\n\r\n") == std::string::npos && request.find ("\n\n") == std::string::npos)
+      {
+        struct pollfd readable;
+        readable.fd = client;
+        readable.events = POLLIN;
+        if (poll (&readable, 1, 1000) <= 0 || request.size () > 16384)
+          {
+            return false;
+          }
+        ssize_t n = recv (client, buffer, sizeof (buffer), 0);
+        if (n <= 0)
+          {
+            return false;
+          }
+        request.append (buffer, n);
+      }
+    return true;
+  }
+
+  int m_listen;
+  std::string m_path;           ///< of the Unix socket, removed by Stop ()
+  pthread_t m_thread;
+  bool m_started;
+  pthread_mutex_t m_mutex;      ///< guards m_text and m_stop
+  std::string m_text;
+  std::string m_pending;        ///< published but not handed over yet
+  bool m_stop;
+};
+
+#endif // METRICS_SERVER_H
@@ -0,0 +1,259 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PCAP_RING_BUFFER_H
+#define PCAP_RING_BUFFER_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/point-to-point-module.h"
+
+namespace ns3 {
+
+/**
+ * Captures the point-to-point devices like PointToPointHelper::EnablePcapAll ()
+ * but keeps the last packets of every device in memory and writes pcap files
+ * only when something worth looking at happens.
+ *
+ * Every device has a ring of the last capacity packets it sent or received,
+ * as the PromiscSniffer trace saw them; a ring entry only holds a reference
+ * to the packet, so nothing is serialized while the run is normal. Trigger ()
+ * schedules a dump after the window: then the packets of every device from
+ * window before the trigger up to the dump go to
+ * <prefix>-<dump>-<node>-<device>.pcap, packets already dumped are left out
+ * and devices without packets in the window get no file. Triggers while a
+ * dump is pending join it, and after maxDumps dumps triggers are only
+ * counted.
+ *
+ * The built-in triggers are a delay measured at a PacketSink above a
+ * threshold, taken from the SeqTsHeader UdpClient puts in front of its
+ * payload (connect SinkRx ()), and a packet drop on a captured device or in
+ * the IP stack of a node given to TriggerOnDrops ().
+ */
+class PcapRingBuffer
+{
+public:
+  PcapRingBuffer (std::string prefix, uint32_t capacity, Time window, uint32_t maxDumps)
+    : m_prefix (prefix),
+      m_capacity (capacity),
+      m_window (window),
+      m_maxDumps (maxDumps),
+      m_dumps (0),
+      m_triggers (0)
+  {
+  }
+
+  ~PcapRingBuffer ()
+  {
+    for (uint32_t i = 0; i < m_rings.size (); ++i)
+      {
+        delete m_rings[i];
+      }
+  }
+
+  /// Captures every PointToPointNetDevice that exists so far
+  void InstallAll (void)
+  {
+    for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); ++node)
+      {
+        for (uint32_t i = 0; i < (*node)->GetNDevices (); ++i)
+          {
+            Ptr<PointToPointNetDevice> device = DynamicCast<PointToPointNetDevice> ((*node)->GetDevice (i));
+            if (device != 0)
+              {
+                Install (device);
+              }
+          }
+      }
+  }
+
+  void Install (Ptr<PointToPointNetDevice> device)
+  {
+    Ring *ring = new Ring (m_capacity);
+    ring->nodeId = device->GetNode ()->GetId ();
+    ring->deviceId = device->GetIfIndex ();
+    m_rings.push_back (ring);
+    device->TraceConnectWithoutContext ("PromiscSniffer", MakeCallback (&Ring::Add, ring));
+    device->TraceConnectWithoutContext ("MacTxDrop", MakeCallback (&PcapRingBuffer::DeviceDrop, this));
+    device->TraceConnectWithoutContext ("PhyTxDrop", MakeCallback (&PcapRingBuffer::DeviceDrop, this));
+    device->TraceConnectWithoutContext ("PhyRxDrop", MakeCallback (&PcapRingBuffer::DeviceDrop, this));
+  }
+
+  /// Triggers a dump when a packet delivered at the sink was delayed more than threshold
+  void SetDelayThreshold (Time threshold)
+  {
+    m_delayThreshold = threshold;
+  }
+
+  /// Triggers a dump when the IP stack of one of nodes drops a packet
+  void TriggerOnDrops (NodeContainer nodes)
+  {
+    for (NodeContainer::Iterator it = nodes.Begin (); it != nodes.End (); ++it)
+      {
+        Ptr<Ipv4L3Protocol> ipv4 = (*it)->GetObject<Ipv4L3Protocol> ();
+        if (ipv4 != 0)
+          {
+            ipv4->TraceConnectWithoutContext ("Drop", MakeCallback (&PcapRingBuffer::Ipv4Drop, this));
+          }
+      }
+  }
+
+  /// Connect to the PacketSink Rx trace of sinks fed by UdpClient
+  void SinkRx (Ptr<const Packet> packet, const Address &from)
+  {
+    SeqTsHeader seqTs;
+    if (!m_delayThreshold.IsStrictlyPositive () || packet->GetSize () < seqTs.GetSerializedSize ())
+      {
+        return;
+      }
+    packet->PeekHeader (seqTs);
+    Time delay = Simulator::Now () - seqTs.GetTs ();
+    if (delay > m_delayThreshold)
+      {
+        std::ostringstream reason;
+        reason << "delay " << delay.GetSeconds () * 1000 << " ms";
+        Trigger (reason.str ());
+      }
+  }
+
+  /// Dumps the window around now, unless a dump is pending or maxDumps were written
+  void Trigger (std::string reason)
+  {
+    ++m_triggers;
+    if (m_dump.IsRunning () || m_dumps >= m_maxDumps)
+      {
+        return;
+      }
+    std::cout << "PcapRing: trigger at " << Simulator::Now ().GetSeconds () << " s, " << reason << "\n";
+    m_dumpFrom = Simulator::Now () - m_window;
+    m_dump = Simulator::Schedule (m_window, &PcapRingBuffer::Dump, this);
+  }
+
+  /// Writes a pending dump now, e.g. after Simulator::Run () stopped before it was due
+  void Finish (void)
+  {
+    if (m_dump.IsRunning ())
+      {
+        m_dump.Cancel ();
+        Dump ();
+      }
+    std::cout << "PcapRing: triggers=" << m_triggers << " dumps=" << m_dumps << "\n";
+  }
+
+private:
+  /// The last packets of a device, oldest first from next once full
+  struct Ring
+  {
+    Ring (uint32_t capacity)
+      : times (capacity),
+        packets (capacity),
+        next (0),
+        size (0),
+        dumpedUntil (-1),
+        nodeId (0),
+        deviceId (0)
+    {
+    }
+
+    void Add (Ptr<const Packet> packet)
+    {
+      if (packets.empty ())
+        {
+          return;
+        }
+      times[next] = Simulator::Now ().GetTimeStep ();
+      packets[next] = packet;
+      next = next + 1 == packets.size () ? 0 : next + 1;
+      size = std::min<uint32_t> (size + 1, packets.size ());
+    }
+
+    std::vector<int64_t> times;
+    std::vector<Ptr<const Packet> > packets;
+    uint32_t next;
+    uint32_t size;
+    int64_t dumpedUntil;        ///< time step of the last packet written
+    uint32_t nodeId;
+    uint32_t deviceId;
+  };
+
+  void Dump (void)
+  {
+    ++m_dumps;
+    PcapHelper pcapHelper;
+    uint32_t written = 0;
+    for (uint32_t r = 0; r < m_rings.size (); ++r)
+      {
+        Ring &ring = *m_rings[r];
+        Ptr<PcapFileWrapper> file;
+        uint32_t oldest = ring.size < ring.packets.size () ? 0 : ring.next;
+        for (uint32_t i = 0; i < ring.size; ++i)
+          {
+            uint32_t slot = (oldest + i) % ring.packets.size ();
+            if (ring.times[slot] < m_dumpFrom.GetTimeStep () || ring.times[slot] <= ring.dumpedUntil)
+              {
+                continue;
+              }
+            if (file == 0)
+              {
+                std::ostringstream name;
+                name << m_prefix << "-" << m_dumps << "-" << ring.nodeId << "-" << ring.deviceId << ".pcap";
+                file = pcapHelper.CreateFile (name.str (), std::ios::out, PcapHelper::DLT_PPP);
+              }
+            file->Write (TimeStep (ring.times[slot]), ring.packets[slot]);
+            ++written;
+          }
+        ring.dumpedUntil = Simulator::Now ().GetTimeStep ();
+      }
+    std::cout << "PcapRing: dump " << m_dumps << " at " << Simulator::Now ().GetSeconds () << " s, "
+              << written << " packets\n";
+  }
+
+  void DeviceDrop (Ptr<const Packet> packet)
+  {
+    Trigger ("device drop");
+  }
+
+  void Ipv4Drop (const Ipv4Header &header, Ptr<const Packet> packet, Ipv4L3Protocol::DropReason reason,
+                 Ptr<Ipv4> ipv4, uint32_t interface)
+  {
+    std::ostringstream text;
+    text << "IP drop, reason " << reason;
+    Trigger (text.str ());
+  }
+
+  std::string m_prefix;
+  uint32_t m_capacity;
+  Time m_window;
+  uint32_t m_maxDumps;
+  uint32_t m_dumps;
+  uint64_t m_triggers;
+  Time m_delayThreshold;
+  EventId m_dump;
+  Time m_dumpFrom;
+  std::vector<Ring *> m_rings;
+};
+
+} // namespace ns3
+
+#endif // PCAP_RING_BUFFER_H
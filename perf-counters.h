@@ -0,0 +1,173 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/**
+ * The hardware counters of the calling thread, opened with
+ * perf_event_open () as one group so they count over the same intervals:
+ * cycles, instructions, last-level cache misses and branch misses.
+ *
+ * Only user space is counted, which is what an unprivileged process may
+ * count with the default perf_event_paranoid of 2. If the CPU has fewer
+ * free counters than the group needs, the kernel multiplexes it; Read ()
+ * keeps the raw counts with the times the group was enabled and running,
+ * and Delta () scales the counts between two snapshots by the share of that
+ * interval it was counting.
+ *
+ * Linux only; does not depend on ns-3.
+ */
+class PerfCounters
+{
+public:
+  enum Counter
+  {
+    CYCLES = 0,
+    INSTRUCTIONS,
+    CACHE_MISSES,
+    BRANCH_MISSES,
+    COUNTERS
+  };
+
+  /// Raw counts since Open (), with the nanoseconds the group was enabled and running
+  struct Snapshot
+  {
+    uint64_t enabled;
+    uint64_t running;
+    uint64_t values[COUNTERS];
+  };
+
+  PerfCounters ()
+  {
+    for (uint32_t i = 0; i < COUNTERS; ++i)
+      {
+        m_fds[i] = -1;
+      }
+  }
+
+  ~PerfCounters ()
+  {
+    Close ();
+  }
+
+  /// Opens and starts the counters. \return false with the reason in error
+  bool Open (std::string &error)
+  {
+    static const uint64_t configs[COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (uint32_t i = 0; i < COUNTERS; ++i)
+      {
+        struct perf_event_attr attr;
+        memset (&attr, 0, sizeof (attr));
+        attr.size = sizeof (attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fds[i] = syscall (__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : m_fds[0], 0);
+        if (m_fds[i] < 0)
+          {
+            error = std::string ("perf_event_open () failed for ") + GetName (i) + ": " + strerror (errno);
+            Close ();
+            return false;
+          }
+      }
+    ioctl (m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+  }
+
+  bool IsOpen (void) const
+  {
+    return m_fds[0] >= 0;
+  }
+
+  /// Reads the counts since Open () into snapshot, zeros if the counters are not open
+  void Read (Snapshot &snapshot) const
+  {
+    // nr, time enabled, time running, then a value per counter
+    uint64_t group[3 + COUNTERS];
+    if (!IsOpen () || read (m_fds[0], group, sizeof (group)) != static_cast<ssize_t> (sizeof (group)))
+      {
+        memset (&snapshot, 0, sizeof (snapshot));
+        return;
+      }
+    snapshot.enabled = group[1];
+    snapshot.running = group[2];
+    for (uint32_t i = 0; i < COUNTERS; ++i)
+      {
+        snapshot.values[i] = group[3 + i];
+      }
+  }
+
+  /**
+   * Adds the counts from start to end to values, scaled by the time enabled
+   * over the time running in between; nothing if the group did not run
+   */
+  static void Delta (const Snapshot &start, const Snapshot &end, uint64_t values[COUNTERS])
+  {
+    if (end.running <= start.running || end.enabled < start.enabled)
+      {
+        return;
+      }
+    uint64_t enabled = end.enabled - start.enabled;
+    uint64_t running = end.running - start.running;
+    for (uint32_t i = 0; i < COUNTERS; ++i)
+      {
+        uint64_t count = end.values[i] >= start.values[i] ? end.values[i] - start.values[i] : 0;
+        values[i] += enabled == running ? count
+          : static_cast<uint64_t> (static_cast<double> (count) * enabled / running);
+      }
+  }
+
+  static const char *GetName (uint32_t counter)
+  {
+    static const char *names[COUNTERS] = { "cycles", "instructions", "cacheMisses", "branchMisses" };
+    return names[counter];
+  }
+
+private:
+  void Close (void)
+  {
+    for (uint32_t i = COUNTERS; i-- > 0; )
+      {
+        if (m_fds[i] >= 0)
+          {
+            close (m_fds[i]);
+            m_fds[i] = -1;
+          }
+      }
+  }
+
+  int m_fds[COUNTERS];
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,253 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PERF_SCOPES_H
+#define PERF_SCOPES_H
+
+#include <string>
+#include <cstring>
+#include <vector>
+#include <iostream>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/lte-pdcp.h"
+
+#include "perf-counters.h"
+
+namespace ns3 {
+
+/**
+ * Adds up the hardware counters of PerfCounters over named scopes of a
+ * run: Simulator::Run () as a whole and the subsystems inside it.
+ *
+ * A scope is counted from Begin () to End (); scopes may nest, the run
+ * scope contains all others. Every Begin () and End () reads the counters
+ * with one read () system call, which is not counted as only user space is,
+ * but does slow the run down, so the subsystem scopes are for measuring and
+ * not for production runs. Besides the scopes a script brackets itself, e.g.
+ * a delay stage, there are:
+ *
+ *   ScopePdcpReceive ()    LtePdcp::DoReceivePdu (), through the hooks of
+ *                          the patched lte-pdcp.cc
+ *   OpenIpv4Scope () and   every Ipv4L3Protocol trace sink connected in
+ *   CloseIpv4Scope ()      between, e.g. FlowMonitorHelper::Install () and
+ *                          so the FlowMonitor probes
+ *
+ * Report () prints one machine-readable line per scope, the counts and the
+ * counts per simulated packet:
+ *   PerfCounters: scope=<name> calls=<n> cycles=<n> ... packets=<n> cyclesPerPacket=<x> ... ipc=<x>
+ * If the counters cannot be opened, e.g. in a virtual machine or with a
+ * perf_event_paranoid above 2, the scopes cost next to nothing and Report ()
+ * says why.
+ */
+class PerfScopes
+{
+public:
+  PerfScopes ()
+    : m_pdcpScope (0),
+      m_pdcpHooked (false)
+  {
+    m_counters.Open (m_error);
+  }
+
+  ~PerfScopes ()
+  {
+    if (m_pdcpHooked)
+      {
+        LtePdcp::SetReceiveHooks (MakeNullCallback<void> (), MakeNullCallback<void> ());
+      }
+    for (uint32_t i = 0; i < m_hooks.size (); ++i)
+      {
+        delete m_hooks[i];
+      }
+  }
+
+  /// \return the index of a new scope for Begin () and End ()
+  uint32_t AddScope (std::string name)
+  {
+    Scope scope;
+    scope.name = name;
+    scope.calls = 0;
+    memset (&scope.start, 0, sizeof (scope.start));
+    for (uint32_t i = 0; i < PerfCounters::COUNTERS; ++i)
+      {
+        scope.total[i] = 0;
+      }
+    m_scopes.push_back (scope);
+    return m_scopes.size () - 1;
+  }
+
+  void Begin (uint32_t scope)
+  {
+    if (m_counters.IsOpen ())
+      {
+        m_counters.Read (m_scopes[scope].start);
+      }
+  }
+
+  void End (uint32_t scope)
+  {
+    if (m_counters.IsOpen ())
+      {
+        PerfCounters::Snapshot now;
+        m_counters.Read (now);
+        Scope &s = m_scopes[scope];
+        PerfCounters::Delta (s.start, now, s.total);
+        ++s.calls;
+      }
+  }
+
+  /// Counts every LtePdcp::DoReceivePdu () as scope "pdcp-rx"
+  void ScopePdcpReceive (void)
+  {
+    m_pdcpScope = AddScope ("pdcp-rx");
+    m_pdcpHooked = true;
+    LtePdcp::SetReceiveHooks (MakeCallback (&PerfScopes::BeginPdcpReceive, this),
+                              MakeCallback (&PerfScopes::EndPdcpReceive, this));
+  }
+
+  /**
+   * Connects Begin () of a new scope name to the SendOutgoing,
+   * UnicastForward, LocalDeliver and Drop traces of the Ipv4L3Protocol of
+   * nodes; the sinks connected to them until CloseIpv4Scope () run inside
+   * the scope, as a traced callback calls its sinks in the order they were
+   * connected. \return the scope
+   */
+  uint32_t OpenIpv4Scope (std::string name, NodeContainer nodes)
+  {
+    uint32_t scope = AddScope (name);
+    ConnectIpv4 (scope, nodes, true);
+    return scope;
+  }
+
+  /// Connects End () of scope after the sinks connected since OpenIpv4Scope ()
+  void CloseIpv4Scope (uint32_t scope, NodeContainer nodes)
+  {
+    ConnectIpv4 (scope, nodes, false);
+  }
+
+  /// Prints the line of every scope, per packet of the packets simulated
+  void Report (std::ostream &os, uint64_t packets) const
+  {
+    if (!m_counters.IsOpen ())
+      {
+        os << "PerfCounters: unavailable (" << m_error << ")\n";
+        return;
+      }
+    for (uint32_t i = 0; i < m_scopes.size (); ++i)
+      {
+        const Scope &s = m_scopes[i];
+        os << "PerfCounters: scope=" << s.name << " calls=" << s.calls;
+        for (uint32_t c = 0; c < PerfCounters::COUNTERS; ++c)
+          {
+            os << " " << PerfCounters::GetName (c) << "=" << s.total[c];
+          }
+        os << " packets=" << packets;
+        for (uint32_t c = 0; c < PerfCounters::COUNTERS; ++c)
+          {
+            os << " " << PerfCounters::GetName (c) << "PerPacket="
+               << (packets > 0 ? static_cast<double> (s.total[c]) / packets : 0);
+          }
+        os << " ipc=" << (s.total[PerfCounters::CYCLES] > 0
+                          ? static_cast<double> (s.total[PerfCounters::INSTRUCTIONS]) / s.total[PerfCounters::CYCLES] : 0)
+           << "\n";
+      }
+  }
+
+private:
+  struct Scope
+  {
+    std::string name;
+    uint64_t calls;
+    PerfCounters::Snapshot start;  ///< at the last Begin ()
+    uint64_t total[PerfCounters::COUNTERS];
+  };
+
+  /// Scope a bound Ipv4L3Protocol trace begins or ends
+  struct Hook
+  {
+    PerfScopes *scopes;
+    uint32_t scope;
+    bool begin;
+  };
+
+  void BeginPdcpReceive (void)
+  {
+    Begin (m_pdcpScope);
+  }
+
+  void EndPdcpReceive (void)
+  {
+    End (m_pdcpScope);
+  }
+
+  void ConnectIpv4 (uint32_t scope, NodeContainer nodes, bool begin)
+  {
+    Hook *hook = new Hook;
+    hook->scopes = this;
+    hook->scope = scope;
+    hook->begin = begin;
+    m_hooks.push_back (hook);
+    for (NodeContainer::Iterator it = nodes.Begin (); it != nodes.End (); ++it)
+      {
+        Ptr<Ipv4L3Protocol> ipv4 = (*it)->GetObject<Ipv4L3Protocol> ();
+        if (ipv4 == 0)
+          {
+            continue;
+          }
+        ipv4->TraceConnectWithoutContext ("SendOutgoing", MakeBoundCallback (&PerfScopes::Ipv4Packet, hook));
+        ipv4->TraceConnectWithoutContext ("UnicastForward", MakeBoundCallback (&PerfScopes::Ipv4Packet, hook));
+        ipv4->TraceConnectWithoutContext ("LocalDeliver", MakeBoundCallback (&PerfScopes::Ipv4Packet, hook));
+        ipv4->TraceConnectWithoutContext ("Drop", MakeBoundCallback (&PerfScopes::Ipv4Drop, hook));
+      }
+  }
+
+  static void Ipv4Packet (Hook *hook, const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    Mark (hook);
+  }
+
+  static void Ipv4Drop (Hook *hook, const Ipv4Header &header, Ptr<const Packet> packet,
+                        Ipv4L3Protocol::DropReason reason, Ptr<Ipv4> ipv4, uint32_t interface)
+  {
+    Mark (hook);
+  }
+
+  static void Mark (Hook *hook)
+  {
+    if (hook->begin)
+      {
+        hook->scopes->Begin (hook->scope);
+      }
+    else
+      {
+        hook->scopes->End (hook->scope);
+      }
+  }
+
+  PerfCounters m_counters;
+  std::string m_error;          ///< why the counters could not be opened
+  std::vector<Scope> m_scopes;
+  uint32_t m_pdcpScope;
+  bool m_pdcpHooked;            ///< true if the LtePdcp hooks point here
+  std::vector<Hook *> m_hooks;
+};
+
+} // namespace ns3
+
+#endif // PERF_SCOPES_H
@@ -0,0 +1,152 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PROGRESS_METER_H
+#define PROGRESS_METER_H
+
+#include <iostream>
+
+#include "ns3/core-module.h"
+
+#include "instrumented-simulator-impl.h"
+
+namespace ns3 {
+
+/**
+ * Reports how a run progresses against the wall clock, one
+ * machine-readable line on std::cerr every period of wall-clock time:
+ *   Progress: sim=<s> stop=<s> wall=<s> ratio=<x> eventsPerSecond=<n> pending=<n> etaSeconds=<s>
+ *
+ * ratio is the simulated seconds per wall-clock second since the previous
+ * line, and the ETA assumes it holds until the stop time. eventsPerSecond
+ * and pending need InstrumentedSimulatorImpl and are -1 without it.
+ *
+ * The meter is an event every interval of simulated time, which only reads
+ * the wall clock unless a line is due; the interval should be short next to
+ * what the simulation gets through in a period.
+ *
+ * With SetFloor () a run whose ratio stays below a floor for some lines in a
+ * row is stopped, with a last line "Progress: aborted ratio=<x> floor=<x>",
+ * so a batch job gives up on a run that would not finish in time.
+ */
+class ProgressMeter
+{
+public:
+  ProgressMeter (Time interval, double periodSeconds)
+    : m_interval (interval),
+      m_periodMs (static_cast<int64_t> (periodSeconds * 1000)),
+      m_lastWallMs (0),
+      m_lastExecuted (0),
+      m_floor (0),
+      m_floorLines (0),
+      m_slowLines (0),
+      m_aborted (false)
+  {
+  }
+
+  /// Stops the run after lines consecutive lines with a ratio below floor
+  void SetFloor (double floor, uint32_t lines)
+  {
+    m_floor = floor;
+    m_floorLines = lines;
+  }
+
+  /// Starts the meter for a run that ends at stop; call right before Simulator::Run ()
+  void Start (Time stop)
+  {
+    m_stop = stop;
+    m_wall.Start ();
+    m_lastSim = Simulator::Now ();
+    Ptr<InstrumentedSimulatorImpl> simulator = InstrumentedSimulatorImpl::Get ();
+    m_lastExecuted = simulator != 0 ? simulator->GetExecutedEvents () : 0;
+    m_event = Simulator::Schedule (m_interval, &ProgressMeter::Check, this);
+  }
+
+  /// Cancels the meter, e.g. after Simulator::Run () when it was stopped early
+  void Finish (void)
+  {
+    m_event.Cancel ();
+  }
+
+  /// \return true if the floor stopped the run
+  bool IsAborted (void) const
+  {
+    return m_aborted;
+  }
+
+private:
+  void Check (void)
+  {
+    int64_t wallMs = m_wall.End ();
+    if (wallMs - m_lastWallMs >= m_periodMs)
+      {
+        Report (wallMs);
+        if (m_aborted)
+          {
+            return;
+          }
+      }
+    m_event = Simulator::Schedule (m_interval, &ProgressMeter::Check, this);
+  }
+
+  void Report (int64_t wallMs)
+  {
+    Time now = Simulator::Now ();
+    double wall = (wallMs - m_lastWallMs) / 1000.0;
+    double ratio = wall > 0 ? (now - m_lastSim).GetSeconds () / wall : 0;
+    double eventsPerSecond = -1;
+    int64_t pending = -1;
+    Ptr<InstrumentedSimulatorImpl> simulator = InstrumentedSimulatorImpl::Get ();
+    if (simulator != 0)
+      {
+        uint64_t executed = simulator->GetExecutedEvents ();
+        eventsPerSecond = wall > 0 ? (executed - m_lastExecuted) / wall : 0;
+        pending = simulator->GetPendingEvents ();
+        m_lastExecuted = executed;
+      }
+    double eta = ratio > 0 ? (m_stop - now).GetSeconds () / ratio : -1;
+    std::cerr << "Progress: sim=" << now.GetSeconds () << " stop=" << m_stop.GetSeconds ()
+              << " wall=" << wallMs / 1000.0 << " ratio=" << ratio << " eventsPerSecond=" << eventsPerSecond
+              << " pending=" << pending << " etaSeconds=" << eta << std::endl;
+    m_lastWallMs = wallMs;
+    m_lastSim = now;
+
+    m_slowLines = m_floor > 0 && ratio < m_floor ? m_slowLines + 1 : 0;
+    if (m_floorLines > 0 && m_slowLines >= m_floorLines)
+      {
+        std::cerr << "Progress: aborted ratio=" << ratio << " floor=" << m_floor << std::endl;
+        m_aborted = true;
+        Simulator::Stop ();
+      }
+  }
+
+  Time m_interval;
+  int64_t m_periodMs;
+  Time m_stop;
+  SystemWallClockMs m_wall;
+  int64_t m_lastWallMs;         ///< of the previous line
+  Time m_lastSim;               ///< simulated time of the previous line
+  uint64_t m_lastExecuted;      ///< events executed at the previous line
+  double m_floor;
+  uint32_t m_floorLines;
+  uint32_t m_slowLines;         ///< consecutive lines below the floor
+  bool m_aborted;
+  EventId m_event;
+};
+
+} // namespace ns3
+
+#endif // PROGRESS_METER_H
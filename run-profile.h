@@ -0,0 +1,175 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RUN_PROFILE_H
+#define RUN_PROFILE_H
+
+#include <string>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+namespace ns3 {
+
+/**
+ * Selects which of the expensive diagnostic features a scenario run pays for.
+ *
+ * A profile is written as a base profile followed by optional modifiers,
+ * e.g. "lean", "debug+pcap" or "full-netanim":
+ *   - lean:  no packet metadata, no logging, no traces, no pcap, no NetAnim,
+ *            FlowMonitor serialized without histograms and probes
+ *   - debug: packet metadata/printing, application logging and FlowMonitor
+ *            histograms, but none of the bulk trace files
+ *   - full:  everything (the behaviour the scripts always had)
+ *
+ * Packet metadata has to be decided before the first packet is created, so
+ * ApplyPacketSettings () must be called right after the command line is parsed.
+ */
+class RunProfile
+{
+public:
+  enum Feature
+  {
+    PACKET_METADATA    = 1 << 0, ///< Packet::EnablePrinting ()
+    LOGGING            = 1 << 1, ///< LogComponentEnable on the applications
+    LTE_TRACES         = 1 << 2, ///< lteHelper->EnableTraces () (PHY/MAC/RLC/PDCP stats)
+    PCAP               = 1 << 3, ///< p2ph.EnablePcapAll ()
+    NETANIM            = 1 << 4, ///< AnimationInterface
+    FLOWMON_HISTOGRAMS = 1 << 5  ///< histograms and probes in the FlowMonitor XML
+  };
+
+  static const uint32_t LEAN = 0;
+  static const uint32_t DEBUG = PACKET_METADATA | LOGGING | FLOWMON_HISTOGRAMS;
+  static const uint32_t FULL = PACKET_METADATA | LOGGING | LTE_TRACES | PCAP | NETANIM | FLOWMON_HISTOGRAMS;
+
+  RunProfile ()
+    : m_features (FULL),
+      m_name ("full")
+  {
+  }
+
+  /**
+   * \param profile a profile string such as "lean+pcap"
+   * \return false if the base profile or one of the features is unknown
+   */
+  bool Parse (std::string profile)
+  {
+    std::string::size_type end = profile.find_first_of ("+-");
+    std::string base = profile.substr (0, end);
+    if (base == "lean")
+      {
+        m_features = LEAN;
+      }
+    else if (base == "debug")
+      {
+        m_features = DEBUG;
+      }
+    else if (base == "full")
+      {
+        m_features = FULL;
+      }
+    else
+      {
+        return false;
+      }
+    while (end != std::string::npos)
+      {
+        bool enable = profile[end] == '+';
+        std::string::size_type next = profile.find_first_of ("+-", end + 1);
+        uint32_t feature = FeatureFromName (profile.substr (end + 1, next - end - 1));
+        if (feature == 0)
+          {
+            return false;
+          }
+        if (enable)
+          {
+            m_features |= feature;
+          }
+        else
+          {
+            m_features &= ~feature;
+          }
+        end = next;
+      }
+    m_name = profile;
+    return true;
+  }
+
+  bool IsEnabled (Feature feature) const
+  {
+    return (m_features & feature) != 0;
+  }
+
+  std::string GetName (void) const
+  {
+    return m_name;
+  }
+
+  /**
+   * Turns on packet metadata when the profile asks for it. Must run before
+   * any packet is created.
+   */
+  void ApplyPacketSettings (void) const
+  {
+    if (IsEnabled (PACKET_METADATA))
+      {
+        Packet::EnablePrinting ();
+      }
+  }
+
+  static std::string GetHelp (void)
+  {
+    return "Run profile: lean|debug|full, optionally followed by +feature or -feature "
+           "(features: metadata, logging, traces, pcap, netanim, histograms)";
+  }
+
+private:
+  static uint32_t FeatureFromName (std::string name)
+  {
+    if (name == "metadata")
+      {
+        return PACKET_METADATA;
+      }
+    if (name == "logging")
+      {
+        return LOGGING;
+      }
+    if (name == "traces")
+      {
+        return LTE_TRACES;
+      }
+    if (name == "pcap")
+      {
+        return PCAP;
+      }
+    if (name == "netanim")
+      {
+        return NETANIM;
+      }
+    if (name == "histograms")
+      {
+        return FLOWMON_HISTOGRAMS;
+      }
+    return 0;
+  }
+
+  uint32_t m_features;
+  std::string m_name;
+};
+
+} // namespace ns3
+
+#endif // RUN_PROFILE_H
@@ -0,0 +1,213 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TIME_BIN_AGGREGATOR_H
+#define TIME_BIN_AGGREGATOR_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ns3/core-module.h"
+#include "ns3/stats-module.h"
+
+namespace ns3 {
+
+/**
+ * Takes the place of FileHelper::WriteProbe () with FileAggregator::FORMATTED
+ * for packet probes: rather than a formatted line per packet, the bytes of
+ * the probe's OutputBytes trace are added up in memory per node and per
+ * window of fixed length, and one line per window is written to
+ * <filename>.txt, a column per node:
+ *
+ *   % time	node0	node1	...
+ *
+ * The time is the start of the window in seconds. From the first packet on,
+ * windows without packets are written with zeros, so the lines are evenly
+ * spaced. The last window is written by Finish ().
+ *
+ * Works with the probes whose trace has the (uint32_t oldBytes, uint32_t
+ * newBytes) signature of OutputBytes: ns3::Ipv4PacketProbe,
+ * ns3::Ipv6PacketProbe and ns3::ApplicationPacketProbe.
+ */
+class TimeBinAggregator
+{
+public:
+  TimeBinAggregator (std::string filename, Time window)
+    : m_filename (filename + ".txt"),
+      m_window (window),
+      m_file (0),
+      m_bin (0)
+  {
+    NS_ASSERT_MSG (window.IsStrictlyPositive (), "TimeBinAggregator needs a window longer than 0");
+  }
+
+  ~TimeBinAggregator ()
+  {
+    Finish ();
+    for (uint32_t i = 0; i < m_contexts.size (); ++i)
+      {
+        delete m_contexts[i];
+      }
+  }
+
+  /**
+   * Creates a probe of type typeId for every object path matches up to its
+   * last element, the trace source the probe watches, as FileHelper does;
+   * the probes of a node share its column. Call before the first packet.
+   */
+  void WriteProbe (std::string typeId, std::string path, std::string probeTraceSource)
+  {
+    NS_ASSERT_MSG (m_file == 0, "TimeBinAggregator::WriteProbe () after the first packet");
+    std::string::size_type slash = path.rfind ('/');
+    NS_ASSERT_MSG (slash != std::string::npos, "Not a trace source path: " << path);
+    std::string objectPath = path.substr (0, slash);
+    std::string traceSource = path.substr (slash + 1);
+    Config::MatchContainer matches = Config::LookupMatches (objectPath);
+    if (matches.GetN () == 0)
+      {
+        NS_FATAL_ERROR ("No object matches " << objectPath);
+      }
+    ObjectFactory factory;
+    factory.SetTypeId (typeId);
+    for (uint32_t i = 0; i < matches.GetN (); ++i)
+      {
+        std::string matched = matches.GetMatchedPath (i);
+        Ptr<Probe> probe = factory.Create ()->GetObject<Probe> ();
+        NS_ASSERT_MSG (probe != 0, typeId << " is not a probe");
+        if (!probe->ConnectByObject (traceSource, matches.Get (i)))
+          {
+            NS_FATAL_ERROR ("Cannot connect " << typeId << " to " << matched << "/" << traceSource);
+          }
+        Context *context = new Context;
+        context->aggregator = this;
+        context->nodeId = GetNodeId (matched, i);
+        context->column = 0;
+        m_columns[context->nodeId] = 0;
+        m_contexts.push_back (context);
+        if (!probe->TraceConnectWithoutContext (probeTraceSource, MakeBoundCallback (&TimeBinAggregator::Add, context)))
+          {
+            NS_FATAL_ERROR (typeId << " has no trace source " << probeTraceSource);
+          }
+        m_probes.push_back (probe);
+      }
+  }
+
+  /// Writes the window in progress and closes the file
+  void Finish (void)
+  {
+    if (m_file == 0)
+      {
+        return;
+      }
+    WriteBin ();
+    if (fclose (m_file) != 0)
+      {
+        NS_FATAL_ERROR ("Cannot write " << m_filename);
+      }
+    m_file = 0;
+  }
+
+private:
+  /// Column a bound probe trace adds to
+  struct Context
+  {
+    TimeBinAggregator *aggregator;
+    uint32_t nodeId;
+    uint32_t column;            ///< set by Open ()
+  };
+
+  static void Add (Context *context, uint32_t oldBytes, uint32_t newBytes)
+  {
+    context->aggregator->AddBytes (context, newBytes);
+  }
+
+  void AddBytes (Context *context, uint32_t bytes)
+  {
+    uint64_t bin = static_cast<uint64_t> (Simulator::Now ().GetTimeStep () / m_window.GetTimeStep ());
+    if (m_file == 0)
+      {
+        Open ();
+        m_bin = bin;
+      }
+    while (m_bin < bin)
+      {
+        WriteBin ();
+        ++m_bin;
+      }
+    m_bytes[context->column] += bytes;
+  }
+
+  void Open (void)
+  {
+    m_file = fopen (m_filename.c_str (), "w");
+    if (m_file == 0)
+      {
+        NS_FATAL_ERROR ("Cannot write " << m_filename);
+      }
+    // columns are in the order of the node ids, which is the order of m_columns
+    fprintf (m_file, "%% time");
+    for (std::map<uint32_t, uint32_t>::iterator it = m_columns.begin (); it != m_columns.end (); ++it)
+      {
+        it->second = m_bytes.size ();
+        m_bytes.push_back (0);
+        fprintf (m_file, "\tnode%u", it->first);
+      }
+    fprintf (m_file, "\n");
+    for (uint32_t i = 0; i < m_contexts.size (); ++i)
+      {
+        m_contexts[i]->column = m_columns[m_contexts[i]->nodeId];
+      }
+  }
+
+  /// Writes the line of window m_bin and clears its counters
+  void WriteBin (void)
+  {
+    fprintf (m_file, "%.6f", TimeStep (m_window.GetTimeStep () * m_bin).GetSeconds ());
+    for (uint32_t i = 0; i < m_bytes.size (); ++i)
+      {
+        fprintf (m_file, "\t%llu", (unsigned long long) m_bytes[i]);
+        m_bytes[i] = 0;
+      }
+    fprintf (m_file, "\n");
+  }
+
+  /// \return the node id in a /NodeList/<id>/... path, or index if there is none
+  static uint32_t GetNodeId (std::string path, uint32_t index)
+  {
+    std::string prefix = "/NodeList/";
+    if (path.compare (0, prefix.size (), prefix) != 0)
+      {
+        return index;
+      }
+    return atoi (path.c_str () + prefix.size ());
+  }
+
+  std::string m_filename;
+  Time m_window;
+  FILE *m_file;
+  uint64_t m_bin;               ///< window the counters are for
+  std::map<uint32_t, uint32_t> m_columns;       ///< node id to column
+  std::vector<uint64_t> m_bytes;                ///< per column
+  std::vector<Context *> m_contexts;
+  std::vector<Ptr<Probe> > m_probes;
+};
+
+} // namespace ns3
+
+#endif // TIME_BIN_AGGREGATOR_H
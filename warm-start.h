@@ -0,0 +1,167 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef WARM_START_H
+#define WARM_START_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <iostream>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "ns3/core-module.h"
+
+namespace ns3 {
+
+/**
+ * Runs many seeds of one scenario from a single warmed-up simulation.
+ *
+ * The caller builds the scenario and runs the simulator up to its warm-up
+ * time (EPC attach and bearer setup done). Run () then forks one
+ * copy-on-write child per seed, at most jobs of them at a time. Each child
+ * calls the seed callback with its run number and the write end of a pipe;
+ * whatever the callback writes there is handed back to the parent.
+ *
+ * The simulator is single threaded, so forking it between two events is
+ * safe as long as no other thread is running (no async writers yet) and
+ * buffered output has been flushed, which Run () does before every fork.
+ */
+class WarmStartForker
+{
+public:
+  /**
+   * \param jobs maximum number of children alive at the same time, 0 means
+   *        one per online CPU
+   */
+  WarmStartForker (uint32_t jobs)
+    : m_jobs (jobs)
+  {
+    if (m_jobs == 0)
+      {
+        long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+        m_jobs = cpus > 0 ? cpus : 1;
+      }
+  }
+
+  /**
+   * \param firstRun run number given to the first child
+   * \param nRuns number of children to fork
+   * \param seed continues the simulation of one run and writes its results
+   *        to the given file descriptor; called in the child only
+   * \return what each child wrote, indexed by run - firstRun. Children that
+   *         did not exit cleanly get an empty string.
+   */
+  std::vector<std::string> Run (uint32_t firstRun, uint32_t nRuns, Callback<void, uint32_t, int> seed)
+  {
+    std::vector<std::string> results (nRuns);
+    std::deque<Child> running;
+    uint32_t next = 0;
+    while (next < nRuns || !running.empty ())
+      {
+        while (next < nRuns && running.size () < m_jobs)
+          {
+            running.push_back (Fork (firstRun + next, seed));
+            running.back ().index = next;
+            ++next;
+          }
+        Child child = running.front ();
+        running.pop_front ();
+        results[child.index] = Collect (child);
+      }
+    return results;
+  }
+
+private:
+  struct Child
+  {
+    pid_t pid;
+    int fd;
+    uint32_t index;
+  };
+
+  Child Fork (uint32_t run, Callback<void, uint32_t, int> seed)
+  {
+    int fds[2];
+    if (pipe (fds) != 0)
+      {
+        NS_FATAL_ERROR ("Cannot create result pipe for run " << run);
+      }
+    std::cout.flush ();
+    std::cerr.flush ();
+    fflush (NULL);
+    pid_t pid = fork ();
+    if (pid < 0)
+      {
+        NS_FATAL_ERROR ("Cannot fork run " << run);
+      }
+    if (pid == 0)
+      {
+        close (fds[0]);
+        seed (run, fds[1]);
+        std::cout.flush ();
+        fflush (NULL);
+        close (fds[1]);
+        // skip the static destructors of the parent image
+        _exit (0);
+      }
+    close (fds[1]);
+    Child child;
+    child.pid = pid;
+    child.fd = fds[0];
+    child.index = 0;
+    return child;
+  }
+
+  std::string Collect (Child child)
+  {
+    std::string output;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read (child.fd, buffer, sizeof (buffer))) != 0)
+      {
+        if (n < 0)
+          {
+            if (errno == EINTR)
+              {
+                continue;
+              }
+            break;
+          }
+        output.append (buffer, n);
+      }
+    close (child.fd);
+    int status = 0;
+    while (waitpid (child.pid, &status, 0) < 0 && errno == EINTR)
+      {
+      }
+    if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+      {
+        return "";
+      }
+    return output;
+  }
+
+  uint32_t m_jobs;
+};
+
+} // namespace ns3
+
+#endif // WARM_START_H
@@ -37,6 +37,7 @@
 #include "ns3/internet-module.h"
 #include "ns3/flow-monitor-module.h"
 #include "ns3/wifi-module.h"
+#include "instrumented-simulator-impl.h"
 
 using namespace ns3;
 
@@ -23,6 +23,7 @@
 #include "ns3/mobility-module.h"
 #include "ns3/csma-module.h"
 #include "ns3/internet-module.h"
+#include "instrumented-simulator-impl.h"
 
 // WiFi example that builds the following Network Topology:
 //
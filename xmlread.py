@@ -21,11 +21,13 @@ bitrates = []
 losses = []
 delays = []
 
+#Index the classifier by flowId once, instead of searching it for every flow
+#For very large files use flowmon-analyzer, which streams the XML
+tuples = dict((tpl.get('flowId'), tpl) for tpl in et.findall("Ipv4FlowClassifier/Flow"))
+
 for flow in et.findall("FlowStats/Flow"):
    #Get flowIds information
-   for tpl in et.findall("Ipv4FlowClassifier/Flow" ):
-       if tpl.get('flowId') == flow.get('flowId'):
-           break
+   tpl = tuples[flow.get('flowId')]
    if tpl.get("destinationPort") == '698':
        continue
 